@@ -3,9 +3,45 @@
 #define STM32F7XX_HAL_H_ STM32F7XX_HAL_H_
 
 #include "stdint.h"
+#include "stdio.h"
 
 #define __IO volatile
 
+/**
+  * @brief  Clock of the simulated core, the APB1 bus runs with a quarter and the APB2 bus with half of it
+  */
+#define HAL_MOCK_HCLK_FREQ                 216000000U
+#define HAL_MOCK_PCLK1_FREQ                ( HAL_MOCK_HCLK_FREQ / 4U )
+#define HAL_MOCK_PCLK2_FREQ                ( HAL_MOCK_HCLK_FREQ / 2U )
+
+extern uint32_t SystemCoreClock;
+
+/**
+  * @brief  STM32F7xx interrupt number definition, only the lines used by the firmware
+  */
+typedef enum
+{
+	SysTick_IRQn = -1,
+	ADC_IRQn = 18,
+	TIM1_UP_TIM10_IRQn = 25,
+	TIM1_CC_IRQn = 27,
+	TIM2_IRQn = 28,
+	TIM4_IRQn = 30,
+	SPI1_IRQn = 35,
+	USART3_IRQn = 39,
+	TIM5_IRQn = 50,
+	DMA2_Stream0_IRQn = 56
+} IRQn_Type;
+
+/**
+  * @brief  CMSIS core functions, they are implemented by the simulated core of the RTOS port
+  */
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+uint32_t __get_BASEPRI(void);
+
   /** @defgroup GPIO_pins_define GPIO pins define
 	* @{
 	*/
@@ -69,6 +105,72 @@
 
 #define __HAL_TIM_ENABLE(__HANDLE__)                 ((__HANDLE__)->Instance->CR1|=(1))
 
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+  (((__CHANNEL__) == TIM_CHANNEL_1) ? ((__HANDLE__)->Instance->CCR1 = (__COMPARE__)) :\
+   ((__CHANNEL__) == TIM_CHANNEL_2) ? ((__HANDLE__)->Instance->CCR2 = (__COMPARE__)) :\
+   ((__CHANNEL__) == TIM_CHANNEL_3) ? ((__HANDLE__)->Instance->CCR3 = (__COMPARE__)) :\
+   ((__CHANNEL__) == TIM_CHANNEL_4) ? ((__HANDLE__)->Instance->CCR4 = (__COMPARE__)) :\
+   ((__CHANNEL__) == TIM_CHANNEL_5) ? ((__HANDLE__)->Instance->CCR5 = (__COMPARE__)) :\
+   ((__HANDLE__)->Instance->CCR6 = (__COMPARE__)))
+
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)            ((__HANDLE__)->Instance->CNT)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__) ((__HANDLE__)->Instance->CNT = (__COUNTER__))
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)  ((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__) ((__HANDLE__)->Instance->DIER &= ~(__INTERRUPT__))
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__)     (((__HANDLE__)->Instance->SR &(__FLAG__)) == (__FLAG__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)   ((__HANDLE__)->Instance->SR = ~(__FLAG__))
+
+/** @defgroup TIM_Interrupt_definition TIM interrupt Definition
+  * @{
+  */
+#define TIM_IT_UPDATE                      0x00000001U                          /*!< Update interrupt            */
+#define TIM_IT_CC1                         0x00000002U                          /*!< Capture/Compare 1 interrupt */
+#define TIM_IT_CC2                         0x00000004U                          /*!< Capture/Compare 2 interrupt */
+#define TIM_IT_CC3                         0x00000008U                          /*!< Capture/Compare 3 interrupt */
+#define TIM_IT_CC4                         0x00000010U                          /*!< Capture/Compare 4 interrupt */
+  /**
+	* @}
+	*/
+
+/** @defgroup TIM_Flag_definition TIM Flag Definition
+  * @{
+  */
+#define TIM_FLAG_UPDATE                    0x00000001U                          /*!< Update interrupt flag         */
+#define TIM_FLAG_CC1                       0x00000002U                          /*!< Capture/Compare 1 interrupt flag */
+#define TIM_FLAG_CC2                       0x00000004U                          /*!< Capture/Compare 2 interrupt flag */
+#define TIM_FLAG_CC3                       0x00000008U                          /*!< Capture/Compare 3 interrupt flag */
+#define TIM_FLAG_CC4                       0x00000010U                          /*!< Capture/Compare 4 interrupt flag */
+  /**
+	* @}
+	*/
+
+#define TIM_CCMR2_CC3S                     0x00000003U
+#define TIM_CCMR2_OC3M                     0x00010070U
+
+/** @defgroup TIM_Input_Capture_Polarity TIM Input Capture Polarity
+  * @{
+  */
+#define TIM_INPUTCHANNELPOLARITY_RISING    0x00000000U                          /*!< Polarity for TIx source */
+#define TIM_INPUTCHANNELPOLARITY_FALLING   0x00000002U                          /*!< Polarity for TIx source */
+#define TIM_INPUTCHANNELPOLARITY_BOTHEDGE  0x0000000AU                          /*!< Polarity for TIx source */
+#define TIM_ICSELECTION_DIRECTTI           0x00000001U                          /*!< TIM Input 1, 2, 3 or 4 is selected to be connected to IC1, IC2, IC3 or IC4, respectively */
+#define TIM_ICSELECTION_INDIRECTTI         0x00000002U                          /*!< TIM Input 1, 2, 3 or 4 is selected to be connected to IC2, IC1, IC4 or IC3, respectively */
+#define TIM_ICPSC_DIV1                     0x00000000U                          /*!< Capture performed each time an edge is detected on the capture input */
+  /**
+	* @}
+	*/
+
+/**
+  * @brief  TIM Input Capture Configuration Structure definition
+  */
+typedef struct
+{
+	uint32_t  ICPolarity;  /*!< Specifies the active edge of the input signal. */
+	uint32_t ICSelection;  /*!< Specifies the input. */
+	uint32_t ICPrescaler;  /*!< Specifies the Input Capture Prescaler. */
+	uint32_t ICFilter;     /*!< Specifies the input capture filter. */
+} TIM_IC_InitTypeDef;
+
 /**
   * @brief  HAL Status structures definition
   */
@@ -231,6 +333,169 @@ typedef struct
 } GPIO_TypeDef;
 
 
+/**
+  * @brief GPIO Init structure definition
+  */
+typedef struct
+{
+	uint32_t Pin;       /*!< Specifies the GPIO pins to be configured. */
+	uint32_t Mode;      /*!< Specifies the operating mode for the selected pins. */
+	uint32_t Pull;      /*!< Specifies the Pull-up or Pull-Down activation for the selected pins. */
+	uint32_t Speed;     /*!< Specifies the speed for the selected pins. */
+	uint32_t Alternate; /*!< Peripheral to be connected to the selected pins. */
+} GPIO_InitTypeDef;
+
+#define GPIO_MODE_INPUT                    0x00000000U   /*!< Input Floating Mode                   */
+#define GPIO_MODE_OUTPUT_PP                0x00000001U   /*!< Output Push Pull Mode                 */
+#define GPIO_MODE_OUTPUT_OD                0x00000011U   /*!< Output Open Drain Mode                */
+#define GPIO_MODE_AF_PP                    0x00000002U   /*!< Alternate Function Push Pull Mode     */
+#define GPIO_MODE_AF_OD                    0x00000012U   /*!< Alternate Function Open Drain Mode    */
+#define GPIO_MODE_ANALOG                   0x00000003U   /*!< Analog Mode  */
+#define GPIO_NOPULL                        0x00000000U   /*!< No Pull-up or Pull-down activation  */
+#define GPIO_PULLUP                        0x00000001U   /*!< Pull-up activation                  */
+#define GPIO_PULLDOWN                      0x00000002U   /*!< Pull-down activation                */
+#define GPIO_SPEED_FREQ_LOW                0x00000000U   /*!< Low speed     */
+#define GPIO_SPEED_FREQ_MEDIUM             0x00000001U   /*!< Medium speed  */
+#define GPIO_SPEED_FREQ_HIGH               0x00000002U   /*!< Fast speed    */
+#define GPIO_SPEED_FREQ_VERY_HIGH          0x00000003U   /*!< High speed    */
+#define GPIO_AF2_TIM5                      ((uint8_t)0x02)  /* TIM5 Alternate Function mapping */
+
+/**
+  * @brief Analog to Digital Converter
+  */
+typedef struct
+{
+	__IO uint32_t SR;     /*!< ADC status register,                         Address offset: 0x00 */
+	__IO uint32_t CR1;    /*!< ADC control register 1,                      Address offset: 0x04 */
+	__IO uint32_t CR2;    /*!< ADC control register 2,                      Address offset: 0x08 */
+	__IO uint32_t SMPR1;  /*!< ADC sample time register 1,                  Address offset: 0x0C */
+	__IO uint32_t SMPR2;  /*!< ADC sample time register 2,                  Address offset: 0x10 */
+	__IO uint32_t JOFR1;  /*!< ADC injected channel data offset register 1, Address offset: 0x14 */
+	__IO uint32_t JOFR2;  /*!< ADC injected channel data offset register 2, Address offset: 0x18 */
+	__IO uint32_t JOFR3;  /*!< ADC injected channel data offset register 3, Address offset: 0x1C */
+	__IO uint32_t JOFR4;  /*!< ADC injected channel data offset register 4, Address offset: 0x20 */
+	__IO uint32_t HTR;    /*!< ADC watchdog higher threshold register,      Address offset: 0x24 */
+	__IO uint32_t LTR;    /*!< ADC watchdog lower threshold register,       Address offset: 0x28 */
+	__IO uint32_t SQR1;   /*!< ADC regular sequence register 1,             Address offset: 0x2C */
+	__IO uint32_t SQR2;   /*!< ADC regular sequence register 2,             Address offset: 0x30 */
+	__IO uint32_t SQR3;   /*!< ADC regular sequence register 3,             Address offset: 0x34 */
+	__IO uint32_t JSQR;   /*!< ADC injected sequence register,              Address offset: 0x38*/
+	__IO uint32_t JDR1;   /*!< ADC injected data register 1,                Address offset: 0x3C */
+	__IO uint32_t JDR2;   /*!< ADC injected data register 2,                Address offset: 0x40 */
+	__IO uint32_t JDR3;   /*!< ADC injected data register 3,                Address offset: 0x44 */
+	__IO uint32_t JDR4;   /*!< ADC injected data register 4,                Address offset: 0x48 */
+	__IO uint32_t DR;     /*!< ADC regular data register,                   Address offset: 0x4C */
+} ADC_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CSR;    /*!< ADC Common status register,                  Address offset: ADC1 base address + 0x300 */
+	__IO uint32_t CCR;    /*!< ADC common control register,                 Address offset: ADC1 base address + 0x304 */
+	__IO uint32_t CDR;    /*!< ADC common regular data register for dual
+							   AND triple modes,                            Address offset: ADC1 base address + 0x308 */
+} ADC_Common_TypeDef;
+
+#define ADC_SR_AWD                         0x00000001U
+#define ADC_SR_EOC                         0x00000002U
+#define ADC_CR1_AWDIE                      0x00000040U
+#define ADC_CR1_AWDSGL                     0x00000200U
+#define ADC_CR1_AWDEN                      0x00800000U
+#define ADC_CR2_ADON                       0x00000001U
+#define ADC_CR2_DMA                        0x00000100U
+#define ADC_CR2_DDS                        0x00000200U
+#define ADC_CR2_EXTSEL_Pos                 (24U)
+#define ADC_CR2_EXTEN_0                    0x10000000U
+#define ADC_CCR_ADCPRE                     0x00030000U
+#define ADC_CCR_ADCPRE_0                   0x00010000U
+#define ADC_SMPR2_SMP0_Pos                 (0U)
+
+/**
+  * @brief DMA Controller
+  */
+typedef struct
+{
+	__IO uint32_t CR;     /*!< DMA stream x configuration register      */
+	__IO uint32_t NDTR;   /*!< DMA stream x number of data register     */
+	__IO uint32_t PAR;    /*!< DMA stream x peripheral address register */
+	__IO uint32_t M0AR;   /*!< DMA stream x memory 0 address register   */
+	__IO uint32_t M1AR;   /*!< DMA stream x memory 1 address register   */
+	__IO uint32_t FCR;    /*!< DMA stream x FIFO control register       */
+} DMA_Stream_TypeDef;
+
+/**
+  * @brief  DMA Configuration Structure definition
+  */
+typedef struct
+{
+	uint32_t Channel;              /*!< Specifies the channel used for the specified stream. */
+	uint32_t Direction;            /*!< Specifies if the data will be transferred from memory to peripheral,
+										from memory to memory or from peripheral to memory. */
+	uint32_t PeriphInc;            /*!< Specifies whether the Peripheral address register should be incremented or not. */
+	uint32_t MemInc;               /*!< Specifies whether the memory address register should be incremented or not. */
+	uint32_t PeriphDataAlignment;  /*!< Specifies the Peripheral data width. */
+	uint32_t MemDataAlignment;     /*!< Specifies the Memory data width. */
+	uint32_t Mode;                 /*!< Specifies the operation mode of the DMAy Streamx. */
+	uint32_t Priority;             /*!< Specifies the software priority for the DMAy Streamx. */
+	uint32_t FIFOMode;             /*!< Specifies if the FIFO mode or Direct mode will be used for the specified stream. */
+	uint32_t FIFOThreshold;        /*!< Specifies the FIFO threshold level. */
+	uint32_t MemBurst;             /*!< Specifies the Burst transfer configuration for the memory transfers. */
+	uint32_t PeriphBurst;          /*!< Specifies the Burst transfer configuration for the peripheral transfers. */
+} DMA_InitTypeDef;
+
+#define DMA_CHANNEL_0                      0x00000000U    /*!< DMA Channel 0 */
+#define DMA_PERIPH_TO_MEMORY               0x00000000U    /*!< Peripheral to memory direction */
+#define DMA_PINC_DISABLE                   0x00000000U    /*!< Peripheral increment mode disable */
+#define DMA_MINC_ENABLE                    0x00000400U    /*!< Memory increment mode enable  */
+#define DMA_PDATAALIGN_HALFWORD            0x00000800U    /*!< Peripheral data alignment: HalfWord */
+#define DMA_MDATAALIGN_HALFWORD            0x00002000U    /*!< Memory data alignment: HalfWord */
+#define DMA_NORMAL                         0x00000000U    /*!< Normal mode                  */
+#define DMA_CIRCULAR                       0x00000100U    /*!< Circular mode                */
+#define DMA_PRIORITY_HIGH                  0x00020000U    /*!< Priority level: High      */
+#define DMA_FIFOMODE_DISABLE               0x00000000U    /*!< FIFO mode disable */
+
+/**
+  * @brief  FLASH Erase structure definition
+  */
+typedef struct
+{
+	uint32_t TypeErase;    /*!< Mass erase or sector Erase. */
+	uint32_t Banks;        /*!< Select banks to erase when Mass erase is enabled. */
+	uint32_t Sector;       /*!< Initial FLASH sector to erase when Mass erase is disabled */
+	uint32_t NbSectors;    /*!< Number of sectors to be erased. */
+	uint32_t VoltageRange; /*!< The device voltage range which defines the erase parallelism */
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_BASE                         0x08000000U
+#define FLASH_SIZE                         0x00100000U
+#define FLASH_TYPEERASE_SECTORS            0x00000000U  /*!< Sectors erase only          */
+#define FLASH_TYPEERASE_MASSERASE          0x00000001U  /*!< Flash Mass erase activation */
+#define FLASH_VOLTAGE_RANGE_3              0x00000002U  /*!< Device operating range: 2.7V to 3.6V */
+#define FLASH_TYPEPROGRAM_BYTE             0x00000000U  /*!< Program byte (8-bit) at a specified address           */
+#define FLASH_TYPEPROGRAM_HALFWORD         0x00000001U  /*!< Program a half-word (16-bit) at a specified address   */
+#define FLASH_TYPEPROGRAM_WORD             0x00000002U  /*!< Program a word (32-bit) at a specified address        */
+#define FLASH_TYPEPROGRAM_DOUBLEWORD       0x00000003U  /*!< Program a double word (64-bit) at a specified address */
+#define FLASH_SECTOR_0                     0U  /*!< Sector Number 0   */
+#define FLASH_SECTOR_1                     1U  /*!< Sector Number 1   */
+#define FLASH_SECTOR_2                     2U  /*!< Sector Number 2   */
+#define FLASH_SECTOR_3                     3U  /*!< Sector Number 3   */
+#define FLASH_SECTOR_4                     4U  /*!< Sector Number 4   */
+#define FLASH_SECTOR_5                     5U  /*!< Sector Number 5   */
+#define FLASH_SECTOR_6                     6U  /*!< Sector Number 6   */
+#define FLASH_SECTOR_7                     7U  /*!< Sector Number 7   */
+
+/**
+  * @brief  Peripheral clocks, all clocks of the mock are running
+  */
+#define __HAL_RCC_GPIOA_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_GPIOF_CLK_ENABLE()       do { } while(0)
+#define __HAL_RCC_TIM5_CLK_ENABLE()        do { } while(0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()        do { } while(0)
+#define __HAL_RCC_ADC1_CLK_ENABLE()        do { } while(0)
+
 /** @defgroup TIM_Output_Compare_and_PWM_modes TIM Output Compare and PWM Modes
   * @{
   */
@@ -356,7 +621,14 @@ typedef enum
   */
 typedef struct __DMA_HandleTypeDef
 {
-	void* Instance;
+	DMA_Stream_TypeDef* Instance;                                   /*!< Register base address                  */
+	DMA_InitTypeDef Init;                                           /*!< DMA communication parameters           */
+	HAL_LockTypeDef Lock;                                           /*!< DMA locking object                     */
+	void* Parent;                                                   /*!< Parent object state                    */
+	void (*XferCpltCallback)(struct __DMA_HandleTypeDef* hdma);     /*!< DMA transfer complete callback         */
+	void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef* hdma); /*!< DMA Half transfer complete callback    */
+	void (*XferErrorCallback)(struct __DMA_HandleTypeDef* hdma);    /*!< DMA transfer error callback            */
+	__IO uint32_t ErrorCode;                                        /*!< DMA Error code                          */
 }DMA_HandleTypeDef;
 
 /**
@@ -526,6 +798,22 @@ extern TIM_TypeDef __int_TIM12;
 extern TIM_TypeDef __int_TIM13;
 extern TIM_TypeDef __int_TIM14;
 
+extern GPIO_TypeDef __int_GPIOA;
+extern GPIO_TypeDef __int_GPIOB;
+extern GPIO_TypeDef __int_GPIOC;
+extern GPIO_TypeDef __int_GPIOD;
+extern GPIO_TypeDef __int_GPIOE;
+extern GPIO_TypeDef __int_GPIOF;
+extern GPIO_TypeDef __int_GPIOG;
+extern GPIO_TypeDef __int_GPIOH;
+extern GPIO_TypeDef __int_GPIOI;
+extern GPIO_TypeDef __int_GPIOJ;
+extern GPIO_TypeDef __int_GPIOK;
+
+extern ADC_TypeDef __int_ADC1;
+extern ADC_Common_TypeDef __int_ADC123_COMMON;
+extern DMA_Stream_TypeDef __int_DMA2_Stream0;
+
 
 
 /** @addtogroup Peripheral_declaration
@@ -551,20 +839,34 @@ extern TIM_TypeDef __int_TIM14;
 #define TIM11               ((TIM_TypeDef *) &__int_TIM11)
 #define SPI5                ((SPI_TypeDef *) &__int_SPI5)
 #define SPI6                ((SPI_TypeDef *) &__int_SPI6)
-#define GPIOA               ((GPIO_TypeDef *) 0x01)
-#define GPIOB               ((GPIO_TypeDef *) 0x02)
-#define GPIOC               ((GPIO_TypeDef *) 0x03)
-#define GPIOD               ((GPIO_TypeDef *) 0x04)
-#define GPIOE               ((GPIO_TypeDef *) 0x05)
-#define GPIOF               ((GPIO_TypeDef *) 0x06)
-#define GPIOG               ((GPIO_TypeDef *) 0x07)
-#define GPIOH               ((GPIO_TypeDef *) 0x08)
-#define GPIOI               ((GPIO_TypeDef *) 0x09)
-#define GPIOJ               ((GPIO_TypeDef *) 0x0A)
-#define GPIOK               ((GPIO_TypeDef *) 0x0B)
-
-
-
+#define GPIOA               ((GPIO_TypeDef *) &__int_GPIOA)
+#define GPIOB               ((GPIO_TypeDef *) &__int_GPIOB)
+#define GPIOC               ((GPIO_TypeDef *) &__int_GPIOC)
+#define GPIOD               ((GPIO_TypeDef *) &__int_GPIOD)
+#define GPIOE               ((GPIO_TypeDef *) &__int_GPIOE)
+#define GPIOF               ((GPIO_TypeDef *) &__int_GPIOF)
+#define GPIOG               ((GPIO_TypeDef *) &__int_GPIOG)
+#define GPIOH               ((GPIO_TypeDef *) &__int_GPIOH)
+#define GPIOI               ((GPIO_TypeDef *) &__int_GPIOI)
+#define GPIOJ               ((GPIO_TypeDef *) &__int_GPIOJ)
+#define GPIOK               ((GPIO_TypeDef *) &__int_GPIOK)
+#define ADC1                ((ADC_TypeDef *) &__int_ADC1)
+#define ADC                 ((ADC_Common_TypeDef *) &__int_ADC123_COMMON)
+#define DMA2_Stream0        ((DMA_Stream_TypeDef *) &__int_DMA2_Stream0)
+
+
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
 GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
 void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
 void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
@@ -580,6 +882,119 @@ HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel);
 HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel);
 HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* htim, const TIM_OC_InitTypeDef* sConfig, uint32_t Channel);
 HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef* htim, const TIM_IC_InitTypeDef* sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel);
+uint32_t HAL_TIM_ReadCapturedValue(const TIM_HandleTypeDef* htim, uint32_t Channel);
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError);
+
+/**
+  * @brief  Virtual time of the mock, not part of the HAL
+  *
+  * By default the timers of the mock run in threads against the wall clock. In virtual time one clock drives the
+  * SysTick and the TIM4 pulses counted by TIM1, every step edge happens at its scheduled time. The clock only
+  * advances when the core is idle or the firmware waits in HAL_Delay() or polls HAL_GetTick() and GPIO inputs, each
+  * poll costs HAL_MOCK_POLL_CYCLES. Interrupts which are due while the caller has masked them are taken later, the
+  * pulses of the timers are not delayed by that.
+  */
+#define HAL_MOCK_TIMER_CLOCK               ( 2U * HAL_MOCK_PCLK1_FREQ )
+#define HAL_MOCK_POLL_CYCLES               ( HAL_MOCK_TIMER_CLOCK / 1000000U )
+
+/*! \brief Switches the mock to virtual time, must be called before the first timer is started
+ *
+ * \param sysTickHandler is called every millisecond like the SysTick_Handler of the target */
+void HAL_MOCK_StartVirtualTime(void (*sysTickHandler)(void));
+
+/*! \brief Returns 1 if the mock runs in virtual time */
+int HAL_MOCK_IsVirtualTime(void);
+
+/*! \brief Advances the virtual time to the next event and takes its interrupt, called when the core is idle */
+void HAL_MOCK_RunNextEvent(void);
+
+/*! \brief Returns the virtual time in nanoseconds since the start, 0 if the mock runs on the wall clock */
+uint64_t HAL_MOCK_GetTimeNs(void);
+
+/*! \brief Returns the number of step edges TIM1 let through in virtual time */
+uint64_t HAL_MOCK_GetStepEdges(void);
+
+/*! \brief Returns the virtual time of the last step edge in nanoseconds */
+uint64_t HAL_MOCK_GetLastStepEdgeNs(void);
+
+/*! \brief Returns the number of transfers on SPI1, the firmware frames every byte to the driver as one transfer */
+uint64_t HAL_MOCK_GetSpiTransfers(void);
+
+/*! \brief Returns ABS_POS of the simulated driver as a signed number of microsteps */
+int32_t HAL_MOCK_GetDriverPosition(void);
+
+/*! \brief Writes one line "time_ns,dir,abs_pos" per step edge into the stream, NULL stops the trace
+ *
+ * With the plant model enabled a fourth column holds the position of the rotor in microsteps */
+void HAL_MOCK_SetStepTrace(FILE* trace);
+
+/**
+  * @brief  Mechanical model of the stepper axis, not part of the HAL
+  *
+  * Without the model every step edge moves the axis. With the model the rotor follows the commanded microstep
+  * position with the sinusoidal torque of a hybrid stepper (50 pole pairs): the peak torque scales with the phase
+  * current set in TVAL and drops with the step rate, the rotor and the lead screw are accelerated against the load
+  * and friction. If the rotor lags more than two full steps it slips to the next stable position and loses four full
+  * steps. The driver heats up with the phase current and reports TH_WARN and TH_SD, OCD is reported when the current
+  * peaks reach OCD_TH. Like on the L6474 these flags are latched until the status is read. The model needs virtual
+  * time, the edges of the wall clock timers have no usable timing.
+  */
+typedef struct
+{
+	float holdingTorque;        /*!< N m at the rated phase current                                      */
+	float ratedCurrent;         /*!< A, phase current of the holding torque                              */
+	float cornerRate;           /*!< full steps/s at which the pull-out torque has dropped to one half   */
+	float rotorInertia;         /*!< kg m^2, rotor, coupling and lead screw                              */
+	float loadMass;             /*!< kg, carriage moved by the lead screw                                */
+	float leadMm;               /*!< mm of travel per turn of the lead screw                             */
+	float loadForce;            /*!< N, constant axial force against the forward direction               */
+	float frictionTorque;       /*!< N m, Coulomb friction at the motor shaft                            */
+	float damping;              /*!< N m s/rad, damping of the rotor against the commanded motion        */
+	float currentRipple;        /*!< fraction by which the chopped current overshoots TVAL               */
+	float switchResistance;     /*!< Ohm, R_DS(on) of one switch of the bridges                          */
+	float thermalResistance;    /*!< K/W, junction to ambient                                            */
+	float thermalTimeConstant;  /*!< s                                                                   */
+	float ambient;              /*!< degree C                                                            */
+} HAL_MOCK_Plant_t;
+
+typedef struct
+{
+	int64_t  commanded;         /*!< microsteps the driver applied to the motor                          */
+	int64_t  rotor;             /*!< microsteps the rotor turned, rounded                                */
+	uint32_t slips;             /*!< pole slips, each one loses four full steps                          */
+	uint32_t missedSteps;       /*!< microsteps lost by the slips                                        */
+	float    maxLag;            /*!< largest lag of the rotor behind the command in full steps           */
+	float    junction;          /*!< temperature of the driver in degree C                               */
+	float    maxJunction;       /*!< highest temperature of the driver in degree C                       */
+	uint32_t ocdEvents;         /*!< number of overcurrent detections                                    */
+	uint32_t thWarnEvents;      /*!< number of thermal warnings                                          */
+	uint32_t thSdEvents;        /*!< number of thermal shutdowns                                         */
+} HAL_MOCK_PlantStats_t;
+
+/*! \brief Fills the parameters with a NEMA 17 motor (0.44 N m at 1.7 A) on a 4 mm lead screw at 24 V */
+void HAL_MOCK_GetDefaultPlant(HAL_MOCK_Plant_t* plant);
+
+/*! \brief Enables the mechanical model with a copy of the parameters, NULL disables it
+ *
+ * \return 0 on success, -1 if the mock does not run in virtual time */
+int HAL_MOCK_SetPlant(const HAL_MOCK_Plant_t* plant);
+
+/*! \brief Reads the counters of the model at the current virtual time
+ *
+ * \return 0 on success, -1 if the model is disabled */
+int HAL_MOCK_GetPlantStats(HAL_MOCK_PlantStats_t* stats);
 
 #endif /* STM32F7XX_HAL_H_ */
 
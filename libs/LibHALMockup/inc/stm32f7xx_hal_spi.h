@@ -0,0 +1,7 @@
+#ifndef STM32F7XX_HAL_SPI_H
+#define STM32F7XX_HAL_SPI_H STM32F7XX_HAL_SPI_H
+
+// the SPI part of the mock is declared together with the rest of the HAL
+#include "stm32f7xx_hal.h"
+
+#endif /* STM32F7XX_HAL_SPI_H */
@@ -1,6 +1,33 @@
 #include "stm32f7xx_hal.h"
 #include "main.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(_WIN32)
 #include "Windows.h"
+typedef HANDLE MockThread_t;
+typedef DWORD MockThreadResult_t;
+#define MOCK_THREAD_FUNCTION(name) DWORD WINAPI name(LPVOID lpParameter)
+#define MOCK_THREAD_RESULT 0
+// the callbacks of the Win32 simulator are called without masking, its port has no CMSIS functions
+#define MOCK_IRQ_ENTER()
+#define MOCK_IRQ_EXIT()
+#define MOCK_IRQ_MASKED() 0
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <time.h>
+typedef pthread_t MockThread_t;
+typedef void* MockThreadResult_t;
+#define MOCK_THREAD_FUNCTION(name) void* name(void* lpParameter)
+#define MOCK_THREAD_RESULT NULL
+// the threads of the mock are the interrupts of the simulated core, they mask each other and the critical
+// sections of the tasks with the CMSIS functions of the RTOS port
+#define MOCK_IRQ_ENTER() __disable_irq()
+#define MOCK_IRQ_EXIT()  __enable_irq()
+#define MOCK_IRQ_MASKED() (__get_PRIMASK() != 0 || __get_BASEPRI() != 0)
+#endif
 
 // USE THIS DEFINE TO DISABLE THE GATING SIMULATION AND INSTEAD USE
 // THE PWM IRQS OF THE PWM GENERATOR DIRECTLY!!!
@@ -127,7 +154,9 @@ static struct
 	int regPtr;
 	int pending;
 	int pwmGeneratorStarted;
-	HANDLE pwmGeneratorHandle;
+	int pwmGeneratorRunning;
+	MockThread_t pwmGeneratorHandle;
+	volatile unsigned int onePulseGeneration;
 	struct
 	{
 		uint16_t status;
@@ -164,19 +193,19 @@ static struct
 static const L6474x_ParameterDescriptor_t L6474_Parameters[STEP_REG_RANGE_MASK]
 // --------------------------------------------------------------------------------------------------------------------
 = {
-	[STEP_REG_ABS_POS] = {.command = STEP_REG_ABS_POS,   .defined = 1, .length = STEP_LEN_ABS_POS,   .mask = STEP_MASK_ABS_POS,   .address = &myConfig.regs.abs_pos,   .flags = afREAD | afWRITE       },
-	[STEP_REG_EL_POS] = {.command = STEP_REG_EL_POS,    .defined = 1, .length = STEP_LEN_EL_POS,    .mask = STEP_MASK_EL_POS,    .address = &myConfig.regs.el_pos,    .flags = afREAD | afWRITE       },
-	[STEP_REG_MARK] = {.command = STEP_REG_MARK,      .defined = 1, .length = STEP_LEN_MARK,      .mask = STEP_MASK_MARK,      .address = &myConfig.regs.mark,      .flags = afREAD | afWRITE       },
-	[STEP_REG_TVAL] = {.command = STEP_REG_TVAL,      .defined = 1, .length = STEP_LEN_TVAL,      .mask = STEP_MASK_TVAL,      .address = &myConfig.regs.tval,      .flags = afREAD | afWRITE       },
-	[STEP_REG_T_FAST] = {.command = STEP_REG_T_FAST,    .defined = 1, .length = STEP_LEN_T_FAST,    .mask = STEP_MASK_T_FAST,    .address = &myConfig.regs.tfast,    .flags = afREAD | afWRITE_HighZ },
-	[STEP_REG_TON_MIN] = {.command = STEP_REG_TON_MIN,   .defined = 1, .length = STEP_LEN_TON_MIN,   .mask = STEP_MASK_TON_MIN,   .address = &myConfig.regs.ton,   .flags = afREAD | afWRITE_HighZ },
-	[STEP_REG_TOFF_MIN] = {.command = STEP_REG_TOFF_MIN,  .defined = 1, .length = STEP_LEN_TOFF_MIN,  .mask = STEP_MASK_TOFF_MIN,  .address = &myConfig.regs.toff,  .flags = afREAD | afWRITE_HighZ },
-	[STEP_REG_ADC_OUT] = {.command = STEP_REG_ADC_OUT,   .defined = 1, .length = STEP_LEN_ADC_OUT,   .mask = STEP_MASK_ADC_OUT,   .address = &myConfig.regs.adc_out,   .flags = afREAD                 },
-	[STEP_REG_OCD_TH] = {.command = STEP_REG_OCD_TH,    .defined = 1, .length = STEP_LEN_OCD_TH,    .mask = STEP_MASK_OCD_TH,    .address = &myConfig.regs.ocd_th,    .flags = afREAD | afWRITE       },
-	[STEP_REG_STEP_MODE] = {.command = STEP_REG_STEP_MODE, .defined = 1, .length = STEP_LEN_STEP_MODE, .mask = STEP_MASK_STEP_MODE, .address = &myConfig.regs.step_mode, .flags = afREAD | afWRITE_HighZ },
-	[STEP_REG_ALARM_EN] = {.command = STEP_REG_ALARM_EN,  .defined = 1, .length = STEP_LEN_ALARM_EN,  .mask = STEP_MASK_ALARM_EN,  .address = &myConfig.regs.alarm,  .flags = afREAD | afWRITE       },
-	[STEP_REG_CONFIG] = {.command = STEP_REG_CONFIG,    .defined = 1, .length = STEP_LEN_CONFIG,    .mask = STEP_MASK_CONFIG,    .address = &myConfig.regs.config,    .flags = afREAD | afWRITE_HighZ },
-	[STEP_REG_STATUS] = {.command = STEP_REG_STATUS,    .defined = 1, .length = STEP_LEN_STATUS,    .mask = STEP_MASK_STATUS,    .address = &myConfig.regs.status,    .flags = afREAD                 }
+	[STEP_REG_ABS_POS] = {.command = STEP_REG_ABS_POS,   .defined = 1, .length = STEP_LEN_ABS_POS,   .mask = STEP_MASK_ABS_POS,   .address = (char*)&myConfig.regs.abs_pos,   .flags = afREAD | afWRITE       },
+	[STEP_REG_EL_POS] = {.command = STEP_REG_EL_POS,    .defined = 1, .length = STEP_LEN_EL_POS,    .mask = STEP_MASK_EL_POS,    .address = (char*)&myConfig.regs.el_pos,    .flags = afREAD | afWRITE       },
+	[STEP_REG_MARK] = {.command = STEP_REG_MARK,      .defined = 1, .length = STEP_LEN_MARK,      .mask = STEP_MASK_MARK,      .address = (char*)&myConfig.regs.mark,      .flags = afREAD | afWRITE       },
+	[STEP_REG_TVAL] = {.command = STEP_REG_TVAL,      .defined = 1, .length = STEP_LEN_TVAL,      .mask = STEP_MASK_TVAL,      .address = (char*)&myConfig.regs.tval,      .flags = afREAD | afWRITE       },
+	[STEP_REG_T_FAST] = {.command = STEP_REG_T_FAST,    .defined = 1, .length = STEP_LEN_T_FAST,    .mask = STEP_MASK_T_FAST,    .address = (char*)&myConfig.regs.tfast,    .flags = afREAD | afWRITE_HighZ },
+	[STEP_REG_TON_MIN] = {.command = STEP_REG_TON_MIN,   .defined = 1, .length = STEP_LEN_TON_MIN,   .mask = STEP_MASK_TON_MIN,   .address = (char*)&myConfig.regs.ton,   .flags = afREAD | afWRITE_HighZ },
+	[STEP_REG_TOFF_MIN] = {.command = STEP_REG_TOFF_MIN,  .defined = 1, .length = STEP_LEN_TOFF_MIN,  .mask = STEP_MASK_TOFF_MIN,  .address = (char*)&myConfig.regs.toff,  .flags = afREAD | afWRITE_HighZ },
+	[STEP_REG_ADC_OUT] = {.command = STEP_REG_ADC_OUT,   .defined = 1, .length = STEP_LEN_ADC_OUT,   .mask = STEP_MASK_ADC_OUT,   .address = (char*)&myConfig.regs.adc_out,   .flags = afREAD                 },
+	[STEP_REG_OCD_TH] = {.command = STEP_REG_OCD_TH,    .defined = 1, .length = STEP_LEN_OCD_TH,    .mask = STEP_MASK_OCD_TH,    .address = (char*)&myConfig.regs.ocd_th,    .flags = afREAD | afWRITE       },
+	[STEP_REG_STEP_MODE] = {.command = STEP_REG_STEP_MODE, .defined = 1, .length = STEP_LEN_STEP_MODE, .mask = STEP_MASK_STEP_MODE, .address = (char*)&myConfig.regs.step_mode, .flags = afREAD | afWRITE_HighZ },
+	[STEP_REG_ALARM_EN] = {.command = STEP_REG_ALARM_EN,  .defined = 1, .length = STEP_LEN_ALARM_EN,  .mask = STEP_MASK_ALARM_EN,  .address = (char*)&myConfig.regs.alarm,  .flags = afREAD | afWRITE       },
+	[STEP_REG_CONFIG] = {.command = STEP_REG_CONFIG,    .defined = 1, .length = STEP_LEN_CONFIG,    .mask = STEP_MASK_CONFIG,    .address = (char*)&myConfig.regs.config,    .flags = afREAD | afWRITE_HighZ },
+	[STEP_REG_STATUS] = {.command = STEP_REG_STATUS,    .defined = 1, .length = STEP_LEN_STATUS,    .mask = STEP_MASK_STATUS,    .address = (char*)&myConfig.regs.status,    .flags = afREAD                 }
 };
 
 SPI_TypeDef __int_SPI1;
@@ -201,21 +230,694 @@ TIM_TypeDef __int_TIM12;
 TIM_TypeDef __int_TIM13;
 TIM_TypeDef __int_TIM14;
 
+GPIO_TypeDef __int_GPIOA;
+GPIO_TypeDef __int_GPIOB;
+GPIO_TypeDef __int_GPIOC;
+GPIO_TypeDef __int_GPIOD;
+GPIO_TypeDef __int_GPIOE;
+GPIO_TypeDef __int_GPIOF;
+GPIO_TypeDef __int_GPIOG;
+GPIO_TypeDef __int_GPIOH;
+GPIO_TypeDef __int_GPIOI;
+GPIO_TypeDef __int_GPIOJ;
+GPIO_TypeDef __int_GPIOK;
+
+ADC_TypeDef __int_ADC1;
+ADC_Common_TypeDef __int_ADC123_COMMON;
+DMA_Stream_TypeDef __int_DMA2_Stream0;
+
+uint32_t SystemCoreClock = HAL_MOCK_HCLK_FREQ;
+
 // --------------------------------------------------------------------------------------------------------------------
 static uint8_t ExecDriverProcessorSPI(uint8_t input);
 static uint8_t directionForward = 1;
 static int32_t internalPosition = 0;
 
+// --------------------------------------------------------------------------------------------------------------------
+static int StartMockThread(MockThread_t* handle, MockThreadResult_t (*function)(void*), void* parameter)
+// --------------------------------------------------------------------------------------------------------------------
+{
+#if defined(_WIN32)
+	*handle = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)function, parameter, 0, NULL);
+	return (*handle != NULL) ? 0 : -1;
+#else
+	return (pthread_create(handle, NULL, function, parameter) == 0) ? 0 : -1;
+#endif
+}
+
+#if defined(USE_PWM_GENERATOR_DIRECTLY_INSTEAD_OF_GATING_SLAVE)
+// --------------------------------------------------------------------------------------------------------------------
+static void JoinMockThread(MockThread_t handle)
+// --------------------------------------------------------------------------------------------------------------------
+{
+#if defined(_WIN32)
+	WaitForSingleObject(handle, INFINITE);
+#else
+	pthread_join(handle, NULL);
+#endif
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SleepMock(uint32_t ms)
+// --------------------------------------------------------------------------------------------------------------------
+{
+#if defined(_WIN32)
+	Sleep(ms);
+#else
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+	while (nanosleep(&ts, &ts) != 0) { ; }
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint8_t* MockFlash(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the firmware reads its flash through the absolute address, so the flash is mapped to its address on the target
+	static uint8_t* flash = NULL;
+	if (flash != NULL) return flash;
+
+#if defined(_WIN32)
+	void* mem = VirtualAlloc((LPVOID)(uintptr_t)FLASH_BASE, FLASH_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void* mem = mmap((void*)(uintptr_t)FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (mem == MAP_FAILED) mem = NULL;
+#endif
+	if (mem != (void*)(uintptr_t)FLASH_BASE) return NULL;
+
+	// an erased flash reads as ones
+	flash = (uint8_t*)mem;
+	memset(flash, 0xFF, FLASH_SIZE);
+	return flash;
+}
+
+#if !defined(_WIN32)
+// --------------------------------------------------------------------------------------------------------------------
+__attribute__((constructor)) static void MockFlashInit(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the flash must exist before the firmware reads its calibration during the initialization
+	if (MockFlash() == NULL)
+	{
+		fprintf(stderr, "the simulated flash could not be mapped at 0x%08X\n", (unsigned int)FLASH_BASE);
+	}
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	int enabled;
+	int busy;
+	uint64_t now;                  // cycles of the timer clock since the start
+	void (*sysTickHandler)(void);
+	uint64_t sysTickNext;
+	int sysTickPending;
+	int stepActive;
+	uint64_t stepNext;
+	int tim1Pending;
+	uint64_t stepEdges;
+	uint64_t lastStepEdge;
+	FILE* stepTrace;
+} MockClock_t;
+
+static MockClock_t mockClock;
+static uint64_t mockSpiTransfers = 0;
+
+#define MOCK_CYCLES_PER_MS (HAL_MOCK_TIMER_CLOCK / 1000U)
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint64_t MockCyclesToNs(uint64_t cycles)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return (cycles / HAL_MOCK_TIMER_CLOCK) * 1000000000ULL + ((cycles % HAL_MOCK_TIMER_CLOCK) * 1000000000ULL) / HAL_MOCK_TIMER_CLOCK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint64_t MockStepPeriod(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// TIM1 counts the update events of TIM4, the rate is read at every edge so speed changes apply to the next step
+	return (uint64_t)(TIM4->PSC + 1) * (uint64_t)(TIM4->ARR + 1);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint64_t MockNextEvent(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	uint64_t next = mockClock.sysTickNext;
+	if (mockClock.stepActive && mockClock.stepNext < next) next = mockClock.stepNext;
+	return next;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+#define PLANT_POLE_PAIRS        50                                  // rotor teeth of a 1.8 degree hybrid stepper
+#define PLANT_FULL_STEPS        200
+#define PLANT_PI                3.14159265358979323846
+#define PLANT_SUBSTEP_CYCLES    ( HAL_MOCK_TIMER_CLOCK / 100000U )  // 10 us integration step
+#define PLANT_SETTLE_CYCLES     ( HAL_MOCK_TIMER_CLOCK / 10U )      // 100 ms after the last step the rotor rests
+#define PLANT_TH_WARN           130.0
+#define PLANT_TH_SD             160.0
+#define PLANT_TH_HYSTERESIS     15.0
+#define PLANT_CONFIG_OC_SD      ( 1 << 7 )
+
+typedef struct
+{
+	int enabled;
+	HAL_MOCK_Plant_t p;
+	double inertia;                // kg m^2 at the motor shaft
+	double loadTorque;             // N m at the motor shaft
+	double theta;                  // rad, rotor
+	double omega;                  // rad/s, rotor
+	double thetaCmd;               // rad, commanded by the step edges
+	double omegaCmd;               // rad/s, rate of the last step edges
+	double stepAngle;              // rad per microstep at the last update
+	int64_t rotorSteps;            // microsteps of the rotor at the last update
+	int64_t pole;                  // stable position the rotor is locked to, in pole pitches behind the command
+	double junction;               // degree C
+	uint64_t updated;
+	uint64_t lastEdge;
+	uint64_t lastInterval;
+	int ocd;
+	int thWarn;
+	int thSd;
+	HAL_MOCK_PlantStats_t stats;
+} MockPlant_t;
+
+static MockPlant_t mockPlant;
+
+// --------------------------------------------------------------------------------------------------------------------
+static int MockPlantMicrosteps(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// STEP_SEL of STEP_MODE, everything above 1/16 is 1/16
+	int sel = myConfig.regs.step_mode & 0x07;
+	return 1 << ((sel > 4) ? 4 : sel);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static double MockPlantCurrent(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ((myConfig.regs.status & STATUS_HIGHZ_MASK) != 0) return 0.0;
+	return ((double)myConfig.regs.tval + 1.0) * 0.03125;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockPlantIntegrate(uint64_t from, uint64_t until)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	double current = MockPlantCurrent();
+	double holding = mockPlant.p.holdingTorque * ((current < mockPlant.p.ratedCurrent) ? current / mockPlant.p.ratedCurrent : 1.0);
+	double friction = mockPlant.p.frictionTorque;
+
+	for (uint64_t t = from; t < until; )
+	{
+		uint64_t cycles = until - t;
+		if (cycles > PLANT_SUBSTEP_CYCLES) cycles = PLANT_SUBSTEP_CYCLES;
+		double h = (double)cycles / (double)HAL_MOCK_TIMER_CLOCK;
+
+		// the field stands still once the next edge is overdue
+		if (t - mockPlant.lastEdge > 2 * mockPlant.lastInterval) mockPlant.omegaCmd = 0.0;
+
+		// the back EMF limits the current, so the peak torque drops with the step rate
+		double rate = fabs(mockPlant.omega) * PLANT_FULL_STEPS / (2.0 * PLANT_PI);
+		double peak = holding / (1.0 + rate / mockPlant.p.cornerRate);
+		double drive = peak * sin(PLANT_POLE_PAIRS * (mockPlant.thetaCmd - mockPlant.theta))
+			+ mockPlant.p.damping * (mockPlant.omegaCmd - mockPlant.omega) - mockPlant.loadTorque;
+
+		// Coulomb friction holds the rotor until the other torques exceed it and never reverses it
+		if (mockPlant.omega != 0.0 || fabs(drive) > friction)
+		{
+			double sign = (mockPlant.omega != 0.0) ? ((mockPlant.omega > 0.0) ? 1.0 : -1.0) : ((drive > 0.0) ? 1.0 : -1.0);
+			double omega = mockPlant.omega + (drive - sign * friction) / mockPlant.inertia * h;
+			if (mockPlant.omega != 0.0 && omega * mockPlant.omega < 0.0) omega = 0.0;
+			mockPlant.omega = omega;
+		}
+		mockPlant.theta += mockPlant.omega * h;
+		t += cycles;
+
+		// beyond two full steps of lag the torque pulls the rotor to the next stable position, four full steps away.
+		// Without current the rotor is free, it locks to the nearest stable position when the bridges are enabled
+		double lag = PLANT_POLE_PAIRS * (mockPlant.thetaCmd - mockPlant.theta);
+		int64_t pole = (int64_t)floor((lag + PLANT_PI) / (2.0 * PLANT_PI));
+		if (pole != mockPlant.pole && holding > 0.0)
+		{
+			uint32_t slips = (uint32_t)((pole > mockPlant.pole) ? pole - mockPlant.pole : mockPlant.pole - pole);
+			mockPlant.stats.slips += slips;
+			mockPlant.stats.missedSteps += slips * 4U * (uint32_t)MockPlantMicrosteps();
+		}
+		mockPlant.pole = pole;
+		double fullSteps = fabs(lag - 2.0 * PLANT_PI * (double)pole) / (PLANT_PI / 2.0);
+		if (holding > 0.0 && fullSteps > mockPlant.stats.maxLag) mockPlant.stats.maxLag = (float)fullSteps;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockPlantUpdate(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	uint64_t now = mockClock.now;
+	if (now <= mockPlant.updated) return;
+
+	// after the last edge the rotor settles, the time in between is not integrated
+	uint64_t settled = mockPlant.lastEdge + PLANT_SETTLE_CYCLES;
+	uint64_t until = (now < settled) ? now : settled;
+	if (until > mockPlant.updated) MockPlantIntegrate(mockPlant.updated, until);
+
+	// first order model of the junction, both bridges conduct the phase currents through two switches each
+	double current = MockPlantCurrent();
+	double dt = (double)(now - mockPlant.updated) / (double)HAL_MOCK_TIMER_CLOCK;
+	double target = mockPlant.p.ambient + 2.0 * current * current * mockPlant.p.switchResistance * mockPlant.p.thermalResistance;
+	mockPlant.junction = target + (mockPlant.junction - target) * exp(-dt / mockPlant.p.thermalTimeConstant);
+	if (mockPlant.junction > mockPlant.stats.maxJunction) mockPlant.stats.maxJunction = (float)mockPlant.junction;
+	mockPlant.updated = now;
+
+	// the flags of the status register are active low and latched, the shutdowns put the bridges into high impedance
+	if (mockPlant.junction >= PLANT_TH_SD && !mockPlant.thSd)
+	{
+		mockPlant.thSd = 1;
+		mockPlant.stats.thSdEvents += 1;
+		myConfig.regs.status = (myConfig.regs.status & ~STATUS_THR_SHORTD_MASK) | STATUS_HIGHZ_MASK;
+	}
+	else if (mockPlant.junction < PLANT_TH_SD - PLANT_TH_HYSTERESIS)
+	{
+		mockPlant.thSd = 0;
+	}
+
+	if (mockPlant.junction >= PLANT_TH_WARN && !mockPlant.thWarn)
+	{
+		mockPlant.thWarn = 1;
+		mockPlant.stats.thWarnEvents += 1;
+		myConfig.regs.status &= ~STATUS_THR_WARN_MASK;
+	}
+	else if (mockPlant.junction < PLANT_TH_WARN - PLANT_TH_HYSTERESIS)
+	{
+		mockPlant.thWarn = 0;
+	}
+
+	int ocd = current * (1.0 + mockPlant.p.currentRipple) >= ((double)myConfig.regs.ocd_th + 1.0) * 0.375;
+	if (ocd && !mockPlant.ocd)
+	{
+		mockPlant.stats.ocdEvents += 1;
+		myConfig.regs.status &= ~STATUS_OCD_MASK;
+		if (myConfig.regs.config & PLANT_CONFIG_OC_SD) myConfig.regs.status |= STATUS_HIGHZ_MASK;
+	}
+	mockPlant.ocd = ocd;
+
+	// the mechanical position follows the rotor, a new step mode only rescales it
+	double stepAngle = 2.0 * PLANT_PI / (PLANT_FULL_STEPS * MockPlantMicrosteps());
+	int64_t rotorSteps = llround(mockPlant.theta / stepAngle);
+	if (stepAngle == mockPlant.stepAngle)
+	{
+		internalPosition += (int32_t)(rotorSteps - mockPlant.rotorSteps);
+		if (internalPosition >  100) internalPosition =  100;
+		if (internalPosition < -100) internalPosition = -100;
+	}
+	mockPlant.stepAngle = stepAngle;
+	mockPlant.rotorSteps = rotorSteps;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockPlantStep(int forward)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	uint64_t interval = mockClock.now - mockPlant.lastEdge;
+	double sign = forward ? 1.0 : -1.0;
+
+	mockPlant.omegaCmd = (interval > 0 && interval < PLANT_SETTLE_CYCLES) ? sign * mockPlant.stepAngle * HAL_MOCK_TIMER_CLOCK / (double)interval : 0.0;
+	mockPlant.lastInterval = interval;
+	mockPlant.lastEdge = mockClock.now;
+	mockPlant.thetaCmd += sign * mockPlant.stepAngle;
+	mockPlant.stats.commanded += forward ? 1 : -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockPlantReleaseFlags(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// reading the status releases the latched flags whose condition is gone
+	if (!mockPlant.enabled) return;
+	MockPlantUpdate();
+	if (!mockPlant.ocd) myConfig.regs.status |= STATUS_OCD_MASK;
+	if (!mockPlant.thWarn) myConfig.regs.status |= STATUS_THR_WARN_MASK;
+	if (!mockPlant.thSd) myConfig.regs.status |= STATUS_THR_SHORTD_MASK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockStepEdge(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the rotor moves up to the edge before the edge changes the command
+	if (mockPlant.enabled) MockPlantUpdate();
+	mockClock.stepEdges += 1;
+	mockClock.lastStepEdge = mockClock.now;
+
+	if ((myConfig.regs.status & STATUS_HIGHZ_MASK) == 0)
+	{
+		if (directionForward)
+		{
+			myConfig.regs.abs_pos += 1;
+		}
+		else
+		{
+			myConfig.regs.abs_pos -= 1;
+		}
+
+		if (mockPlant.enabled)
+		{
+			MockPlantStep(directionForward);
+		}
+		else
+		{
+			internalPosition += directionForward ? 1 : -1;
+			if (internalPosition >  100) internalPosition =  100;
+			if (internalPosition < -100) internalPosition = -100;
+		}
+	}
+
+	if (mockClock.stepTrace != NULL && mockPlant.enabled)
+	{
+		fprintf(mockClock.stepTrace, "%llu,%d,%ld,%lld\n", (unsigned long long)MockCyclesToNs(mockClock.now),
+			directionForward ? 1 : 0, (long)(int32_t)myConfig.regs.abs_pos, (long long)mockPlant.rotorSteps);
+	}
+	else if (mockClock.stepTrace != NULL)
+	{
+		fprintf(mockClock.stepTrace, "%llu,%d,%ld\n", (unsigned long long)MockCyclesToNs(mockClock.now),
+			directionForward ? 1 : 0, (long)(int32_t)myConfig.regs.abs_pos);
+	}
+
+	// the one pulse segment ends with the overflow of TIM1, which is the edge after the counter reached ARR
+	if (TIM1->CNT < TIM1->ARR)
+	{
+		TIM1->CNT += 1;
+		mockClock.stepNext += MockStepPeriod();
+	}
+	else
+	{
+		TIM1->CNT = 0;
+		TIM1->CR1 &= ~1U;
+		TIM1->SR = (TIM1->SR | TIM_FLAG_UPDATE) & ~TIM_FLAG_CC2;
+		mockClock.stepActive = 0;
+		mockClock.tim1Pending = 1;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockServiceInterrupts(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	extern void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef * htim);
+	extern TIM_HandleTypeDef htim1;
+
+	if (mockClock.sysTickPending)
+	{
+		mockClock.sysTickPending = 0;
+		if (mockClock.sysTickHandler != NULL) mockClock.sysTickHandler();
+	}
+	if (mockClock.tim1Pending)
+	{
+		mockClock.tim1Pending = 0;
+		HAL_TIM_PWM_PulseFinishedCallback(&htim1);
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockAdvance(uint64_t until)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// an interrupt handler which polls the HAL does not advance the time
+	if (mockClock.busy) return;
+	mockClock.busy = 1;
+
+	// like on the target the hardware keeps running while the interrupts are masked, only their handlers are delayed
+	int masked = MOCK_IRQ_MASKED();
+	if (!masked)
+	{
+		MOCK_IRQ_ENTER();
+		MockServiceInterrupts();
+	}
+
+	uint64_t next;
+	while ((next = MockNextEvent()) <= until)
+	{
+		mockClock.now = next;
+		if (mockClock.sysTickNext == next)
+		{
+			mockClock.sysTickNext += MOCK_CYCLES_PER_MS;
+			mockClock.sysTickPending = 1;
+		}
+		if (mockClock.stepActive && mockClock.stepNext == next)
+		{
+			MockStepEdge();
+		}
+		if (!masked) MockServiceInterrupts();
+	}
+	if (until > mockClock.now) mockClock.now = until;
+
+	// leaving the interrupt can switch to another task, which must be able to advance the time
+	mockClock.busy = 0;
+	if (!masked) MOCK_IRQ_EXIT();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void MockPoll(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// a busy waiting loop of the firmware must see the time advance
+	if (mockClock.enabled) MockAdvance(mockClock.now + HAL_MOCK_POLL_CYCLES);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_MOCK_StartVirtualTime(void (*sysTickHandler)(void))
+// --------------------------------------------------------------------------------------------------------------------
+{
+	memset(&mockClock, 0, sizeof(mockClock));
+	mockClock.sysTickHandler = sysTickHandler;
+	mockClock.sysTickNext = MOCK_CYCLES_PER_MS;
+	mockClock.enabled = 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int HAL_MOCK_IsVirtualTime(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return mockClock.enabled;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_MOCK_RunNextEvent(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if (mockClock.enabled) MockAdvance(MockNextEvent());
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t HAL_MOCK_GetTimeNs(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return mockClock.enabled ? MockCyclesToNs(mockClock.now) : 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t HAL_MOCK_GetStepEdges(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return mockClock.stepEdges;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t HAL_MOCK_GetLastStepEdgeNs(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return MockCyclesToNs(mockClock.lastStepEdge);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint64_t HAL_MOCK_GetSpiTransfers(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return mockSpiTransfers;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int32_t HAL_MOCK_GetDriverPosition(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// ABS_POS is a two's complement number of 22 bits
+	uint32_t pos = myConfig.regs.abs_pos & STEP_MASK_ABS_POS;
+	return (pos & 0x200000U) ? (int32_t)(pos | ~STEP_MASK_ABS_POS) : (int32_t)pos;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_MOCK_SetStepTrace(FILE* trace)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	mockClock.stepTrace = trace;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_MOCK_GetDefaultPlant(HAL_MOCK_Plant_t* plant)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	plant->holdingTorque = 0.44f;
+	plant->ratedCurrent = 1.7f;
+	plant->cornerRate = 1000.0f;
+	plant->rotorInertia = 7.7e-6f;  // 6.8e-6 of the rotor and a steel screw of 8 mm x 300 mm
+	plant->loadMass = 1.0f;
+	plant->leadMm = 4.0f;
+	plant->loadForce = 0.0f;
+	plant->frictionTorque = 0.02f;
+	plant->damping = 3.0e-3f;
+	plant->currentRipple = 0.1f;
+	plant->switchResistance = 0.3f;
+	plant->thermalResistance = 35.0f;
+	plant->thermalTimeConstant = 5.0f;
+	plant->ambient = 25.0f;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int HAL_MOCK_SetPlant(const HAL_MOCK_Plant_t* plant)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if (plant == NULL)
+	{
+		mockPlant.enabled = 0;
+		return 0;
+	}
+	if (!mockClock.enabled || plant->rotorInertia <= 0.0f || plant->ratedCurrent <= 0.0f || plant->cornerRate <= 0.0f ||
+		plant->leadMm < 0.0f || plant->loadMass < 0.0f || plant->thermalTimeConstant <= 0.0f)
+	{
+		return -1;
+	}
+
+	double lead = plant->leadMm / 1000.0;
+	memset(&mockPlant, 0, sizeof(mockPlant));
+	mockPlant.p = *plant;
+	mockPlant.inertia = plant->rotorInertia + plant->loadMass * (lead / (2.0 * PLANT_PI)) * (lead / (2.0 * PLANT_PI));
+	mockPlant.loadTorque = plant->loadForce * lead / (2.0 * PLANT_PI);
+	mockPlant.stepAngle = 2.0 * PLANT_PI / (PLANT_FULL_STEPS * MockPlantMicrosteps());
+	mockPlant.junction = plant->ambient;
+	mockPlant.stats.junction = plant->ambient;
+	mockPlant.stats.maxJunction = plant->ambient;
+	mockPlant.updated = mockClock.now;
+	mockPlant.lastEdge = mockClock.now;
+	mockPlant.enabled = 1;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int HAL_MOCK_GetPlantStats(HAL_MOCK_PlantStats_t* stats)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if (!mockPlant.enabled) return -1;
+
+	MockPlantUpdate();
+	*stats = mockPlant.stats;
+	stats->rotor = mockPlant.rotorSteps;
+	stats->junction = (float)mockPlant.junction;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint32_t HAL_GetTick(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if (mockClock.enabled)
+	{
+		MockPoll();
+		return (uint32_t)(mockClock.now / MOCK_CYCLES_PER_MS);
+	}
+
+#if defined(_WIN32)
+	return GetTickCount();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_Delay(uint32_t Delay)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// busy waiting on the target, so the calling task keeps the core
+	if (mockClock.enabled)
+	{
+		// like the HAL one tick is added, the delay lasts at least the requested time
+		MockAdvance((mockClock.now / MOCK_CYCLES_PER_MS + Delay + 1) * MOCK_CYCLES_PER_MS);
+		return;
+	}
+	SleepMock(Delay);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint32_t HAL_RCC_GetHCLKFreq(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return SystemCoreClock;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return HAL_MOCK_PCLK1_FREQ;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return HAL_MOCK_PCLK2_FREQ;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	(void)IRQn;
+	(void)PreemptPriority;
+	(void)SubPriority;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	(void)IRQn;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	(void)IRQn;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	(void)GPIOx;
+	(void)GPIO_Init;
+}
+
 
 // --------------------------------------------------------------------------------------------------------------------
 GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
 // --------------------------------------------------------------------------------------------------------------------
 {
+	MockPoll();
+
 	if (GPIO_Pin == GPIO_PIN_15 && GPIOx == GPIOD) // stepper PWM pin
 	{
 		return myConfig.pins.pwm_step;
 	}
-	else if (GPIOx == GPIOC && GPIO_Pin == GPIO_PIN_13) // reference mark
+	else if (GPIOx == REFERENCE_MARK_GPIO_Port && GPIO_Pin == REFERENCE_MARK_Pin) // reference mark
 	{
 		return internalPosition >= 100;
 	}
@@ -286,7 +988,7 @@ void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState Pin
 		}
 		myConfig.pins.pwm_step = !!PinState;
 	}
-	else if (GPIOx == GPIOC && GPIO_Pin == GPIO_PIN_13) // reference mark
+	else if (GPIOx == REFERENCE_MARK_GPIO_Port && GPIO_Pin == REFERENCE_MARK_Pin) // reference mark
 	{
 		return;
 	}
@@ -374,7 +1076,7 @@ void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
 	{
 		myConfig.pins.spi_cs = !myConfig.pins.spi_cs;
 	}
-	else if (GPIOx == GPIOC && GPIO_Pin == GPIO_PIN_13) // reference mark
+	else if (GPIOx == REFERENCE_MARK_GPIO_Port && GPIO_Pin == REFERENCE_MARK_Pin) // reference mark
 	{
 		return;
 	}
@@ -450,19 +1152,29 @@ HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef* hspi, uint8_t* pTxD
 	{
 		// here we have to push the byte into the processor and then we have to write the response into tx byte
 		*pRxData = ExecDriverProcessorSPI(*pTxData);
+		mockSpiTransfers += 1;
 	}
 	return HAL_OK;
 }
 
 #if !defined(USE_PWM_GENERATOR_DIRECTLY_INSTEAD_OF_GATING_SLAVE)
 // --------------------------------------------------------------------------------------------------------------------
-DWORD WINAPI ApplnMessageDispatcherThreadTIM1(LPVOID lpParameter)
+static MOCK_THREAD_FUNCTION(ApplnMessageDispatcherThreadTIM1)
 // --------------------------------------------------------------------------------------------------------------------
 {
 	extern void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef * htim);
 	extern TIM_HandleTypeDef htim1;
 
-	Sleep(1000);
+	// a stopped or restarted one pulse segment must not report the end of this one
+	unsigned int generation = (unsigned int)(uintptr_t)lpParameter;
+
+	SleepMock(1000);
+	MOCK_IRQ_ENTER();
+	if (generation != myConfig.onePulseGeneration)
+	{
+		MOCK_IRQ_EXIT();
+		return MOCK_THREAD_RESULT;
+	}
 	TIM1->SR |= (1 << 2);
 	HAL_TIM_PWM_PulseFinishedCallback(&htim1);
 
@@ -483,18 +1195,24 @@ DWORD WINAPI ApplnMessageDispatcherThreadTIM1(LPVOID lpParameter)
 		if (internalPosition < -100) internalPosition = -100;
 		TIM1->ARR = 0;
 	}
+	MOCK_IRQ_EXIT();
 
-	Sleep(100);
-	TIM1->SR &= ~(1 << 2);
-	HAL_TIM_PWM_PulseFinishedCallback(&htim1);
+	SleepMock(100);
+	MOCK_IRQ_ENTER();
+	if (generation == myConfig.onePulseGeneration)
+	{
+		TIM1->SR &= ~(1 << 2);
+		HAL_TIM_PWM_PulseFinishedCallback(&htim1);
+	}
+	MOCK_IRQ_EXIT();
 
-	return 0;
+	return MOCK_THREAD_RESULT;
 }
 #endif
 
 #if defined(USE_PWM_GENERATOR_DIRECTLY_INSTEAD_OF_GATING_SLAVE)
 // --------------------------------------------------------------------------------------------------------------------
-DWORD WINAPI ApplnMessageDispatcherThreadTIM4(LPVOID lpParameter)
+static MOCK_THREAD_FUNCTION(ApplnMessageDispatcherThreadTIM4)
 // --------------------------------------------------------------------------------------------------------------------
 {
 	extern void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim);
@@ -502,8 +1220,9 @@ DWORD WINAPI ApplnMessageDispatcherThreadTIM4(LPVOID lpParameter)
 
 	while (myConfig.pwmGeneratorStarted)
 	{
-		Sleep(1);
+		SleepMock(1);
 		if (!myConfig.pwmGeneratorStarted) break;
+		MOCK_IRQ_ENTER();
 
 		if ((myConfig.regs.status & STATUS_HIGHZ_MASK) == 0)
 		{
@@ -522,8 +1241,9 @@ DWORD WINAPI ApplnMessageDispatcherThreadTIM4(LPVOID lpParameter)
 			if (internalPosition < -100) internalPosition = -100;
 		}
 		HAL_TIM_PeriodElapsedCallback(&htim4);
+		MOCK_IRQ_EXIT();
 	}
-	return 0;
+	return MOCK_THREAD_RESULT;
 }
 #endif
 
@@ -532,18 +1252,41 @@ HAL_StatusTypeDef HAL_TIM_OnePulse_Start_IT(TIM_HandleTypeDef* htim, uint32_t Ou
 // --------------------------------------------------------------------------------------------------------------------
 {
 #if !defined(USE_PWM_GENERATOR_DIRECTLY_INSTEAD_OF_GATING_SLAVE)
-	if (htim->Instance == TIM1) // is the gating timer which enables the tim4 pwm generator
+	if (htim->Instance == TIM1 && mockClock.enabled)
 	{
-		CreateThread(0, 0, ApplnMessageDispatcherThreadTIM1, NULL, 0, NULL);
+		// the gate opens and TIM1 counts from zero, the first step is the first update event of TIM4
+		TIM1->CNT = 0;
+		TIM1->CR1 |= 1;
+		mockClock.stepActive = 1;
+		mockClock.stepNext = mockClock.now + MockStepPeriod();
 	}
-	return HAL_OK;
+	else if (htim->Instance == TIM1) // is the gating timer which enables the tim4 pwm generator
+	{
+		MockThread_t thread;
+		myConfig.onePulseGeneration += 1;
+		if (StartMockThread(&thread, ApplnMessageDispatcherThreadTIM1, (void*)(uintptr_t)myConfig.onePulseGeneration) != 0)
+		{
+			return HAL_ERROR;
+		}
+#if !defined(_WIN32)
+		pthread_detach(thread);
 #endif
+	}
+#endif
+	return HAL_OK;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
 HAL_StatusTypeDef HAL_TIM_OnePulse_Stop_IT(TIM_HandleTypeDef* htim, uint32_t OutputChannel)
 // --------------------------------------------------------------------------------------------------------------------
 {
+	if (htim->Instance == TIM1)
+	{
+		myConfig.onePulseGeneration += 1;
+		mockClock.stepActive = 0;
+		mockClock.tim1Pending = 0;
+		TIM1->CR1 &= ~1U;
+	}
 	return HAL_OK;
 }
 
@@ -571,10 +1314,10 @@ HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel)
 		if (myConfig.pwmGeneratorStarted == 0)
 		{
 			// this blocks until the thread has exited
-			if (myConfig.pwmGeneratorHandle) WaitForSingleObject(myConfig.pwmGeneratorHandle, INFINITE); 
+			if (myConfig.pwmGeneratorRunning) JoinMockThread(myConfig.pwmGeneratorHandle);
 
 			myConfig.pwmGeneratorStarted = 1;
-			myConfig.pwmGeneratorHandle = CreateThread(0, 0, ApplnMessageDispatcherThreadTIM4, NULL, 0, NULL);
+			myConfig.pwmGeneratorRunning = (StartMockThread(&myConfig.pwmGeneratorHandle, ApplnMessageDispatcherThreadTIM4, NULL) == 0);
 		}
 	}
 #endif
@@ -585,15 +1328,18 @@ HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel)
 HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t Channel)
 // --------------------------------------------------------------------------------------------------------------------
 {
-	myConfig.pwmGeneratorStarted = 0;
 #if defined(USE_PWM_GENERATOR_DIRECTLY_INSTEAD_OF_GATING_SLAVE)
-	Sleep(10);
-	if (myConfig.pwmGeneratorHandle != NULL)
+	if (htim->Instance == TIM4)
 	{
-		WaitForSingleObject(myConfig.pwmGeneratorHandle, INFINITE); // this blocks until the thread has exited
+		myConfig.pwmGeneratorStarted = 0;
+		SleepMock(10);
+		if (myConfig.pwmGeneratorRunning)
+		{
+			JoinMockThread(myConfig.pwmGeneratorHandle); // this blocks until the thread has exited
+		}
+		myConfig.pwmGeneratorRunning = 0;
 	}
-#endif		
-	myConfig.pwmGeneratorHandle = NULL;
+#endif
 	return HAL_OK;
 }
 
@@ -619,6 +1365,143 @@ HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim)
 	return HAL_OK;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef* htim)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return HAL_TIM_Base_Init(htim);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef* htim, const TIM_IC_InitTypeDef* sConfig, uint32_t Channel)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	(void)htim;
+	(void)sConfig;
+	(void)Channel;
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// there is no signal on the capture inputs of the mock
+	htim->Instance->DIER |= (TIM_IT_CC1 << (Channel / 4));
+	htim->Instance->CR1 |= 1;
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef* htim, uint32_t Channel)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	htim->Instance->DIER &= ~(TIM_IT_CC1 << (Channel / 4));
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+uint32_t HAL_TIM_ReadCapturedValue(const TIM_HandleTypeDef* htim, uint32_t Channel)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if (Channel == TIM_CHANNEL_1) return htim->Instance->CCR1;
+	else if (Channel == TIM_CHANNEL_2) return htim->Instance->CCR2;
+	else if (Channel == TIM_CHANNEL_3) return htim->Instance->CCR3;
+	else if (Channel == TIM_CHANNEL_4) return htim->Instance->CCR4;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	hdma->Instance->CR = hdma->Init.Channel | hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc |
+		hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment | hdma->Init.Mode | hdma->Init.Priority;
+	hdma->ErrorCode = 0;
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the stream is only armed, the mock has no conversions which would request a transfer
+	hdma->Instance->PAR = SrcAddress;
+	hdma->Instance->M0AR = DstAddress;
+	hdma->Instance->NDTR = DataLength;
+	hdma->Instance->CR |= 1;
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	hdma->Instance->CR &= ~1U;
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return (MockFlash() != NULL) ? HAL_OK : HAL_ERROR;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	static const uint32_t sizes[] = { 1, 2, 4, 8 };
+	uint8_t* flash = MockFlash();
+
+	if (flash == NULL || TypeProgram > FLASH_TYPEPROGRAM_DOUBLEWORD) return HAL_ERROR;
+	if (Address < FLASH_BASE || Address + sizes[TypeProgram] > FLASH_BASE + FLASH_SIZE) return HAL_ERROR;
+
+	// programming can only clear bits, like on the real flash
+	for (uint32_t i = 0; i < sizes[TypeProgram]; i++)
+	{
+		flash[Address - FLASH_BASE + i] &= (uint8_t)(Data >> (8 * i));
+	}
+	return HAL_OK;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// sector layout of the 1 MB STM32F746: 4 x 32 KB, 1 x 128 KB, 3 x 256 KB
+	static const uint32_t offsets[] = { 0x00000, 0x08000, 0x10000, 0x18000, 0x20000, 0x40000, 0x80000, 0xC0000, 0x100000 };
+	uint8_t* flash = MockFlash();
+
+	*SectorError = 0xFFFFFFFFU;
+	if (flash == NULL) return HAL_ERROR;
+
+	if (pEraseInit->TypeErase == FLASH_TYPEERASE_MASSERASE)
+	{
+		memset(flash, 0xFF, FLASH_SIZE);
+		return HAL_OK;
+	}
+
+	for (uint32_t sector = pEraseInit->Sector; sector < pEraseInit->Sector + pEraseInit->NbSectors; sector++)
+	{
+		if (sector > FLASH_SECTOR_7)
+		{
+			*SectorError = sector;
+			return HAL_ERROR;
+		}
+		memset(flash + offsets[sector], 0xFF, offsets[sector + 1] - offsets[sector]);
+	}
+	return HAL_OK;
+}
+
 
 // --------------------------------------------------------------------------------------------------------------------
 static uint8_t ExecDriverProcessorSPI(uint8_t input)
@@ -635,6 +1518,9 @@ static uint8_t ExecDriverProcessorSPI(uint8_t input)
 		myConfig.regs.status = STATUS_HIGHZ_MASK | STATUS_OCD_MASK | STATUS_THR_SHORTD_MASK | STATUS_THR_WARN_MASK | STATUS_UNDERVOLT_MASK;
 	}
 
+	// the current and the power stage change with the command, the model catches up with the time before
+	if (mockPlant.enabled) MockPlantUpdate();
+
 	uint8_t output = STEP_CMD_NOP_PREFIX;
 
 	switch (myConfig.state)
@@ -723,6 +1609,7 @@ static uint8_t ExecDriverProcessorSPI(uint8_t input)
 	case 0x51:
 		output = myConfig.regs.status;
 		myConfig.state = 0x00;
+		MockPlantReleaseFlags();
 		break;
 
 	default:
@@ -449,6 +449,21 @@ typedef struct L6474x_Platform
 
 } L6474x_Platform_t;
 
+/*!
+ * The L6474_StaticHandle_t structure is a placeholder with the size and alignment of an instance of the library. The
+ * caller provides it to L6474_CreateStaticInstance, so the instance is placed at an address which is fixed at link
+ * time and no malloc abstraction is required. The members must not be accessed
+ */
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+// --------------------------------------------------------------------------------------------------------------------
+{
+	int               dummy1[2];
+	void*             dummy2[3];
+	L6474x_Platform_t dummy3;
+	int               dummy4;
+} L6474_StaticHandle_t;
+
 /*!
  * The L6474_Property_t enum is a address representation for externally changeable properties by the library via the
  * API commands. In case the torque shall be changed, the user can call L6474_SetProperty with the L6474_PROP_TORQUE
@@ -543,8 +558,19 @@ typedef struct
  */
 L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM);
 
+/*!
+ * L6474_CreateStaticInstance works like L6474_CreateInstance, but the instance is placed in the L6474_StaticHandle_t
+ * buffer which is provided by the caller and must stay valid until the instance is destroyed. The malloc and free
+ * abstraction functions of the platform are not required and not used.
+ *
+ * In case it fails, a null pointer is returned. In case it was successful, a handle pointer is returned which is always
+ * required for all other API calls
+ */
+L6474_Handle_t L6474_CreateStaticInstance(L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM, L6474_StaticHandle_t* pBuffer);
+
 /*!
  * L6474_DestroyInstance is used to destroy a library instance which has been previously created by a call to L6474_CreateInstance
+ * or L6474_CreateStaticInstance. The buffer of a static instance is not released, it can be used for a new instance afterwards
  *
  * The function returns errcNONE in case no error happens or any other error code from L6474x_ErrorCode_t enum
  * in case of an error
@@ -950,6 +976,15 @@ int L6474_SetAlarmEnables(L6474_Handle_t h, int bits);
  *
  * \endcode
  * 
+ * Without heap, the instance is placed in a buffer of the caller and malloc and free can stay null
+ * 
+ * \code
+ * 
+ * static L6474_StaticHandle_t buffer;
+ * L6474_Handle_t h = L6474_CreateStaticInstance(&p, null, null, null, &buffer);
+ *
+ * \endcode
+ * 
  * The following example shows a really simple instantiation and usage
  * of the library with a simple default and straight forward configuration
  * and no calculation of any step widths or resolutions
@@ -152,8 +152,12 @@ struct L6474_Handle
 	void*             pGPO;
 	void*             pPWM;
 	L6474x_Platform_t platform;
+	int               isStatic;
 };
 
+// the placeholder of the public header must be able to hold an instance, a negative array size breaks the build
+typedef char L6474_StaticHandleSizeCheck[( sizeof(L6474_StaticHandle_t) >= sizeof(struct L6474_Handle) ) ? 1 : -1];
+
 // --------------------------------------------------------------------------------------------------------------------
 static const L6474x_ParameterDescriptor_t L6474_Parameters[STEP_REG_RANGE_MASK]
 // --------------------------------------------------------------------------------------------------------------------
@@ -437,13 +441,13 @@ static int L6474_DisableCommand(L6474_Handle_t h)
 
 
 // --------------------------------------------------------------------------------------------------------------------
-L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM)
+static int L6474_HelperCheckPlatform(L6474x_Platform_t* p)
 // --------------------------------------------------------------------------------------------------------------------
 {
 	if ( p == 0 )
 		return 0;
 
-	if ( ( p->reset == 0 ) || ( p->malloc == 0 ) || (p->free == 0) || (p->sleep == 0) || ( p->transfer == 0 ) )
+	if ( ( p->reset == 0 ) || (p->sleep == 0) || ( p->transfer == 0 ) )
 		return 0;
 
 #if defined(LIBL6474_HAS_LOCKING) && LIBL6474_HAS_LOCKING == 1
@@ -464,10 +468,13 @@ L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO,
 		return 0;
 #endif
 
-	L6474_Handle_t h = p->malloc(sizeof(struct L6474_Handle));
-	if ( h == 0 )
-		return 0;
+	return 1;
+}
 
+// --------------------------------------------------------------------------------------------------------------------
+static L6474_Handle_t L6474_HelperSetupInstance(L6474_Handle_t h, L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM, int isStatic)
+// --------------------------------------------------------------------------------------------------------------------
+{
 	h->pGPO                = pGPO;
 	h->pIO                 = pIO;
 	h->pPWM                = pPWM;
@@ -484,6 +491,7 @@ L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO,
 	h->platform.transfer   = p->transfer;
 	h->pending             = 0;
 	h->state               = stRESET;
+	h->isStatic            = isStatic;
 
 	h->platform.reset(h->pGPO, 1);
 
@@ -491,6 +499,33 @@ L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO,
 	return h;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+L6474_Handle_t L6474_CreateInstance(L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( L6474_HelperCheckPlatform(p) == 0 )
+		return 0;
+
+	if ( ( p->malloc == 0 ) || (p->free == 0) )
+		return 0;
+
+	L6474_Handle_t h = p->malloc(sizeof(struct L6474_Handle));
+	if ( h == 0 )
+		return 0;
+
+	return L6474_HelperSetupInstance(h, p, pIO, pGPO, pPWM, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+L6474_Handle_t L6474_CreateStaticInstance(L6474x_Platform_t* p, void* pIO, void* pGPO, void* pPWM, L6474_StaticHandle_t* pBuffer)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( ( pBuffer == 0 ) || ( L6474_HelperCheckPlatform(p) == 0 ) )
+		return 0;
+
+	return L6474_HelperSetupInstance((L6474_Handle_t)pBuffer, p, pIO, pGPO, pPWM, 1);
+}
+
 
 // --------------------------------------------------------------------------------------------------------------------
 int L6474_DestroyInstance(L6474_Handle_t h)
@@ -506,7 +541,8 @@ int L6474_DestroyInstance(L6474_Handle_t h)
 #if defined(LIBL6474_HAS_LOCKING) && LIBL6474_HAS_LOCKING == 1
 	void  (*pUnlock)(void) = h->platform->unlock;
 #endif
-	h->platform.free(h);
+	if ( h->isStatic == 0 )
+		h->platform.free(h);
 
 #if defined(LIBL6474_HAS_LOCKING) && LIBL6474_HAS_LOCKING == 1
 	if ( pUnlock != 0 )
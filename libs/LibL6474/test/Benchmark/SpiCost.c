@@ -0,0 +1,383 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+// SPI transaction cost of the LibL6474 API
+//
+// Every public function of the library runs once against a counting stub of the platform, which answers like a
+// L6474 behind the transfer function. The table lists per call the transfers, the bytes, the status reads and the
+// requested sleeps, and models the time on the bus for a SPI clock and an overhead per byte, which is the chip
+// select toggling of the firmware (StepDriverSpiTransfer selects the driver for every byte and waits one tick).
+//
+// The library is built with the config of the firmware, so the table shows the costs of the firmware.
+// --------------------------------------------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LibL6474.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+#define STATUS_HIGHZ_MASK       ( 1 <<  0 )
+#define STATUS_ALARM_MASK       ( ( 1 << 9 ) | ( 1 << 10 ) | ( 1 << 11 ) | ( 1 << 12 ) ) // active low
+
+#define CMD_NOP         0x00
+#define CMD_GET_PREFIX  0x20
+#define CMD_ENABLE      0xB8
+#define CMD_DISABLE     0xA8
+#define CMD_GET_STATUS  0xD0
+#define REG_RANGE_MASK  0x1F
+#define REG_CMD_MASK    0xE0
+
+#define SPI1_CLOCK_HZ   2812500.0   // APB2 90 MHz with prescaler 32, see MX_SPI1_Init
+#define CS_OVERHEAD_US  1000.0      // HAL_Delay(1) after every byte of StepDriverSpiTransfer
+#define TABLE_SIZE      16384
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+    unsigned long transfers;
+    unsigned long bytes;
+    unsigned long statusReads;
+    unsigned long sleeps;
+    unsigned long sleepMs;
+} Counters_t;
+
+// register file of the stub, the values are the reset defaults of the data sheet
+static const uint32_t resetRegisters[REG_RANGE_MASK + 1] =
+{
+    [0x09] = 0x29, [0x0E] = 0x19, [0x0F] = 0x29, [0x10] = 0x29, [0x13] = 0x08, [0x16] = 0x07, [0x17] = 0xFF,
+    [0x18] = 0x2E88
+};
+
+static const uint8_t registerLength[REG_RANGE_MASK + 1] =
+{
+    [0x01] = 3, [0x02] = 2, [0x03] = 3, [0x09] = 1, [0x0E] = 1, [0x0F] = 1, [0x10] = 1, [0x12] = 1, [0x13] = 1,
+    [0x16] = 1, [0x17] = 1, [0x18] = 2, [0x19] = 2
+};
+
+static struct
+{
+    int inReset;
+    int highZ;
+    uint32_t registers[REG_RANGE_MASK + 1];
+    Counters_t count;
+} chip;
+
+// --------------------------------------------------------------------------------------------------------------------
+static void* StubMalloc(unsigned int size)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return malloc(size);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void StubFree(const void* const pMem)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    free((void*)pMem);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void StubReset(void* pGPO, const int ena)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)pGPO;
+    chip.inReset = ena;
+    if (ena)
+    {
+        memcpy(chip.registers, resetRegisters, sizeof(chip.registers));
+        chip.highZ = 1;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void StubSleep(unsigned int ms)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    chip.count.sleeps += 1;
+    chip.count.sleepMs += ms;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int StubStepAsync(void* pPWM, int dir, unsigned int numPulses, void (*doneClb)(L6474_Handle_t), L6474_Handle_t h)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)pPWM;
+    (void)dir;
+    (void)numPulses;
+    (void)doneClb;
+    (void)h;
+
+    // the pulses keep running, so StopMovement has something to cancel
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int StubCancelStep(void* pPWM)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)pPWM;
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int StubTransfer(void* pIO, char* pRX, const char* pTX, unsigned int length)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)pIO;
+
+    chip.count.transfers += 1;
+    chip.count.bytes += length;
+    memset(pRX, 0, length);
+    if (chip.inReset) return 0;
+
+    uint8_t cmd = (uint8_t)pTX[0];
+    uint8_t reg = cmd & REG_RANGE_MASK;
+    if (cmd == CMD_GET_STATUS)
+    {
+        // the alarm flags are active low, no alarm is pending
+        uint32_t status = STATUS_ALARM_MASK | (chip.highZ ? STATUS_HIGHZ_MASK : 0);
+        chip.count.statusReads += 1;
+        pRX[1] = (char)(status >> 8);
+        pRX[2] = (char)(status >> 0);
+    }
+    else if (cmd == CMD_ENABLE)
+    {
+        chip.highZ = 0;
+    }
+    else if (cmd == CMD_DISABLE)
+    {
+        chip.highZ = 1;
+    }
+    else if ((cmd & REG_CMD_MASK) == CMD_GET_PREFIX)
+    {
+        for (unsigned int i = 1; i < length && i <= registerLength[reg]; i++)
+        {
+            pRX[i] = (char)(chip.registers[reg] >> (8 * (registerLength[reg] - i)));
+        }
+    }
+    else if ((cmd & REG_CMD_MASK) == 0 && cmd != CMD_NOP)
+    {
+        uint32_t value = 0;
+        for (unsigned int i = 1; i < length; i++) value = (value << 8) | (uint8_t)pTX[i];
+        chip.registers[reg] = value;
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static L6474x_Platform_t platform =
+// --------------------------------------------------------------------------------------------------------------------
+{
+    .malloc     = StubMalloc,
+    .free       = StubFree,
+    .transfer   = StubTransfer,
+    .reset      = StubReset,
+    .sleep      = StubSleep,
+    .stepAsync  = StubStepAsync,
+    .cancelStep = StubCancelStep,
+};
+
+// ====================================================================================================================
+// area of the measured calls, every call starts with a fresh instance in the state of its precondition
+// ====================================================================================================================
+
+typedef enum { preNONE, preRESET, preDISABLED, preENABLED, preMOVING } Precondition_t;
+
+static const char* preconditionNames[] = { "-", "reset", "disabled", "enabled", "moving" };
+
+static L6474_Handle_t h;
+
+static int RunCreate(void)             { h = L6474_CreateInstance(&platform, NULL, NULL, NULL); return (h == NULL) ? -1 : 0; }
+static int RunDestroy(void)            { int r = L6474_DestroyInstance(h); h = NULL; return r; }
+static int RunResetStandBy(void)       { return L6474_ResetStandBy(h); }
+static int RunInitialize(void)         { L6474_BaseParameter_t p; L6474_SetBaseParameter(&p); return L6474_Initialize(h, &p); }
+static int RunSetStepMode(void)        { return L6474_SetStepMode(h, smMICRO16); }
+static int RunGetStepMode(void)        { L6474x_StepMode_t m; return L6474_GetStepMode(h, &m); }
+static int RunPowerOn(void)            { return L6474_SetPowerOutputs(h, 1); }
+static int RunPowerOff(void)           { return L6474_SetPowerOutputs(h, 0); }
+static int RunGetStatus(void)          { L6474_Status_t s; return L6474_GetStatus(h, &s); }
+static int RunGetState(void)           { L6474x_State_t s; return L6474_GetState(h, &s); }
+static int RunStepIncremental(void)    { return L6474_StepIncremental(h, 1000); }
+static int RunStopMovement(void)       { return L6474_StopMovement(h); }
+static int RunIsMoving(void)           { int m; return L6474_IsMoving(h, &m); }
+static int RunSetProperty(void)        { return L6474_SetProperty(h, L6474_PROP_TORQUE, 0x20); }
+static int RunGetProperty(void)        { int v; return L6474_GetProperty(h, L6474_PROP_TORQUE, &v); }
+static int RunGetAbsolutePosition(void){ int v; return L6474_GetAbsolutePosition(h, &v); }
+static int RunSetAbsolutePosition(void){ return L6474_SetAbsolutePosition(h, 0); }
+static int RunGetElectricalPos(void)   { int v; return L6474_GetElectricalPosition(h, &v); }
+static int RunSetElectricalPos(void)   { return L6474_SetElectricalPosition(h, 0); }
+static int RunGetPositionMark(void)    { int v; return L6474_GetPositionMark(h, &v); }
+static int RunSetPositionMark(void)    { return L6474_SetPositionMark(h, 0); }
+static int RunGetAlarmEnables(void)    { int v; return L6474_GetAlarmEnables(h, &v); }
+static int RunSetAlarmEnables(void)    { return L6474_SetAlarmEnables(h, 0xFF); }
+
+// --------------------------------------------------------------------------------------------------------------------
+static const struct
+{
+    const char* name;
+    Precondition_t pre;
+    int (*run)(void);
+} calls[] =
+{
+    { "L6474_CreateInstance",          preNONE,     RunCreate              },
+    { "L6474_Initialize",              preRESET,    RunInitialize          },
+    { "L6474_Initialize",              preDISABLED, RunInitialize          },
+    { "L6474_ResetStandBy",            preENABLED,  RunResetStandBy        },
+    { "L6474_SetStepMode",             preDISABLED, RunSetStepMode         },
+    { "L6474_GetStepMode",             preDISABLED, RunGetStepMode         },
+    { "L6474_SetPowerOutputs(1)",      preDISABLED, RunPowerOn             },
+    { "L6474_SetPowerOutputs(0)",      preENABLED,  RunPowerOff            },
+    { "L6474_GetStatus",               preENABLED,  RunGetStatus           },
+    { "L6474_GetState",                preENABLED,  RunGetState            },
+    { "L6474_StepIncremental",         preENABLED,  RunStepIncremental     },
+    { "L6474_IsMoving",                preMOVING,   RunIsMoving            },
+    { "L6474_StopMovement",            preMOVING,   RunStopMovement        },
+    { "L6474_SetProperty",             preENABLED,  RunSetProperty         },
+    { "L6474_GetProperty",             preENABLED,  RunGetProperty         },
+    { "L6474_GetAbsolutePosition",     preENABLED,  RunGetAbsolutePosition },
+    { "L6474_SetAbsolutePosition",     preENABLED,  RunSetAbsolutePosition },
+    { "L6474_GetElectricalPosition",   preENABLED,  RunGetElectricalPos    },
+    { "L6474_SetElectricalPosition",   preENABLED,  RunSetElectricalPos    },
+    { "L6474_GetPositionMark",         preENABLED,  RunGetPositionMark     },
+    { "L6474_SetPositionMark",         preENABLED,  RunSetPositionMark     },
+    { "L6474_GetAlarmEnables",         preENABLED,  RunGetAlarmEnables     },
+    { "L6474_SetAlarmEnables",         preENABLED,  RunSetAlarmEnables     },
+    { "L6474_DestroyInstance",         preENABLED,  RunDestroy             },
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Prepare(Precondition_t pre)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (h != NULL) L6474_DestroyInstance(h);
+    h = NULL;
+    if (pre == preNONE) return 0;
+
+    if (RunCreate() != 0) return -1;
+    if (pre == preRESET) return 0;
+
+    if (RunInitialize() != 0) return -1;
+    if (pre == preDISABLED) return 0;
+
+    if (RunPowerOn() != 0) return -1;
+    if (pre == preENABLED) return 0;
+
+    return RunStepIncremental();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Measure(char* table, size_t size, double clockHz, double csOverheadUs)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    int len = snprintf(table, size,
+        "# SPI cost of the LibL6474 API\n"
+        "\n"
+        "Generated by SpiCost with the LibL6474Config.h of the firmware, %.0f Hz SPI clock and %.1f us overhead per\n"
+        "byte. The time is the modeled time on the bus plus the requested sleeps.\n"
+        "\n"
+        "| call | precondition | result | transfers | bytes | status reads | sleeps | sleep ms | time us |\n"
+        "|------|--------------|-------:|----------:|------:|-------------:|-------:|---------:|--------:|\n",
+        clockHz, csOverheadUs);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(calls) / sizeof(calls[0]); i++)
+    {
+        if (Prepare(calls[i].pre) != 0)
+        {
+            fprintf(stderr, "%s: the precondition %s failed\n", calls[i].name, preconditionNames[calls[i].pre]);
+            return -1;
+        }
+
+        memset(&chip.count, 0, sizeof(chip.count));
+        int result = calls[i].run();
+        if (result < 0) failed += 1;
+
+        const Counters_t* c = &chip.count;
+        double us = (double)c->bytes * (8.0e6 / clockHz + csOverheadUs) + (double)c->sleepMs * 1000.0;
+        len += snprintf(table + len, size - (size_t)len, "| %s | %s | %d | %lu | %lu | %lu | %lu | %lu | %.1f |\n",
+            calls[i].name, preconditionNames[calls[i].pre], result, c->transfers, c->bytes, c->statusReads,
+            c->sleeps, c->sleepMs, us);
+        if ((size_t)len >= size) return -1;
+    }
+
+    if (h != NULL) L6474_DestroyInstance(h);
+    h = NULL;
+    return failed;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Check(const char* table, const char* path)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    static char stored[TABLE_SIZE];
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return 2;
+    }
+    size_t len = fread(stored, 1, sizeof(stored) - 1, f);
+    fclose(f);
+    stored[len] = '\0';
+
+    if (strcmp(stored, table) == 0) return 0;
+
+    // the first differing line tells which call has changed its cost
+    const char* a = table;
+    const char* b = stored;
+    while (*a != '\0' && *a == *b) a++, b++;
+    while (a > table && a[-1] != '\n') a--, b--;
+    fprintf(stderr, "the SPI cost differs from %s\n  now:    %.*s\n  stored: %.*s\n", path,
+        (int)strcspn(a, "\n"), a, (int)strcspn(b, "\n"), b);
+    return 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    double clockHz = SPI1_CLOCK_HZ;
+    double csOverheadUs = CS_OVERHEAD_US;
+    const char* output = NULL;
+    const char* check = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:c:o:k:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f': clockHz = strtod(optarg, NULL); break;
+        case 'c': csOverheadUs = strtod(optarg, NULL); break;
+        case 'o': output = optarg; break;
+        case 'k': check = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-f spi clock Hz] [-c overhead per byte us] [-o table.md] [-k stored table.md]\n",
+                argv[0]);
+            return 2;
+        }
+    }
+    if (clockHz <= 0.0 || csOverheadUs < 0.0)
+    {
+        fprintf(stderr, "the SPI clock must be positive and the overhead must not be negative\n");
+        return 2;
+    }
+
+    static char table[TABLE_SIZE];
+    int failed = Measure(table, sizeof(table), clockHz, csOverheadUs);
+    if (failed < 0) return 2;
+    if (failed > 0) fprintf(stderr, "%d calls failed, see the result column\n", failed);
+
+    if (check != NULL) return Check(table, check);
+
+    FILE* f = (output == NULL) ? stdout : fopen(output, "w");
+    if (f == NULL)
+    {
+        perror(output);
+        return 2;
+    }
+    fputs(table, f);
+    if (f != stdout) fclose(f);
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,506 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+// Replay harness for performance regressions of the console, the stepper commands and LibL6474.
+//
+// record: forwards the keyboard to the console of the board (or of the simulator pseudo terminal) and writes every
+//         input chunk with its time into a session file, Ctrl-] ends the recording.
+// replay: runs the session against the Linux simulator in virtual time, so every replay gives the same timing, and
+//         derives per command the latency up to the next prompt, the time until the last step edge, the number of
+//         steps and the SPI transfers to the driver. With a baseline the metrics are compared and a slowdown fails
+//         the replay.
+//
+// The steps and transfers of a command are counted up to the next command, so an asynchronous move which runs on
+// is attributed to the commands which follow it.
+// --------------------------------------------------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SessionFormat.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+#define MAX_COMMAND      256
+#define MAX_LINE         4096
+#define PROMPT           "$>"
+#define RECORD_END_KEY   0x1D     // Ctrl-]
+#define SLACK_MS         1.0      // absolute tolerance of the times, below the resolution of a recorded session
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+    char text[MAX_COMMAND];
+    double latencyMs;
+    double motionMs;
+    unsigned long long steps;
+    unsigned long long spi;
+} Metric_t;
+
+typedef struct
+{
+    Metric_t* items;
+    int count;
+    int cap;
+} Metrics_t;
+
+// --------------------------------------------------------------------------------------------------------------------
+static Metric_t* AddMetric(Metrics_t* m)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (m->count == m->cap)
+    {
+        m->cap = (m->cap == 0) ? 64 : m->cap * 2;
+        Metric_t* grown = realloc(m->items, (size_t)m->cap * sizeof(Metric_t));
+        if (grown == NULL) return NULL;
+        m->items = grown;
+    }
+    Metric_t* item = &m->items[m->count++];
+    memset(item, 0, sizeof(*item));
+    item->latencyMs = -1.0;
+    return item;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Record(const char* port, const char* path, speed_t baud)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    int fd = open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(port);
+        return 2;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, baud);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        close(fd);
+        return 2;
+    }
+    fprintf(out, "# console session recorded from %s, \"<ms> <input bytes>\" per line\n", port);
+
+    // the keys go to the console unprocessed, the echo comes from the console
+    struct termios saved;
+    int isTty = (tcgetattr(STDIN_FILENO, &saved) == 0);
+    if (isTty)
+    {
+        struct termios raw = saved;
+        cfmakeraw(&raw);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+    fprintf(stderr, "recording %s into %s, Ctrl-] ends\r\n", port, path);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int result = 0;
+    char buf[256];
+    while (1)
+    {
+        struct pollfd pfd[2] = { { .fd = STDIN_FILENO, .events = POLLIN }, { .fd = fd, .events = POLLIN } };
+        if (poll(pfd, 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            result = 2;
+            break;
+        }
+
+        if (pfd[1].revents & (POLLIN | POLLHUP))
+        {
+            ssize_t len = read(fd, buf, sizeof(buf));
+            if (len <= 0) break;
+            if (write(STDOUT_FILENO, buf, (size_t)len) < 0) { ; }
+        }
+
+        if (pfd[0].revents & (POLLIN | POLLHUP))
+        {
+            ssize_t len = read(STDIN_FILENO, buf, sizeof(buf));
+            if (len <= 0) break;
+
+            char* end = memchr(buf, RECORD_END_KEY, (size_t)len);
+            if (end != NULL) len = end - buf;
+            if (len > 0)
+            {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long long ms = (long long)(now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+
+                if (write(fd, buf, (size_t)len) < 0) { ; }
+                fprintf(out, "%lld ", ms);
+                SessionWriteBytes(out, buf, (size_t)len);
+                fputc('\n', out);
+            }
+            if (end != NULL) break;
+        }
+    }
+
+    if (isTty) tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    fclose(out);
+    close(fd);
+    return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int RunSimulator(const char* simulator, const char* session, const char* log)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // the console output is in the log, only the messages of the simulator are shown
+        int nullFd = open("/dev/null", O_RDWR);
+        if (nullFd >= 0)
+        {
+            dup2(nullFd, STDIN_FILENO);
+            dup2(nullFd, STDOUT_FILENO);
+            close(nullFd);
+        }
+        execl(simulator, simulator, "--stdio", "--virtual", "--session", session, "--console-log", log,
+            "--time-limit", "600", (char*)NULL);
+        perror(simulator);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR) return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "the simulator failed with status 0x%x\n", status);
+        return -1;
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ParseLog(const char* path, Metrics_t* m)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[MAX_LINE * 4 + 128];
+    char bytes[MAX_LINE];
+    char text[MAX_COMMAND];
+    size_t textLen = 0;
+    char last = 0;
+    Metric_t* current = NULL;
+    unsigned long long inNs = 0, inSteps = 0, inSpi = 0;
+    unsigned long long steps = 0, lastEdgeNs = 0, spi = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char dir;
+        unsigned long long ns;
+        int used = 0;
+        size_t len;
+        if (sscanf(line, "%c %llu %llu %llu %llu %n", &dir, &ns, &steps, &lastEdgeNs, &spi, &used) != 5 ||
+            SessionParseBytes(line + used, bytes, sizeof(bytes), &len) == NULL)
+        {
+            fprintf(stderr, "%s: invalid record %s", path, line);
+            fclose(f);
+            return -1;
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            char c = bytes[i];
+            if (dir == 'O')
+            {
+                // the first prompt after the command ends its latency
+                if (current != NULL && current->latencyMs < 0.0 && last == PROMPT[0] && c == PROMPT[1])
+                {
+                    current->latencyMs = (double)(ns - inNs) / 1e6;
+                }
+                last = c;
+            }
+            else if (c == '\r' || c == '\n')
+            {
+                if (textLen == 0) continue;
+
+                // the line end hands the command to the console, the previous command ends here
+                if (current != NULL)
+                {
+                    current->steps = steps - inSteps;
+                    current->spi = spi - inSpi;
+                    current->motionMs = (current->steps > 0 && lastEdgeNs > inNs) ? (double)(lastEdgeNs - inNs) / 1e6 : 0.0;
+                }
+                current = AddMetric(m);
+                if (current == NULL)
+                {
+                    fclose(f);
+                    return -1;
+                }
+                memcpy(current->text, text, textLen);
+                current->text[textLen] = '\0';
+                inNs = ns;
+                inSteps = steps;
+                inSpi = spi;
+                textLen = 0;
+            }
+            else if (c == '\b' || c == 0x7F)
+            {
+                if (textLen > 0) textLen -= 1;
+            }
+            else if (c >= 0x20 && c < 0x7F && textLen + 1 < sizeof(text))
+            {
+                text[textLen++] = c;
+            }
+        }
+    }
+    fclose(f);
+
+    if (current != NULL)
+    {
+        current->steps = steps - inSteps;
+        current->spi = spi - inSpi;
+        current->motionMs = (current->steps > 0 && lastEdgeNs > inNs) ? (double)(lastEdgeNs - inNs) / 1e6 : 0.0;
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int WriteMetrics(const char* path, const Metrics_t* m)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = (path == NULL) ? stdout : fopen(path, "w");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    // the command is the last column, it may contain commas
+    fprintf(f, "index,latency_ms,motion_ms,steps,spi,command\n");
+    for (int i = 0; i < m->count; i++)
+    {
+        const Metric_t* it = &m->items[i];
+        fprintf(f, "%d,%.3f,%.3f,%llu,%llu,%s\n", i, it->latencyMs, it->motionMs, it->steps, it->spi, it->text);
+    }
+
+    if (f != stdout) fclose(f);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ReadMetrics(const char* path, Metrics_t* m)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[MAX_LINE];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (++lineNo == 1) continue;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        Metric_t* it = AddMetric(m);
+        int index;
+        int used = 0;
+        if (it == NULL || sscanf(line, "%d,%lf,%lf,%llu,%llu,%n", &index, &it->latencyMs, &it->motionMs, &it->steps,
+            &it->spi, &used) != 5 || used == 0)
+        {
+            fprintf(stderr, "%s:%d: invalid metrics\n", path, lineNo);
+            fclose(f);
+            return -1;
+        }
+        snprintf(it->text, sizeof(it->text), "%s", line + used);
+    }
+    fclose(f);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Slower(double value, double base, double tolerance)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return value > base * (1.0 + tolerance / 100.0) + SLACK_MS;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Compare(const Metrics_t* m, const Metrics_t* base, double tolerance)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (m->count != base->count)
+    {
+        printf("the replay has %d commands, the baseline %d\n", m->count, base->count);
+        return 1;
+    }
+
+    int slower = 0, faster = 0, changed = 0;
+    for (int i = 0; i < m->count; i++)
+    {
+        const Metric_t* a = &m->items[i];
+        const Metric_t* b = &base->items[i];
+        if (strcmp(a->text, b->text) != 0)
+        {
+            printf("command %d is \"%s\", the baseline has \"%s\"\n", i, a->text, b->text);
+            return 1;
+        }
+
+        // a different number of steps is a change of the behaviour, not of the timing
+        const char* verdict = NULL;
+        if (a->steps != b->steps) { verdict = "CHANGED"; changed++; }
+        else if (Slower(a->latencyMs, b->latencyMs, tolerance) || Slower(a->motionMs, b->motionMs, tolerance) ||
+            a->spi > b->spi + (unsigned long long)((double)b->spi * tolerance / 100.0)) { verdict = "SLOWER"; slower++; }
+        else if (Slower(b->latencyMs, a->latencyMs, tolerance) || Slower(b->motionMs, a->motionMs, tolerance) ||
+            b->spi > a->spi + (unsigned long long)((double)a->spi * tolerance / 100.0)) { verdict = "faster"; faster++; }
+        if (verdict == NULL) continue;
+
+        printf("%-7s %3d %-36s latency %9.3f ms (%9.3f)  motion %9.3f ms (%9.3f)  steps %6llu (%6llu)  spi %6llu (%6llu)\n",
+            verdict, i, a->text, a->latencyMs, b->latencyMs, a->motionMs, b->motionMs, a->steps, b->steps, a->spi, b->spi);
+    }
+
+    printf("%d commands, %d slower, %d faster, %d changed (tolerance %.1f %% + %.1f ms)\n", m->count, slower, faster,
+        changed, tolerance, SLACK_MS);
+    return (slower != 0 || changed != 0) ? 1 : 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Usage(const char* self)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fprintf(stderr,
+        "usage: %s record [-b baud] <port> <session>\n"
+        "       %s replay [-s simulator] [-b baseline] [-u] [-t percent] [-o metrics.csv] [-l log] <session>\n",
+        self, self);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (argc < 2)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+    const char* mode = argv[1];
+    argv[1] = argv[0];
+    argc -= 1;
+    argv += 1;
+
+    if (strcmp(mode, "record") == 0)
+    {
+        speed_t baud = B115200;
+        int opt;
+        while ((opt = getopt(argc, argv, "b:")) != -1)
+        {
+            if (opt == 'b' && strcmp(optarg, "9600") == 0) baud = B9600;
+            else if (opt == 'b' && strcmp(optarg, "115200") == 0) baud = B115200;
+            else if (opt == 'b' && strcmp(optarg, "921600") == 0) baud = B921600;
+            else
+            {
+                Usage(argv[0]);
+                return 2;
+            }
+        }
+        if (optind + 2 != argc)
+        {
+            Usage(argv[0]);
+            return 2;
+        }
+        return Record(argv[optind], argv[optind + 1], baud);
+    }
+    if (strcmp(mode, "replay") != 0)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    // the simulator is built next to the harness
+    char simulator[1024];
+    char selfBuf[1024];
+    snprintf(selfBuf, sizeof(selfBuf), "%s", argv[0]);
+    snprintf(simulator, sizeof(simulator), "%s/FreeRTOSPosix", dirname(selfBuf));
+
+    const char* baseline = NULL;
+    const char* output = NULL;
+    const char* log = NULL;
+    int update = 0;
+    double tolerance = 5.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:ut:o:l:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': snprintf(simulator, sizeof(simulator), "%s", optarg); break;
+        case 'b': baseline = optarg; break;
+        case 'u': update = 1; break;
+        case 't': tolerance = strtod(optarg, NULL); break;
+        case 'o': output = optarg; break;
+        case 'l': log = optarg; break;
+        default: Usage(argv[0]); return 2;
+        }
+    }
+    if (optind + 1 != argc || (update && baseline == NULL))
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    char tmpLog[] = "/tmp/session-replay-XXXXXX";
+    if (log == NULL)
+    {
+        int fd = mkstemp(tmpLog);
+        if (fd < 0)
+        {
+            perror("mkstemp");
+            return 2;
+        }
+        close(fd);
+        log = tmpLog;
+    }
+
+    Metrics_t metrics = { 0 };
+    int failed = RunSimulator(simulator, argv[optind], log) != 0 || ParseLog(log, &metrics) != 0;
+    if (log == tmpLog) unlink(tmpLog);
+    if (failed) return 2;
+
+    if (output != NULL && WriteMetrics(output, &metrics) != 0) return 2;
+    if (update)
+    {
+        return (WriteMetrics(baseline, &metrics) == 0) ? 0 : 2;
+    }
+    if (baseline == NULL)
+    {
+        return (output == NULL) ? WriteMetrics(NULL, &metrics) : 0;
+    }
+
+    Metrics_t base = { 0 };
+    if (ReadMetrics(baseline, &base) != 0) return 2;
+    return Compare(&metrics, &base, tolerance);
+}
@@ -447,6 +447,22 @@ static void mySleep(unsigned int ms)
     }
 }
 
+// buffer of the static instance tests and the number of calls of myCountingFree
+static L6474_StaticHandle_t myStaticHandle;
+static int myCountingFreeCalls = 0;
+
+// --------------------------------------------------------------------------------------------------------------------
+static void myCountingFree(void* ptr)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // the static buffer is never released, so a wrong call is counted instead of corrupting the heap
+    myCountingFreeCalls += 1;
+    if (ptr != &myStaticHandle)
+    {
+        free(ptr);
+    }
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 static DWORD WINAPI clbDelayThreadFunc(LPVOID lpThreadParameter)
 // --------------------------------------------------------------------------------------------------------------------
@@ -809,6 +825,74 @@ static void instance_creation_and_destruction(void** state)
     s->h = NULL;
 }
 
+// test case
+// --------------------------------------------------------------------------------------------------------------------
+static void null_test_static_instance_creation_buffer(void** state)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct myState* s = ((struct myState*)*state);
+
+    assert_null((s->h = L6474_CreateStaticInstance(&s->p, NULL, NULL, NULL, NULL)));
+    assert_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, NULL, NULL, NULL)));
+    assert_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, NULL, NULL)));
+    assert_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx, NULL)));
+}
+
+// test case
+// --------------------------------------------------------------------------------------------------------------------
+static void null_test_static_instance_creation_platform(void** state)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct myState* s = ((struct myState*)*state);
+    s->p.transfer = NULL;
+
+    // only malloc and free are optional for a static instance, the other platform functions are still checked
+    assert_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx, &myStaticHandle)));
+}
+
+// test case
+// --------------------------------------------------------------------------------------------------------------------
+static void non_null_test_static_instance_creation_without_heap(void** state)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct myState* s = ((struct myState*)*state);
+    s->p.malloc = NULL;
+    s->p.free = NULL;
+
+    // the heap instance still needs malloc and free, the static one is placed in the buffer
+    assert_null((s->h = L6474_CreateInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx)));
+    assert_non_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx, &myStaticHandle)));
+    assert_true((void*)s->h == (void*)&myStaticHandle);
+}
+
+// test case
+// --------------------------------------------------------------------------------------------------------------------
+static void static_instance_creation_and_destruction(void** state)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct myState* s = ((struct myState*)*state);
+    s->p.free = myCountingFree;
+    myCountingFreeCalls = 0;
+
+    // destroying a static instance must not release its buffer
+    assert_non_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx, &myStaticHandle)));
+    assert_int_equal(L6474_DestroyInstance(s->h), errcNONE);
+    s->h = NULL;
+    assert_int_equal(myCountingFreeCalls, 0);
+
+    // the buffer can be used again for a new instance
+    assert_non_null((s->h = L6474_CreateStaticInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx, &myStaticHandle)));
+    assert_int_equal(L6474_DestroyInstance(s->h), errcNONE);
+    s->h = NULL;
+    assert_int_equal(myCountingFreeCalls, 0);
+
+    // a heap instance with the same platform is released exactly once
+    assert_non_null((s->h = L6474_CreateInstance(&s->p, s->pIoCtx, s->pGpoCtx, s->pPwmCtx)));
+    assert_int_equal(L6474_DestroyInstance(s->h), errcNONE);
+    s->h = NULL;
+    assert_int_equal(myCountingFreeCalls, 1);
+}
+
 // test case
 // --------------------------------------------------------------------------------------------------------------------
 static void instance_status_state_test(void** t_state)
@@ -1291,6 +1375,10 @@ const struct CMUnitTest creation_an_destruction_tests[] = {
     cmocka_unit_test_setup_teardown(non_null_test_instance_creation_successful_3, myStartFixtureFunction1, myStopFixtureFunction1),
     cmocka_unit_test_setup_teardown(non_null_test_instance_creation_successful_4, myStartFixtureFunction1, myStopFixtureFunction1),
     cmocka_unit_test_setup_teardown(instance_creation_and_destruction,            myStartFixtureFunction1, myStopFixtureFunction1),
+    cmocka_unit_test_setup_teardown(null_test_static_instance_creation_buffer,    myStartFixtureFunction1, myStopFixtureFunction1),
+    cmocka_unit_test_setup_teardown(null_test_static_instance_creation_platform,  myStartFixtureFunction1, myStopFixtureFunction1),
+    cmocka_unit_test_setup_teardown(non_null_test_static_instance_creation_without_heap, myStartFixtureFunction1, myStopFixtureFunction1),
+    cmocka_unit_test_setup_teardown(static_instance_creation_and_destruction,     myStartFixtureFunction1, myStopFixtureFunction1),
 };
 
 // library tests with predefined instance
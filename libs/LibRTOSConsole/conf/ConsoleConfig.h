@@ -46,5 +46,67 @@
  */
 #define CONSOLE_HELP_MAX_LENGTH 512
 
+/*!
+ * Specifies the maximum number of chars of a stored script including all separators
+ */
+#define CONSOLE_SCRIPT_MAX_LENGTH 512
+
+/*!
+ * The console starts in machine mode without banner, echo and prompt when set to 1. It can be switched
+ * at runtime with the machine command anyway
+ */
+#define CONSOLE_MACHINE_MODE 0
+
+/*!
+ * Specifies the number of tagged commands which can be in flight in pipelined mode. Zero removes the
+ * pipelined mode completely. Every slot gets its own worker task
+ */
+#define CONSOLE_PIPELINE_WINDOW 4
+
+/*!
+ * Specifies the maximum number of chars of the captured output of one pipelined command
+ */
+#define CONSOLE_PIPELINE_RESPONSE_SIZE 256
+
+/*!
+ * Specifies the stack depth of the pipeline workers in words, zero uses the stack depth of the console
+ */
+#define CONSOLE_PIPELINE_STACK_DEPTH 0
+
+/*!
+ * Allocator of the line buffers, commands, aliases and scripts, e.g. a fixed-block pool of the user project.
+ * Both default to the malloc and free of the C library
+ */
+#define CONSOLE_MALLOC malloc
+
+/*!
+ * Release function which matches CONSOLE_MALLOC
+ */
+#define CONSOLE_FREE free
+
+/*!
+ * The instance, its task, lock guard, job queues, pipeline workers and line buffers are static when set to 1. Then
+ * there is only one instance and the heap is only used for the commands, aliases and scripts. It follows
+ * configSUPPORT_STATIC_ALLOCATION of the FreeRTOS config by default
+ */
+#define CONSOLE_STATIC_ALLOCATION configSUPPORT_STATIC_ALLOCATION
+
+/*!
+ * Specifies the size of the static stack of the console task in words, the stack depth which is passed to
+ * CONSOLE_CreateInstance must not be larger. Without CONSOLE_PIPELINE_STACK_DEPTH the pipeline workers use it as well
+ */
+#define CONSOLE_STATIC_STACK_DEPTH (4 * configMINIMAL_STACK_SIZE)
+
+/*!
+ * Hooks around the call of a command function, e.g. for an event trace of the user project. cmd is the name of the
+ * command with cmdLen chars, it is not terminated. Both are empty by default
+ */
+#define CONSOLE_TRACE_COMMAND_BEGIN(cmd, cmdLen)
+
+/*!
+ * Called behind the command function with its result, see CONSOLE_TRACE_COMMAND_BEGIN
+ */
+#define CONSOLE_TRACE_COMMAND_END(cmd, cmdLen, result)
+
 
 #endif /* INC_CONSOLE_CONSOLECONFIG_H_ */
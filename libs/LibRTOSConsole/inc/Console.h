@@ -99,6 +99,37 @@ int CONSOLE_RegisterAlias( ConsoleHandle_t h, char* cmd, char* aliasCmd );
  */
 int CONSOLE_RemoveAliasOrCommand( ConsoleHandle_t h, char* cmd);
 
+/*!
+ * The CONSOLE_SetCommandConcurrent function marks a registered command as safe to be executed by several tasks at
+ * the same time, e.g. because it protects its resources with its own mutex. In pipelined mode all other commands
+ * are executed one after another, so a long running concurrent command does not block them. Returns -1 when
+ * there is no such command, otherwise 0
+ *
+ * @param h is of type ConsoleHandle_t which is created by a call of CONSOLE_CreateInstance
+ * @param cmd is of type char* which is the case sensitive name of the command
+ */
+int CONSOLE_SetCommandConcurrent( ConsoleHandle_t h, char* cmd );
+
+/*!
+ * The CONSOLE_RegisterScript function is used to store a named script in the console processor. A script is a
+ * chain of commands which are separated by ';' and can be executed with the built-in <<run>> command. The steps
+ * are executed one after another and the script stops with the first failing step. Returns -1 when the script
+ * already exists or when it does not fit into CONSOLE_SCRIPT_MAX_LENGTH, otherwise 0
+ *
+ * @param h is of type ConsoleHandle_t which is created by a call of CONSOLE_CreateInstance
+ * @param name is of type char* which is the case sensitive name of the script
+ * @param script is of type char* which is the chain of commands, e.g. "stepper reset;stepper move 10"
+ */
+int CONSOLE_RegisterScript( ConsoleHandle_t h, char* name, char* script );
+
+/*!
+ * The CONSOLE_RemoveScript function is used to remove a stored script from the console processor.
+ *
+ * @param h is of type ConsoleHandle_t which is created by a call of CONSOLE_CreateInstance
+ * @param name is of type char* which is the case sensitive name of the script
+ */
+int CONSOLE_RemoveScript( ConsoleHandle_t h, char* name );
+
 /*!
  * The CONSOLE_RedirectStreams function is used to change stdin or stdout as default
  * streams for the console functions. In case one or both stream function pointers are
@@ -114,6 +145,52 @@ int CONSOLE_RemoveAliasOrCommand( ConsoleHandle_t h, char* cmd);
  */
 int CONSOLE_RedirectStreams( ConsoleHandle_t h, ConsoleReadStream_t rdFunc, ConsoleWriteStream_t wrFunc,
 		void* rdContext, void* wrContext );
+
+/*!
+ * The CONSOLE_FormatFixed function writes a fixed point decimal number into the given buffer, e.g. 12345 with
+ * 4 decimals is written as "1.2345" and -5 with 2 decimals as "-0.05". It does not use printf, does not allocate
+ * memory and is reentrant, so it can be used on the hot path of status responses. The result is always null
+ * terminated. The return value is the number of written chars without the termination or -1 when the buffer
+ * is too small or more than 9 decimals are requested
+ *
+ * @param pBuffer is of type char* which is the output buffer
+ * @param size is of type int which is the size of the output buffer including the termination
+ * @param value is of type long which is the number scaled by 10^decimals
+ * @param decimals is of type int which is the number of digits behind the decimal point, 0 to 9
+ */
+int CONSOLE_FormatFixed( char* pBuffer, int size, long value, int decimals );
+
+/*!
+ * The CONSOLE_FormatInt function writes a decimal integer into the given buffer, it behaves like
+ * CONSOLE_FormatFixed with zero decimals
+ */
+int CONSOLE_FormatInt( char* pBuffer, int size, long value );
+
+/*!
+ * The CONSOLE_FormatU64 function writes an unsigned 64 bit integer into the given buffer, e.g. a run time or cycle
+ * counter which does not fit into a long. It is the replacement of printf("%llu") which is missing in nano printf
+ * and behaves like CONSOLE_FormatInt otherwise
+ */
+int CONSOLE_FormatU64( char* pBuffer, int size, unsigned long long value );
+
+/*!
+ * The CONSOLE_FormatFloat function rounds a float to the given number of decimals and writes it like
+ * CONSOLE_FormatFixed. Only single precision arithmetic is used, so the result has the precision of a float.
+ * A value which does not fit into 32 bits with the requested decimals is written with fewer decimals. Returns -1
+ * as well when not even the integer part fits into 32 bits or the value is not a number
+ */
+int CONSOLE_FormatFloat( char* pBuffer, int size, float value, int decimals );
+
+/*!
+ * The CONSOLE_PrintFloat function writes the result of CONSOLE_FormatFloat to stdout. It is the replacement
+ * of printf("%.nf") which does not require float support of the printf implementation
+ */
+int CONSOLE_PrintFloat( float value, int decimals );
+
+/*!
+ * The CONSOLE_PrintInt function writes the result of CONSOLE_FormatInt to stdout
+ */
+int CONSOLE_PrintInt( long value );
 /*!
  * \mainpage FreeRTOS Console Library
  * \section intro_sec Introduction
@@ -132,6 +209,39 @@ int CONSOLE_RedirectStreams( ConsoleHandle_t h, ConsoleReadStream_t rdFunc, Cons
  * this line<br>
  * CONSOLE_COMMAND_MAX_LENGTH: Specifies the maximum number of chars per command<br>
  * CONSOLE_HELP_MAX_LENGTH: Specifies the maximum number of chars per command help text<br>
+ * CONSOLE_SCRIPT_MAX_LENGTH: Specifies the maximum number of chars of a stored script including all separators<br>
+ * CONSOLE_MACHINE_MODE: The console starts in machine mode without banner and prompt when set to 1<br>
+ * CONSOLE_PIPELINE_WINDOW: Specifies the number of tagged commands in flight in pipelined mode, 0 disables it<br>
+ * CONSOLE_PIPELINE_RESPONSE_SIZE: Specifies the maximum number of captured chars per pipelined command<br>
+ * CONSOLE_PIPELINE_STACK_DEPTH: Specifies the stack depth of the pipeline workers, 0 uses the console stack depth<br>
+ *
+ * \section chain_sec command chains and scripts
+ *
+ * Several commands can be entered in one line when they are separated by ';', e.g. "stepper reset;stepper move 10".
+ * The commands are executed one after another and the chain stops with the first failing command. A separator
+ * within a quoted argument belongs to the argument. The same chains can be stored as named scripts with
+ * <<script add name cmd ...>> or CONSOLE_RegisterScript and are executed with <<run name>>, which prints the
+ * result of every step and a summary at the end.<br>
+ *
+ * \section machine_sec machine mode
+ *
+ * <<machine on>> switches the console to a mode for scripted hosts which can be used per session. The console
+ * does not echo the input, does not parse control sequences, keeps no history and prints no prompt or colors.
+ * Every line is answered with the output of the command followed by a terse result line "=0" or "=-1", which
+ * is the return value of the command. <<machine off>> switches back to the interactive mode. In combination
+ * with the pipelined mode, a tagged line is only answered by its tagged result.<br>
+ *
+ * \section pipeline_sec pipelined mode
+ *
+ * When CONSOLE_PIPELINE_WINDOW is larger than zero, <<pipeline on>> switches to pipelined mode. Lines which
+ * start with a tag like "#17 stepper move 10 -a" are queued to worker tasks and the console accepts the next
+ * line immediately. The output of a command is printed with the tag and a colon ("#17: ...") followed by the
+ * result "#17 OK" or "#17 FAIL", in the order of completion and only between two input lines. When all
+ * CONSOLE_PIPELINE_WINDOW slots are in flight, the line is rejected with "#17 BUSY" and the host has to send
+ * it again after the next result. Lines without tag are still executed by the console itself. The registered
+ * commands are executed one after another by the console and the workers, only commands which are marked with
+ * CONSOLE_SetCommandConcurrent run in parallel and have to protect their own resources. The output of a command
+ * is only captured with newlib, otherwise it is printed directly and only the tagged result line follows.<br>
  * 
  * \section state_example Examples
  * The following example shows how to create a instance of the console library
@@ -10,6 +10,7 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
+#include "queue.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -55,14 +56,80 @@
 #  define CONSOLE_HELP_MAX_LENGTH 256
 #endif
 
+#ifndef CONSOLE_SCRIPT_MAX_LENGTH
+#  define CONSOLE_SCRIPT_MAX_LENGTH 512
+#endif
+
+#ifndef CONSOLE_MACHINE_MODE
+#  define CONSOLE_MACHINE_MODE 0
+#endif
+
+#ifndef CONSOLE_PIPELINE_WINDOW
+#  define CONSOLE_PIPELINE_WINDOW 0
+#endif
+
+#ifndef CONSOLE_PIPELINE_RESPONSE_SIZE
+#  define CONSOLE_PIPELINE_RESPONSE_SIZE 256
+#endif
+
+#ifndef CONSOLE_PIPELINE_STACK_DEPTH
+#  define CONSOLE_PIPELINE_STACK_DEPTH 0
+#endif
+
+#ifndef CONSOLE_MALLOC
+#  define CONSOLE_MALLOC malloc
+#endif
+
+#ifndef CONSOLE_FREE
+#  define CONSOLE_FREE free
+#endif
+
+#ifndef CONSOLE_TRACE_COMMAND_BEGIN
+#  define CONSOLE_TRACE_COMMAND_BEGIN(cmd, cmdLen)
+#endif
+
+#ifndef CONSOLE_TRACE_COMMAND_END
+#  define CONSOLE_TRACE_COMMAND_END(cmd, cmdLen, result)
+#endif
+
+#ifndef CONSOLE_STATIC_ALLOCATION
+#  define CONSOLE_STATIC_ALLOCATION configSUPPORT_STATIC_ALLOCATION
+#endif
+
+#ifndef CONSOLE_STATIC_STACK_DEPTH
+#  define CONSOLE_STATIC_STACK_DEPTH (4 * configMINIMAL_STACK_SIZE)
+#endif
+
+#if CONSOLE_PIPELINE_STACK_DEPTH != 0
+#  define CONSOLE_PIPELINE_STATIC_DEPTH CONSOLE_PIPELINE_STACK_DEPTH
+#else
+#  define CONSOLE_PIPELINE_STATIC_DEPTH CONSOLE_STATIC_STACK_DEPTH
+#endif
+
 #if CONSOLE_HELP_MAX_LENGTH < CONSOLE_LINE_SIZE
 #pragma error "the line size must not be larger than the help size, otherwise alias wont work anymore!"
 #endif
 
+#if CONSOLE_SCRIPT_MAX_LENGTH < CONSOLE_LINE_SIZE
+#pragma error "the line size must not be larger than the script size, otherwise a script step could be lost!"
+#endif
+
 #define CONSOLE_SAFETY_SPACE 4
 // always min of 4 commands plus line size/3 because argument '-x ' and space at least!
 #define CONSOLE_MAX_NUM_ARGS ((CONSOLE_LINE_SIZE / 3) + 4)
 
+// separator of commands within one line, a script or an alias
+#define CONSOLE_CHAIN_SEPARATOR ';'
+// maximum depth of chains which call scripts or aliases which are chains again, every level
+// costs a copy of the line buffer and the argument list on the console stack
+#define CONSOLE_MAX_CHAIN_NESTING 3
+// every task which executes commands (console and pipeline workers) has its own chain depth
+#define CONSOLE_NUM_EXECUTORS (CONSOLE_PIPELINE_WINDOW + 1)
+// maximum number of decimals of the fixed point formatter, 10^9 still fits into 32 bits
+#define CONSOLE_FORMAT_MAX_DECIMALS 9
+// first char of a tagged line in pipelined mode, e.g. "#17 stepper move 10 -a"
+#define CONSOLE_PIPELINE_TAG_CHAR '#'
+
 // --------------------------------------------------------------------------------------------------------------------
 typedef struct cmdEntry
 // --------------------------------------------------------------------------------------------------------------------
@@ -76,19 +143,57 @@ typedef struct cmdEntry
 		char                help[CONSOLE_HELP_MAX_LENGTH + 2];
 		int                 helpLen;
 		int                 isAlias;
+		int                 concurrent;
 	} content;
 
     LIST_ENTRY(cmdEntry) navigate;
 } cmdEntry_t;
 
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct scriptEntry
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct
+	{
+		char                name[CONSOLE_COMMAND_MAX_LENGTH + 2];
+		int                 nameLen;
+		char                body[CONSOLE_SCRIPT_MAX_LENGTH + 2];
+		int                 bodyLen;
+	} content;
+
+    LIST_ENTRY(scriptEntry) navigate;
+} scriptEntry_t;
+
 // --------------------------------------------------------------------------------------------------------------------
 typedef struct cmdState
 // --------------------------------------------------------------------------------------------------------------------
 {
-	SemaphoreHandle_t             lockGuard;
-	LIST_HEAD(cmd_list, cmdEntry) commands;
+	SemaphoreHandle_t                   lockGuard;
+	SemaphoreHandle_t                   execGuard;
+	LIST_HEAD(cmd_list, cmdEntry)       commands;
+	LIST_HEAD(script_list, scriptEntry) scripts;
+	struct
+	{
+		TaskHandle_t                    owner;
+		int                             depth;
+	} chainNesting[CONSOLE_NUM_EXECUTORS];
+	int                                 machineMode;
 } cmdState_t;
 
+#if CONSOLE_PIPELINE_WINDOW > 0
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct pipeJob
+// --------------------------------------------------------------------------------------------------------------------
+{
+	unsigned int tag;
+	int          result;
+	char         line[CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE];
+	char         response[CONSOLE_PIPELINE_RESPONSE_SIZE + 1];
+	int          responseLen;
+	int          truncated;
+} pipeJob_t;
+#endif
+
 // --------------------------------------------------------------------------------------------------------------------
 typedef enum
 // --------------------------------------------------------------------------------------------------------------------
@@ -189,8 +294,45 @@ struct ConsoleHandle
 	ConsoleWriteStream_t pendingWrStream;
 	void*                pendingRdCtx;
 	void*                pendingWrCtx;
+
+#if CONSOLE_PIPELINE_WINDOW > 0
+	struct
+	{
+		int              enabled;
+		int              numWorkers;
+		unsigned int     stackDepth;
+		int              prio;
+		QueueHandle_t    freeJobs;
+		QueueHandle_t    pendingJobs;
+		QueueHandle_t    doneJobs;
+		TaskHandle_t     workers[CONSOLE_PIPELINE_WINDOW];
+		pipeJob_t        jobs[CONSOLE_PIPELINE_WINDOW];
+	} pipeline;
+#endif
 };
 
+#if CONSOLE_STATIC_ALLOCATION != 0
+// the only instance with all of its kernel objects and buffers, so every address is fixed at link time
+// --------------------------------------------------------------------------------------------------------------------
+static struct ConsoleHandle ConsoleStaticHandle;
+static int                  ConsoleStaticHandleUsed = 0;
+static StaticSemaphore_t    ConsoleStaticLockGuard;
+static StaticSemaphore_t    ConsoleStaticExecGuard;
+static StaticTask_t         ConsoleStaticTask;
+static StackType_t          ConsoleStaticStack[CONSOLE_STATIC_STACK_DEPTH];
+static char                 ConsoleStaticLineBuff[CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE];
+static char                 ConsoleStaticCtrlBuff[CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE];
+#if CONSOLE_PIPELINE_WINDOW > 0
+static StaticQueue_t        ConsoleStaticJobQueues[3];
+static uint8_t              ConsoleStaticJobStorage[3][CONSOLE_PIPELINE_WINDOW * sizeof(pipeJob_t*)];
+static StaticTask_t         ConsoleStaticWorkers[CONSOLE_PIPELINE_WINDOW];
+static StackType_t          ConsoleStaticWorkerStacks[CONSOLE_PIPELINE_WINDOW][CONSOLE_PIPELINE_STATIC_DEPTH];
+#endif
+#  define CONSOLE_JOB_QUEUE(n) xQueueCreateStatic(CONSOLE_PIPELINE_WINDOW, sizeof(pipeJob_t*), ConsoleStaticJobStorage[n], &ConsoleStaticJobQueues[n])
+#else
+#  define CONSOLE_JOB_QUEUE(n) xQueueCreate(CONSOLE_PIPELINE_WINDOW, sizeof(pipeJob_t*))
+#endif
+
 #ifdef WIN32
 // --------------------------------------------------------------------------------------------------------------------
 int setenv(const char* name, const char* value, int overwrite)
@@ -335,6 +477,15 @@ cspTYPE ControlSequenceParserConsume( char input, cspState_t* s )
 	}
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+static void PrintConsoleError( cmdState_t* c, const char* text )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// a host in machine mode gets the plain text without any colors
+	if ( c->machineMode ) printf("%s", text);
+	else printf("\033[31m%s\033[0m", text);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 static int ProcessCommand(char* command, int cmdLen, char** args, int numArgs, cmdState_t* c, int* isAlias, char* inputBuffer, int inbuffsz)
 // --------------------------------------------------------------------------------------------------------------------
@@ -343,6 +494,9 @@ static int ProcessCommand(char* command, int cmdLen, char** args, int numArgs, c
 	// our linked list of command entries
 	xSemaphoreTakeRecursive( c->lockGuard, -1 );
 	cmdEntry_t* pElement = c->commands.lh_first;
+	CONSOLE_CommandFunc func = NULL;
+	void* funcCtx = NULL;
+	int concurrent = 0;
 	int found = 0;
 	int result = 0;
 	while ( pElement != NULL )
@@ -376,9 +530,10 @@ static int ProcessCommand(char* command, int cmdLen, char** args, int numArgs, c
 					}
 					if ((argCopyLen + pElement->content.helpLen + stillCopiedLength + 1) > inbuffsz)
 					{
-						printf("\033[31mAlias Argument Substitution Overflow\033[0m");
+						PrintConsoleError(c, "Alias Argument Substitution Overflow");
 						result = -1;
 						*isAlias = 0;
+						xSemaphoreGiveRecursive( c->lockGuard );
 						return result;
 					}
 					if (additionalTermination)
@@ -406,7 +561,9 @@ static int ProcessCommand(char* command, int cmdLen, char** args, int numArgs, c
 			}
 			else
 			{
-				result = pElement->content.func(numArgs, args, pElement->content.ctx);
+				func       = pElement->content.func;
+				funcCtx    = pElement->content.ctx;
+				concurrent = pElement->content.concurrent;
 			}
 			break;
 		}
@@ -415,15 +572,30 @@ static int ProcessCommand(char* command, int cmdLen, char** args, int numArgs, c
 	}
 
 	xSemaphoreGiveRecursive( c->lockGuard );
+
+	// the function is called without the lock guard, otherwise a long running command would block the lookup
+	// of all other tasks. Only commands which protect their own resources run in parallel, all other commands
+	// are executed one after another by the console and the pipeline workers
+	if ( func != NULL )
+	{
+		if ( concurrent == 0 ) xSemaphoreTakeRecursive( c->execGuard, -1 );
+		CONSOLE_TRACE_COMMAND_BEGIN(command, cmdLen);
+		result = func(numArgs, args, funcCtx);
+		CONSOLE_TRACE_COMMAND_END(command, cmdLen, result);
+		if ( concurrent == 0 ) xSemaphoreGiveRecursive( c->execGuard );
+	}
+
 	if ( found == 0 )
 	{
-		printf("\033[31mInvalid command\033[0m");
+		PrintConsoleError(c, "Invalid command");
 		fflush(stdout);
 		result = -1;
 	}
 	return result;
 }
 
+static int ProcessCommandChain(char* lineBuff, int line_size, cmdState_t* c, int* numPassed);
+
 // --------------------------------------------------------------------------------------------------------------------
 static int TransformAndProcessTheCommand(char* lineBuff, int line_size, cmdState_t* cState)
 // --------------------------------------------------------------------------------------------------------------------
@@ -507,6 +679,13 @@ restart:
 		int retVal = ProcessCommand(command, cmdLength, args, numArgs, cState, &isAlias, lineBuff, line_size);
 		if ( isAlias )
 		{
+			// an alias can be mapped to a chain of commands, which is then processed like
+			// a chained line of the user
+			if ( memchr(lineBuff, CONSOLE_CHAIN_SEPARATOR, line_size) != NULL )
+			{
+				return ProcessCommandChain(lineBuff, line_size, cState, NULL);
+			}
+
 			// in case it is an alias, the line buffer has been overwritten with the alias and so we have to do
 			// this round again
 			goto restart;
@@ -517,6 +696,114 @@ restart:
 	return 0;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+static int NextChainSegment(const char* line, int lineSize, int* pos, char* segBuff, int segSize)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// searches the next non empty part of the line which is terminated by the chain separator or the end of the
+	// line. Separators within quoted arguments belong to the argument. In case there is a segment buffer, the
+	// part is copied into the nulled buffer. Returns the length of the part, -1 if the line is consumed or -2 if
+	// the part does not fit into the segment buffer
+	while ( *pos < lineSize && line[*pos] != '\0' )
+	{
+		int start = *pos;
+		int end = start;
+		int inQuotes = 0;
+		int isBlank = 1;
+
+		while ( end < lineSize && line[end] != '\0' )
+		{
+			if ( line[end] == '"' ) inQuotes = !inQuotes;
+			else if ( line[end] == CONSOLE_CHAIN_SEPARATOR && !inQuotes ) break;
+			if ( line[end] != ' ' ) isBlank = 0;
+			end += 1;
+		}
+
+		// skip the separator itself, the next search starts behind it
+		*pos = ( end < lineSize && line[end] == CONSOLE_CHAIN_SEPARATOR ) ? end + 1 : end;
+		if ( isBlank ) continue;
+
+		if ( segBuff != NULL )
+		{
+			if ( (end - start) > segSize ) return -2;
+			memset(segBuff, ctrlC0_NUL, segSize + CONSOLE_SAFETY_SPACE);
+			memcpy(segBuff, &line[start], end - start);
+		}
+		return end - start;
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int* ChainDepthOfCurrentTask(cmdState_t* c)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the executing tasks never change at runtime, so the first free entry is claimed once by every task
+	TaskHandle_t me = xTaskGetCurrentTaskHandle();
+	int* depth = NULL;
+	xSemaphoreTakeRecursive( c->lockGuard, -1 );
+	for ( int i = 0; i < CONSOLE_NUM_EXECUTORS; i++ )
+	{
+		if ( c->chainNesting[i].owner == me || c->chainNesting[i].owner == NULL )
+		{
+			c->chainNesting[i].owner = me;
+			depth = &c->chainNesting[i].depth;
+			break;
+		}
+	}
+	xSemaphoreGiveRecursive( c->lockGuard );
+	return depth;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ProcessCommandChain(char* lineBuff, int line_size, cmdState_t* c, int* numPassed)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// every command of the chain gets its own line buffer, because the transformation tokenizes the buffer
+	// and an alias overwrites it completely. The chain stops with the first command which fails. When the
+	// caller wants to know the number of passed commands, a result line is printed for every command
+	char segBuff[CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE];
+	int pos = 0;
+	int step = 0;
+	int segLen = 0;
+	int result = 0;
+
+	int* depth = ChainDepthOfCurrentTask(c);
+	if ( depth == NULL || *depth >= CONSOLE_MAX_CHAIN_NESTING )
+	{
+		PrintConsoleError(c, "Chain Nesting Overflow");
+		return -1;
+	}
+	*depth += 1;
+
+	while ( ( segLen = NextChainSegment(lineBuff, line_size, &pos, segBuff, CONSOLE_LINE_SIZE) ) != -1 )
+	{
+		if ( segLen < 0 )
+		{
+			PrintConsoleError(c, "Chain Command Overflow");
+			result = -1;
+			break;
+		}
+
+		step += 1;
+		if ( numPassed != NULL ) printf("\r\n[%d] %s\r\n", step, segBuff);
+		else if ( step > 1 ) printf("\r\n");
+
+		result = TransformAndProcessTheCommand(segBuff, CONSOLE_LINE_SIZE, c);
+		fflush(stdout);
+
+		if ( numPassed != NULL )
+		{
+			printf("\r\n[%d] %s", step, (result == 0) ? "OK" : "FAIL");
+			if ( result == 0 ) *numPassed += 1;
+		}
+		if ( result != 0 ) break;
+	}
+
+	*depth -= 1;
+	return result;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 static void PrintConsoleControl( cspState_t* s )
 // --------------------------------------------------------------------------------------------------------------------
@@ -641,6 +928,170 @@ int CONSOLE_RedirectStreams( ConsoleHandle_t h, ConsoleReadStream_t rdFunc, Cons
 	return 0;
 }
 
+#if CONSOLE_PIPELINE_WINDOW > 0
+#ifdef __NEWLIB__
+// --------------------------------------------------------------------------------------------------------------------
+static int PipelineCapture( void* pContext, const char* pBuffer, int num )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the context is the job pointer of the worker, which always points to the job in progress
+	pipeJob_t* job = *(pipeJob_t**)pContext;
+	if ( job == NULL ) return num;
+
+	int space = CONSOLE_PIPELINE_RESPONSE_SIZE - job->responseLen;
+	int toCopy = ( num > space ) ? space : num;
+	if ( toCopy < num ) job->truncated = 1;
+
+	memcpy(&job->response[job->responseLen], pBuffer, toCopy);
+	job->responseLen += toCopy;
+	job->response[job->responseLen] = '\0';
+
+	// the rest is dropped silently, the truncation is reported with the response
+	return num;
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+static void ConsolePipelineWorker( void * arg )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ConsoleHandle_t h = (ConsoleHandle_t)arg;
+	pipeJob_t* job = NULL;
+
+#ifdef __NEWLIB__
+	// everything the commands print in this task is captured into the response of the current job. Without
+	// newlib the output is written directly and only the tagged result line is printed by the console
+	FILE* capture = fwopen(&job, PipelineCapture);
+	if ( capture != NULL ) _impure_ptr->_stdout = capture;
+#endif
+
+	while (1)
+	{
+		if ( xQueueReceive(h->pipeline.pendingJobs, &job, portMAX_DELAY) != pdTRUE ) continue;
+
+		job->responseLen = 0;
+		job->truncated = 0;
+		job->response[0] = '\0';
+		job->result = ProcessCommandChain(job->line, CONSOLE_LINE_SIZE, &h->cState, NULL);
+		fflush(stdout);
+
+		pipeJob_t* done = job;
+		job = NULL;
+		xQueueSend(h->pipeline.doneJobs, &done, portMAX_DELAY);
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsolePipelineSubmit( ConsoleHandle_t h, const char* lineBuff )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// returns 1 when the line must be executed by the console itself, because the pipeline is off or
+	// the line has no tag
+	if ( h->pipeline.enabled == 0 || lineBuff[0] != CONSOLE_PIPELINE_TAG_CHAR ) return 1;
+
+	char* end = NULL;
+	unsigned long tag = strtoul(&lineBuff[1], &end, 10);
+	if ( end == &lineBuff[1] || ( *end != ' ' && *end != '\0' ) )
+	{
+		PrintConsoleError(&h->cState, "Invalid pipeline tag");
+		return -1;
+	}
+
+	// the window is full, so the host has to wait for a result before the command can be sent again
+	pipeJob_t* job = NULL;
+	if ( xQueueReceive(h->pipeline.freeJobs, &job, 0) != pdTRUE )
+	{
+		printf("%c%lu BUSY", CONSOLE_PIPELINE_TAG_CHAR, tag);
+		return -1;
+	}
+
+	job->tag = (unsigned int)tag;
+	memset(job->line, ctrlC0_NUL, sizeof(job->line));
+	strncpy(job->line, end, CONSOLE_LINE_SIZE);
+	xQueueSend(h->pipeline.pendingJobs, &job, 0);
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void ConsolePipelineFlush( ConsoleHandle_t h )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// prints the results in the order of completion. Every output line of a command gets the tag with a
+	// colon, the last line is the tag with the result, so the host can assign interleaved responses
+	pipeJob_t* job = NULL;
+	while ( xQueueReceive(h->pipeline.doneJobs, &job, 0) == pdTRUE )
+	{
+		int start = 0;
+		for ( int i = 0; i <= job->responseLen; i++ )
+		{
+			if ( i == job->responseLen || job->response[i] == '\r' || job->response[i] == '\n' )
+			{
+				if ( i > start )
+				{
+					printf("\r\n%c%u: %.*s", CONSOLE_PIPELINE_TAG_CHAR, job->tag, i - start, &job->response[start]);
+				}
+				start = i + 1;
+			}
+		}
+		if ( job->truncated ) printf("\r\n%c%u: ...", CONSOLE_PIPELINE_TAG_CHAR, job->tag);
+		printf("\r\n%c%u %s\r\n", CONSOLE_PIPELINE_TAG_CHAR, job->tag, (job->result == 0) ? "OK" : "FAIL");
+		fflush(stdout);
+
+		xQueueSend(h->pipeline.freeJobs, &job, 0);
+	}
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleExecuteLine( ConsoleHandle_t h, char* lineBuff, int* isQueued )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// parse and execute the command and make sure the output streams
+	// are flushed before doing anything else with the result
+	*isQueued = 0;
+#if CONSOLE_PIPELINE_WINDOW > 0
+	int result = ConsolePipelineSubmit(h, lineBuff);
+	if ( result == 1 ) result = ProcessCommandChain(lineBuff, CONSOLE_LINE_SIZE, &h->cState, NULL);
+	else if ( result == 0 ) *isQueued = 1;
+#else
+	int result = ProcessCommandChain(lineBuff, CONSOLE_LINE_SIZE, &h->cState, NULL);
+#endif
+	fflush(stdout);
+	fflush(stderr);
+	return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleMachineConsume( ConsoleHandle_t h, char myChar, char* lineBuff, unsigned int* lbPtr, int* overrun )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// in machine mode there is no echo, no control sequence and no history. The line is only collected
+	// and the result of every line is a terse "=<result>" line. Returns 1 when a line has been executed
+	if ( myChar != ctrlC0_CR && myChar != ctrlC0_LF )
+	{
+		if ( *lbPtr < CONSOLE_LINE_SIZE ) lineBuff[(*lbPtr)++] = myChar;
+		else *overrun = 1;
+		return 0;
+	}
+
+	// empty lines are ignored, so CR LF as line end does not produce a second result
+	if ( *lbPtr == 0 && *overrun == 0 ) return 0;
+
+	int isQueued = 0;
+	int result = -1;
+	if ( *overrun ) printf("Buffer Overrun");
+	else result = ConsoleExecuteLine(h, lineBuff, &isQueued);
+
+	// a queued line is answered by the tagged result of the pipeline
+	if ( isQueued == 0 ) printf("\r\n=%d\r\n", result);
+	fflush(stdout);
+
+	memset(lineBuff, ctrlC0_NUL, CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE);
+	*lbPtr = 0;
+	*overrun = 0;
+	return 1;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 static void ConsoleFunction( void * arg )
 // --------------------------------------------------------------------------------------------------------------------
@@ -659,6 +1110,8 @@ static void ConsoleFunction( void * arg )
 
 #define xstr(a) str(a)
 #define str(a) #a
+  if ( h->cState.machineMode == 0 )
+  {
     static const char headerASCIIArt[] =
         "\033c\033[3J\r\n\r\n"
         "\033[31m               -+                                         \r\n"
@@ -672,6 +1125,8 @@ static void ConsoleFunction( void * arg )
         "\033[39m      -<<:              \r\n"
 #ifdef WIN32
 		"\033[39m      -=   MSVC RTOS SIMULATOR ";
+#elif defined(__linux__)
+		"\033[39m      -=   POSIX RTOS SIMULATOR ";
 #else
 		"\033[39m      -=   ARM RTOS ";
 #endif
@@ -683,6 +1138,7 @@ static void ConsoleFunction( void * arg )
 #else
     printf("PLAYGROUND\r\n\r\n");
 #endif
+  }
 
 #if CONSOLE_USE_DYNAMIC_USERNAME != 0
 	char* usernamePtr = getenv("USERNAME");
@@ -691,24 +1147,32 @@ static void ConsoleFunction( void * arg )
 	char* usernamePtr = CONSOLE_USERNAME;
 #endif
 
+#if CONSOLE_STATIC_ALLOCATION != 0
+	char* lineBuff = ConsoleStaticLineBuff;
+	char* ctrlBuff = ConsoleStaticCtrlBuff;
+#else
 	char* lineBuff = NULL;
-	char* ctrlBuff = malloc(CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE); // make sure we have a little space behind
+	char* ctrlBuff = CONSOLE_MALLOC(CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE); // make sure we have a little space behind
 	if (ctrlBuff == NULL) goto exit;
 
-	lineBuff = malloc(CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE); // make sure we have a little space behind
+	lineBuff = CONSOLE_MALLOC(CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE); // make sure we have a little space behind
 	if (lineBuff == NULL) goto exit;
+#endif
 
 	memset(ctrlBuff, ctrlC0_NUL, CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE);
 	memset(lineBuff, ctrlC0_NUL, CONSOLE_LINE_SIZE + CONSOLE_SAFETY_SPACE);
 	unsigned int lbPtr = 0;
-
-	printf("\r\nFreeRTOS Console Up and Running\r\n");
-	printf("\r\n\r\n-------------------------------------------------------------------\r\n");
+	int machineOverrun = 0;
 
 	h->pState.buff = ctrlBuff;
-
-	printf("\r\n%s(\033[32m\xE2\x9C\x93\033[0m) $>", usernamePtr);
 	int consoleStartIndex = (int)strlen(usernamePtr)+6;
+
+	if ( h->cState.machineMode == 0 )
+	{
+		printf("\r\nFreeRTOS Console Up and Running\r\n");
+		printf("\r\n\r\n-------------------------------------------------------------------\r\n");
+		printf("\r\n%s(\033[32m\xE2\x9C\x93\033[0m) $>", usernamePtr);
+	}
 	fflush(stdout);
 
 	while(h->cancel == 0)
@@ -726,8 +1190,24 @@ static void ConsoleFunction( void * arg )
 		while((res = getchar()) == EOF)
 		{
 			if ( h->cancel == 1 ) goto exit;
+#if CONSOLE_PIPELINE_WINDOW > 0
+			// results are only printed between two lines, otherwise they would tear the echo of the input
+			if ( lbPtr == 0 ) ConsolePipelineFlush(h);
+#endif
 		}
 		char myChar = res;
+
+		if ( h->cState.machineMode != 0 )
+		{
+			if ( ConsoleMachineConsume(h, myChar, lineBuff, &lbPtr, &machineOverrun) && h->cState.machineMode == 0 )
+			{
+				// the host switched back to the interactive mode, so the user needs a prompt again
+				printf("\r\n%s(\033[32m\xE2\x9C\x93\033[0m) $>", usernamePtr);
+				fflush(stdout);
+			}
+			continue;
+		}
+
 		cspTYPE result = ControlSequenceParserConsume(myChar, &h->pState);
 		if ( result == csptCHARACTER )
 		{
@@ -815,11 +1295,8 @@ static void ConsoleFunction( void * arg )
 				h->history.lineHead = (h->history.lineHead + 1) % CONSOLE_LINE_HISTORY;
 				h->history.linePtr = h->history.lineHead;
 
-				// parse and execute the command and make sure the output streams
-				// are flushed before doing anything else with the result
-				int result = TransformAndProcessTheCommand(lineBuff, CONSOLE_LINE_SIZE, &h->cState);
-				fflush(stdout);
-				fflush(stderr);
+				int isQueued = 0;
+				int result = ConsoleExecuteLine(h, lineBuff, &isQueued);
 
 #if CONSOLE_USE_DYNAMIC_USERNAME != 0
 				// now check if there is a new user name (which is only possible by setenv command
@@ -828,17 +1305,25 @@ static void ConsoleFunction( void * arg )
 				if ( usernamePtr == 0 ) usernamePtr = CONSOLE_USERNAME;
 				consoleStartIndex = (int)strlen(usernamePtr)+6;
 #endif
-				// print new console line and decode the result
-				printf("\r\n%s(", usernamePtr);
-				if (result == 0)
+				// print new console line and decode the result, a host which has switched
+				// to machine mode gets the terse result line instead
+				if ( h->cState.machineMode != 0 )
 				{
-					printf("\033[32m\xE2\x9C\x93\033[0m");
+					printf("\r\n=%d\r\n", result);
 				}
 				else
 				{
-					printf("\033[31m\xE2\x98\x93\033[0m");
+					printf("\r\n%s(", usernamePtr);
+					if (result == 0)
+					{
+						printf("\033[32m\xE2\x9C\x93\033[0m");
+					}
+					else
+					{
+						printf("\033[31m\xE2\x98\x93\033[0m");
+					}
+					printf(") $>");
 				}
-				printf(") $>");
 				fflush(stdout);
 
 				// clear the buffer completely because an alias could change
@@ -1028,6 +1513,8 @@ exit:
 	printf("Console terminated, cleaning up...");
 	fflush(stdout);
 
+	// a serialized command of a pipeline worker is finished before the workers are deleted
+	xSemaphoreTakeRecursive(h->cState.execGuard, -1);
 	xSemaphoreTakeRecursive(h->cState.lockGuard, -1);
 	while (!LIST_EMPTY(&h->cState.commands))
 	{
@@ -1035,17 +1522,42 @@ exit:
 		if (pElement != NULL)
 		{
 			LIST_REMOVE(pElement, navigate);
-			free(pElement);
+			CONSOLE_FREE(pElement);
+		}
+		else break;
+	}
+
+	while (!LIST_EMPTY(&h->cState.scripts))
+	{
+		scriptEntry_t* pElement = h->cState.scripts.lh_first;
+		if (pElement != NULL)
+		{
+			LIST_REMOVE(pElement, navigate);
+			CONSOLE_FREE(pElement);
 		}
 		else break;
 	}
 
 	xSemaphoreGiveRecursive(h->cState.lockGuard);
+
+#if CONSOLE_PIPELINE_WINDOW > 0
+	for (int i = 0; i < h->pipeline.numWorkers; i++) vTaskDelete(h->pipeline.workers[i]);
+	vQueueDelete(h->pipeline.freeJobs);
+	vQueueDelete(h->pipeline.pendingJobs);
+	vQueueDelete(h->pipeline.doneJobs);
+#endif
+
+	xSemaphoreGiveRecursive(h->cState.execGuard);
+	vSemaphoreDelete(h->cState.execGuard);
 	vSemaphoreDelete(h->cState.lockGuard);
+#if CONSOLE_STATIC_ALLOCATION != 0
+	ConsoleStaticHandleUsed = 0;
+#else
 	free(h);
 	
-	if (lineBuff != NULL) free(lineBuff);
-	if (ctrlBuff != NULL) free(ctrlBuff);
+	if (lineBuff != NULL) CONSOLE_FREE(lineBuff);
+	if (ctrlBuff != NULL) CONSOLE_FREE(ctrlBuff);
+#endif
 	printf("done\r\n");
 destroy:
 	vTaskDelete(NULL);
@@ -1107,7 +1619,7 @@ static int ConsoleExecReset(int argc, char** argv, void* context)
 #if defined(__arm__)
 	NVIC_SystemReset();
 	return 0;
-#elif defined(WIN32)
+#elif defined(WIN32) || defined(__linux__)
 	exit(0);
 	return 0;
 #else
@@ -1142,23 +1654,31 @@ static int ConsolePrintTaskStats(int argc, char** argv, void* context)
 	unsigned int numFeedback = uxTaskGetSystemState( tasks, numTasks, &totalTime);
 	if (numFeedback > 0)
 	{
-		printf("|----|----------|----------|----------|---------|------------|-------|\r\n");
-		printf("| ID | NAME     | Prio     | BasePrio | State   | Ticks      | Rel.  |\r\n");
-		printf("|----|----------|----------|----------|---------|------------|-------|\r\n");
+		printf("|----|----------|----------|----------|---------|----------------|-------|\r\n");
+		printf("| ID | NAME     | Prio     | BasePrio | State   | Runtime        | Rel.  |\r\n");
+		printf("|----|----------|----------|----------|---------|----------------|-------|\r\n");
 	}
 	for (unsigned int i = 0; i < numFeedback; i++ )
 	{
-		float relativeRuntime = ( (float)tasks[i].ulRunTimeCounter * 100.0f / (float)totalTime );
+		// the relative runtime in permille is printed as fixed point, so there is no float printf required
+		char relativeRuntime[16] = "0.0";
+		if ( totalTime > 0 )
+		{
+			long permille = (long)( (unsigned long long)tasks[i].ulRunTimeCounter * 1000ULL / (unsigned long long)totalTime );
+			CONSOLE_FormatFixed(relativeRuntime, sizeof(relativeRuntime), permille, 1);
+		}
 		char* state = (tasks[i].eCurrentState == eRunning) ? "RUN    " :
 			(tasks[i].eCurrentState == eReady) ? "READY  " :
 			(tasks[i].eCurrentState == eBlocked) ? "BLOCKED" :
 			(tasks[i].eCurrentState == eSuspended) ? "SUSPEND" :
 			(tasks[i].eCurrentState == eDeleted) ? "DELETED" : "INVALID";
-		printf("| %2.2d | %-8.8s | %4.4d     | %4.4d     | %s | %10.10u | %5.1f |\r\n",
+		char runtime[24];
+		// the run time counter can be wider than a long, e.g. an extended cycle counter
+		CONSOLE_FormatU64(runtime, sizeof(runtime), (unsigned long long)tasks[i].ulRunTimeCounter);
+		printf("| %2.2d | %-8.8s | %4.4d     | %4.4d     | %s | %14s | %5s |\r\n",
 			(int)tasks[i].xTaskNumber, (char*)tasks[i].pcTaskName, (int)tasks[i].uxCurrentPriority, 
-			(int)tasks[i].uxBasePriority, (char*)state, (unsigned int)tasks[i].ulRunTimeCounter,
-			(float)relativeRuntime);
-		printf("|----|----------|----------|----------|---------|------------|-------|\r\n");
+			(int)tasks[i].uxBasePriority, (char*)state, runtime, relativeRuntime);
+		printf("|----|----------|----------|----------|---------|----------------|-------|\r\n");
 	}
 
 	return 0;
@@ -1221,12 +1741,17 @@ static int ConsoleMallInfo(int argc, char** argv, void* context)
 	(void)argv;
 
 #ifndef WIN32
+#if defined(__GLIBC__) && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 33 ) )
+	// glibc deprecates mallinfo because of its int fields, the Linux simulator uses the size_t variant
+	struct mallinfo2 info = mallinfo2();
+#else
 	struct mallinfo info = mallinfo();
-	printf("arena    : %d\r\n", info.arena);
-	printf("ordblks  : %d\r\n", info.ordblks);
-	printf("uordblks : %d\r\n", info.uordblks);
-	printf("fordblks : %d\r\n", info.fordblks);
-	printf("keepcost : %d\r\n", info.keepcost);
+#endif
+	printf("arena    : %d\r\n", (int)info.arena);
+	printf("ordblks  : %d\r\n", (int)info.ordblks);
+	printf("uordblks : %d\r\n", (int)info.uordblks);
+	printf("fordblks : %d\r\n", (int)info.fordblks);
+	printf("keepcost : %d\r\n", (int)info.keepcost);
 	return 0;
 #else
 	printf("WIN32 has quite a lot!");
@@ -1363,6 +1888,246 @@ static int ConsoleAliasConfig(int argc, char** argv, void* context)
 	}
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleAddScript( cmdState_t* c, const char* name, const char* script, int append )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	int result = -1;
+	if ( name == NULL || script == NULL ) return result;
+	if ( *name == '\0' || *script == '\0' ) return result;
+	int nameLen   = 0;
+	int scriptLen = 0;
+	if ( (nameLen   = (int)strnlen(name, CONSOLE_COMMAND_MAX_LENGTH+1) )  > CONSOLE_COMMAND_MAX_LENGTH ) return result;
+	if ( (scriptLen = (int)strnlen(script, CONSOLE_SCRIPT_MAX_LENGTH+1) ) > CONSOLE_SCRIPT_MAX_LENGTH  ) return result;
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreTakeRecursive( c->lockGuard, -1 );
+
+	scriptEntry_t* pElement = c->scripts.lh_first;
+	while ( pElement != NULL )
+	{
+		// if string compare result and determined length match, then this must be the script
+		if ( strncmp(name, pElement->content.name, nameLen) == 0 && nameLen == pElement->content.nameLen )
+			break;
+		pElement = pElement->navigate.le_next;
+	}
+
+	if ( pElement == NULL )
+	{
+		pElement = CONSOLE_MALLOC(sizeof(struct scriptEntry));
+		if ( pElement != NULL )
+		{
+			pElement->content.nameLen = nameLen;
+			memcpy(pElement->content.name, name, nameLen);
+			pElement->content.name[nameLen] = '\0';
+			memcpy(pElement->content.body, script, scriptLen);
+			pElement->content.body[scriptLen] = '\0';
+			pElement->content.bodyLen = scriptLen;
+			LIST_INSERT_HEAD(&c->scripts, pElement, navigate);
+			result = 0;
+		}
+	}
+	else if ( append && ( pElement->content.bodyLen + 1 + scriptLen ) <= CONSOLE_SCRIPT_MAX_LENGTH )
+	{
+		// a new step is appended behind the existing ones with a separator in between
+		pElement->content.body[pElement->content.bodyLen] = CONSOLE_CHAIN_SEPARATOR;
+		memcpy(&pElement->content.body[pElement->content.bodyLen + 1], script, scriptLen);
+		pElement->content.bodyLen += 1 + scriptLen;
+		pElement->content.body[pElement->content.bodyLen] = '\0';
+		result = 0;
+	}
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreGiveRecursive( c->lockGuard );
+	return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleScriptConfig(int argc, char** argv, void* context)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ConsoleHandle_t h = (ConsoleHandle_t)context;
+	cmdState_t* c = &h->cState;
+
+	if ( argc == 0 || strcmp(argv[0], "list") == 0 )
+	{
+		xSemaphoreTakeRecursive( c->lockGuard, -1 );
+		scriptEntry_t* pElement = c->scripts.lh_first;
+		while ( pElement != NULL )
+		{
+			printf("%s -> '%s'\r\n", pElement->content.name, pElement->content.body);
+			pElement = pElement->navigate.le_next;
+		}
+		xSemaphoreGiveRecursive( c->lockGuard );
+		return 0;
+	}
+	else if ( strcmp(argv[0], "remove") == 0 && argc == 2 )
+	{
+		if ( CONSOLE_RemoveScript(h, argv[1]) == 0 )
+		{
+			printf("script removed successfully");
+			return 0;
+		}
+		printf("script was not removed");
+		return -1;
+	}
+	else if ( strcmp(argv[0], "add") == 0 && argc > 2 )
+	{
+		// all arguments behind the script name are one step of the script
+		char stepBuffer[CONSOLE_LINE_SIZE + 1];
+		int buffPtr = 0;
+		memset(stepBuffer, 0, sizeof(stepBuffer));
+		for ( int i = 2; i < argc; i++ )
+		{
+			int argLen = (int)strnlen(argv[i], CONSOLE_LINE_SIZE);
+			if ( ( buffPtr + argLen + 1 ) >= CONSOLE_LINE_SIZE )
+			{
+				printf("the sum of the script step parameters is longer than the max line buffer size!");
+				return -1;
+			}
+			memcpy(&stepBuffer[buffPtr], argv[i], argLen);
+			buffPtr += argLen;
+			if ( ( i + 1 ) != argc ) stepBuffer[buffPtr++] = ' ';
+		}
+
+		if ( ConsoleAddScript(c, argv[1], stepBuffer, 1) == 0 )
+		{
+			printf("script step added successfully");
+			return 0;
+		}
+		printf("script step was not added");
+		return -1;
+	}
+
+	printf("invalid number of arguments or invalid subcommand");
+	return -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleRunScript(int argc, char** argv, void* context)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ConsoleHandle_t h = (ConsoleHandle_t)context;
+	cmdState_t* c = &h->cState;
+
+	if ( argc != 1 )
+	{
+		printf("invalid number of arguments");
+		return -1;
+	}
+
+	// the script is copied, so it is still valid when one of its steps changes or removes it
+	char body[CONSOLE_SCRIPT_MAX_LENGTH + 2];
+	int bodyLen = -1;
+	int nameLen = (int)strnlen(argv[0], CONSOLE_COMMAND_MAX_LENGTH+1);
+
+	xSemaphoreTakeRecursive( c->lockGuard, -1 );
+	scriptEntry_t* pElement = c->scripts.lh_first;
+	while ( pElement != NULL )
+	{
+		if ( strncmp(argv[0], pElement->content.name, nameLen) == 0 && nameLen == pElement->content.nameLen )
+		{
+			bodyLen = pElement->content.bodyLen;
+			memcpy(body, pElement->content.body, bodyLen + 1);
+			break;
+		}
+		pElement = pElement->navigate.le_next;
+	}
+	xSemaphoreGiveRecursive( c->lockGuard );
+
+	if ( bodyLen < 0 )
+	{
+		printf("%s is no script", argv[0]);
+		return -1;
+	}
+
+	int numSteps = 0;
+	int numPassed = 0;
+	int pos = 0;
+	while ( NextChainSegment(body, bodyLen, &pos, NULL, 0) != -1 ) numSteps += 1;
+
+	int result = ProcessCommandChain(body, bodyLen, c, &numPassed);
+	printf("\r\n%s: %d of %d steps OK", argv[0], numPassed, numSteps);
+	return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsoleMachineConfig(int argc, char** argv, void* context)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ConsoleHandle_t h = (ConsoleHandle_t)context;
+
+	if ( argc == 0 )
+	{
+		printf("%s", h->cState.machineMode ? "on" : "off");
+		return 0;
+	}
+	else if ( argc == 1 && strcmp(argv[0], "on") == 0 )
+	{
+		h->cState.machineMode = 1;
+		return 0;
+	}
+	else if ( argc == 1 && strcmp(argv[0], "off") == 0 )
+	{
+		h->cState.machineMode = 0;
+		return 0;
+	}
+
+	printf("invalid number of arguments or invalid subcommand");
+	return -1;
+}
+
+#if CONSOLE_PIPELINE_WINDOW > 0
+// --------------------------------------------------------------------------------------------------------------------
+static int ConsolePipelineConfig(int argc, char** argv, void* context)
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ConsoleHandle_t h = (ConsoleHandle_t)context;
+
+	if ( argc == 0 )
+	{
+		int inFlight = CONSOLE_PIPELINE_WINDOW - (int)uxQueueMessagesWaiting(h->pipeline.freeJobs);
+		printf("pipeline %s, window %d, workers %d, in flight %d", h->pipeline.enabled ? "on" : "off",
+				CONSOLE_PIPELINE_WINDOW, h->pipeline.numWorkers, inFlight);
+		return 0;
+	}
+	else if ( argc == 1 && strcmp(argv[0], "on") == 0 )
+	{
+		// the workers are created with the first activation and are kept afterwards
+		while ( h->pipeline.numWorkers < CONSOLE_PIPELINE_WINDOW )
+		{
+#if CONSOLE_STATIC_ALLOCATION != 0
+			int i = h->pipeline.numWorkers;
+			h->pipeline.workers[i] = xTaskCreateStatic(ConsolePipelineWorker, "pipeline", h->pipeline.stackDepth, h,
+					h->pipeline.prio, ConsoleStaticWorkerStacks[i], &ConsoleStaticWorkers[i]);
+			if ( h->pipeline.workers[i] == NULL ) break;
+#else
+			if ( xTaskCreate(ConsolePipelineWorker, "pipeline", h->pipeline.stackDepth, h, h->pipeline.prio,
+					&h->pipeline.workers[h->pipeline.numWorkers]) != pdPASS ) break;
+#endif
+			h->pipeline.numWorkers += 1;
+		}
+
+		if ( h->pipeline.numWorkers == 0 )
+		{
+			printf("was not able to create the pipeline workers");
+			return -1;
+		}
+		h->pipeline.enabled = 1;
+		return 0;
+	}
+	else if ( argc == 1 && strcmp(argv[0], "off") == 0 )
+	{
+		// jobs which are still in flight are finished and printed anyway
+		h->pipeline.enabled = 0;
+		return 0;
+	}
+
+	printf("invalid number of arguments or invalid subcommand");
+	return -1;
+}
+#endif
+
 // --------------------------------------------------------------------------------------------------------------------
 static void ConsoleRegisterBasicCommands( ConsoleHandle_t h )
 // --------------------------------------------------------------------------------------------------------------------
@@ -1387,6 +2152,16 @@ static void ConsoleRegisterBasicCommands( ConsoleHandle_t h )
 			ConsolePrintKernelTicks, h);
 	CONSOLE_RegisterCommand(h, "alias",     "<<alias>>",
 			ConsoleAliasConfig, h);
+	CONSOLE_RegisterCommand(h, "script",    "<<script>> manages the stored command scripts of this console.\r\n<<script list>> prints all scripts, <<script add name cmd ...>>\r\nappends a step to the script and <<script remove name>> deletes it.",
+			ConsoleScriptConfig, h);
+	CONSOLE_RegisterCommand(h, "run",       "<<run>> executes the steps of the passed script one after another.\r\nThe script stops with the first failing step and prints\r\nthe result of every step and a summary.",
+			ConsoleRunScript, h);
+	CONSOLE_RegisterCommand(h, "machine",   "<<machine on>> switches the console to machine mode for scripted hosts.\r\nThere is no echo, no control sequence, no history and no prompt.\r\nEvery line is answered with its output and a terse <<=result>> line.\r\n<<machine off>> switches back to the interactive mode.",
+			ConsoleMachineConfig, h);
+#if CONSOLE_PIPELINE_WINDOW > 0
+	CONSOLE_RegisterCommand(h, "pipeline",  "<<pipeline>> prints the state of the pipelined mode, <<pipeline on>> and <<pipeline off>>\r\nswitch it. In pipelined mode, lines with a tag like <<#17 stepper move 10 -a>>\r\nare executed by worker tasks and the results are printed tagged\r\nin the order of completion. A full window is answered with <<#17 BUSY>>.",
+			ConsolePipelineConfig, h);
+#endif
 #if defined(configGENERATE_RUN_TIME_STATS) && (configGENERATE_RUN_TIME_STATS != 0)
 	CONSOLE_RegisterCommand(h, "tasks",     "<<tasks>> prints information about the active tasks\r\nand prints also runtime information.",
 		ConsolePrintTaskStats, h);
@@ -1398,11 +2173,25 @@ ConsoleHandle_t CONSOLE_CreateInstance( unsigned int uxStackDepth, int xPrio )
 // --------------------------------------------------------------------------------------------------------------------
 {
 #define ON_NULL_GOTO_ERROR(x) do { if ((x) == NULL) goto error; } while(0);
+#if CONSOLE_STATIC_ALLOCATION != 0
+	// there is only one static instance and its stack has a fixed size
+	if ( ConsoleStaticHandleUsed != 0 || uxStackDepth > CONSOLE_STATIC_STACK_DEPTH ) return NULL;
+
+	struct ConsoleHandle* h = &ConsoleStaticHandle;
+	memset(h, 0, sizeof(struct ConsoleHandle));
+	ConsoleStaticHandleUsed = 1;
+
+	h->cState.lockGuard = xSemaphoreCreateRecursiveMutexStatic(&ConsoleStaticLockGuard);
+	h->cState.execGuard = xSemaphoreCreateRecursiveMutexStatic(&ConsoleStaticExecGuard);
+#else
 	struct ConsoleHandle* h = calloc(sizeof(struct ConsoleHandle), 1);
 	ON_NULL_GOTO_ERROR(h);
 
 	h->cState.lockGuard = xSemaphoreCreateRecursiveMutex();
+	h->cState.execGuard = xSemaphoreCreateRecursiveMutex();
+#endif
 	ON_NULL_GOTO_ERROR(h->cState.lockGuard);
+	ON_NULL_GOTO_ERROR(h->cState.execGuard);
 	h->pState.state = ctrlpsIDLE_DETECT;
 	h->pState.length = 0;
 	h->pState.maxLength = CONSOLE_LINE_SIZE;
@@ -1413,13 +2202,42 @@ ConsoleHandle_t CONSOLE_CreateInstance( unsigned int uxStackDepth, int xPrio )
 	h->pendingRdStream = NULL;
 	h->pendingWrStream = NULL;
 
+#if CONSOLE_PIPELINE_WINDOW > 0
+	h->pipeline.enabled = 0;
+	h->pipeline.numWorkers = 0;
+#if CONSOLE_STATIC_ALLOCATION != 0
+	h->pipeline.stackDepth = CONSOLE_PIPELINE_STATIC_DEPTH;
+#else
+	h->pipeline.stackDepth = ( CONSOLE_PIPELINE_STACK_DEPTH != 0 ) ? CONSOLE_PIPELINE_STACK_DEPTH : uxStackDepth;
+#endif
+	h->pipeline.prio = xPrio;
+	h->pipeline.freeJobs = CONSOLE_JOB_QUEUE(0);
+	ON_NULL_GOTO_ERROR(h->pipeline.freeJobs);
+	h->pipeline.pendingJobs = CONSOLE_JOB_QUEUE(1);
+	ON_NULL_GOTO_ERROR(h->pipeline.pendingJobs);
+	h->pipeline.doneJobs = CONSOLE_JOB_QUEUE(2);
+	ON_NULL_GOTO_ERROR(h->pipeline.doneJobs);
+	for ( int i = 0; i < CONSOLE_PIPELINE_WINDOW; i++ )
+	{
+		pipeJob_t* job = &h->pipeline.jobs[i];
+		xQueueSend(h->pipeline.freeJobs, &job, 0);
+	}
+#endif
+
 	LIST_INIT(&h->cState.commands);
+	LIST_INIT(&h->cState.scripts);
+	memset(h->cState.chainNesting, 0, sizeof(h->cState.chainNesting));
+	h->cState.machineMode = CONSOLE_MACHINE_MODE;
 	ConsoleRegisterBasicCommands(h);
 
 	memset(h->history.lines, 0, sizeof(h->history.lines));
 	h->history.linePtr = h->history.lineHead = 0;
 
+#if CONSOLE_STATIC_ALLOCATION != 0
+	h->tHandle = xTaskCreateStatic(ConsoleFunction, "console", uxStackDepth, h, xPrio, ConsoleStaticStack, &ConsoleStaticTask);
+#else
 	xTaskCreate(ConsoleFunction, "console", uxStackDepth, h, xPrio, &h->tHandle);
+#endif
 	ON_NULL_GOTO_ERROR(h->tHandle);
 	return h;
 
@@ -1432,7 +2250,23 @@ error:
 			h->cState.lockGuard = NULL;
 		}
 
+		if ( h->cState.execGuard != NULL )
+		{
+			vSemaphoreDelete(h->cState.execGuard);
+			h->cState.execGuard = NULL;
+		}
+
+#if CONSOLE_PIPELINE_WINDOW > 0
+		if ( h->pipeline.freeJobs    != NULL ) vQueueDelete(h->pipeline.freeJobs);
+		if ( h->pipeline.pendingJobs != NULL ) vQueueDelete(h->pipeline.pendingJobs);
+		if ( h->pipeline.doneJobs    != NULL ) vQueueDelete(h->pipeline.doneJobs);
+#endif
+
+#if CONSOLE_STATIC_ALLOCATION != 0
+		ConsoleStaticHandleUsed = 0;
+#else
 		free(h);
+#endif
 	}
 
 	return NULL;
@@ -1473,9 +2307,14 @@ int CONSOLE_RegisterCommand( ConsoleHandle_t h, char* cmd, char* help, CONSOLE_C
 	}
 	else
 	{
-		struct cmdEntry *item = malloc(sizeof(struct cmdEntry));
-		if (item == NULL) return result;
+		struct cmdEntry *item = CONSOLE_MALLOC(sizeof(struct cmdEntry));
+		if (item == NULL)
+		{
+			if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreGiveRecursive( h->cState.lockGuard );
+			return result;
+		}
 		item->content.isAlias = 0;
+		item->content.concurrent = 0;
 		item->content.cmdLen  = cmdLen;
 		item->content.helpLen = helpLen;
 		item->content.func    = func;
@@ -1529,9 +2368,14 @@ int CONSOLE_RegisterAlias( ConsoleHandle_t h, char* cmd, char* aliasCmd )
 	}
 	else
 	{
-		struct cmdEntry *item = malloc(sizeof(struct cmdEntry));
-		if (item == NULL) return result;
+		struct cmdEntry *item = CONSOLE_MALLOC(sizeof(struct cmdEntry));
+		if (item == NULL)
+		{
+			if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreGiveRecursive( h->cState.lockGuard );
+			return result;
+		}
 		item->content.isAlias = 1;
+		item->content.concurrent = 0;
 		item->content.cmdLen  = cmdLen;
 		item->content.helpLen = aliasCmdLen;
 		item->content.func    = NULL;
@@ -1579,7 +2423,7 @@ int CONSOLE_RemoveAliasOrCommand( ConsoleHandle_t h, char* cmd)
 	if ( found == 1 )
 	{
 		LIST_REMOVE(pElement, navigate);
-		free(pElement);
+		CONSOLE_FREE(pElement);
 		result = 0;
 	}
 
@@ -1588,9 +2432,184 @@ int CONSOLE_RemoveAliasOrCommand( ConsoleHandle_t h, char* cmd)
 	return result;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_SetCommandConcurrent( ConsoleHandle_t h, char* cmd )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	int result = -1;
+	if ( cmd == NULL ) return result;
+	if ( *cmd == '\0' ) return result;
+	int cmdLen  = 0;
+	if ( (cmdLen = (int)strnlen(cmd, CONSOLE_COMMAND_MAX_LENGTH+1) ) > CONSOLE_COMMAND_MAX_LENGTH ) return result;
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreTakeRecursive( h->cState.lockGuard, -1 );
+
+	cmdEntry_t* pElement = h->cState.commands.lh_first;
+	while ( pElement != NULL )
+	{
+		// an alias is only a replacement of the line, so only the mapped command can be concurrent
+		if ( strncmp(cmd, pElement->content.cmd, cmdLen) == 0 && cmdLen == pElement->content.cmdLen )
+		{
+			if ( pElement->content.isAlias == 0 )
+			{
+				pElement->content.concurrent = 1;
+				result = 0;
+			}
+			break;
+		}
+		pElement = pElement->navigate.le_next;
+	}
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreGiveRecursive( h->cState.lockGuard );
+	return result;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_RegisterScript( ConsoleHandle_t h, char* name, char* script )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return ConsoleAddScript(&h->cState, name, script, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_RemoveScript( ConsoleHandle_t h, char* name )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	int result = -1;
+	if ( name == NULL ) return result;
+	if ( *name == '\0' ) return result;
+	int nameLen = 0;
+	if ( (nameLen = (int)strnlen(name, CONSOLE_COMMAND_MAX_LENGTH+1) ) > CONSOLE_COMMAND_MAX_LENGTH ) return result;
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreTakeRecursive( h->cState.lockGuard, -1 );
+
+	scriptEntry_t* pElement = h->cState.scripts.lh_first;
+	while ( pElement != NULL )
+	{
+		if ( strncmp(name, pElement->content.name, nameLen) == 0 && nameLen == pElement->content.nameLen )
+		{
+			LIST_REMOVE(pElement, navigate);
+			CONSOLE_FREE(pElement);
+			result = 0;
+			break;
+		}
+		pElement = pElement->navigate.le_next;
+	}
+
+	// could be called while the scheduler is not running or suspended, so we must not use to use the lock guard
+	if ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) xSemaphoreGiveRecursive( h->cState.lockGuard );
+	return result;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 void CONSOLE_DestroyInstance( ConsoleHandle_t h )
 // --------------------------------------------------------------------------------------------------------------------
 {
 	h->cancel = 1;
 }
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_FormatFixed( char* pBuffer, int size, long value, int decimals )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the digits are generated backwards into a local buffer, which is large enough for the
+	// digits of a 64 bit long, the sign, the decimal point and the leading zeros of the fraction
+	char digits[CONSOLE_FORMAT_MAX_DECIMALS + 24];
+	int numDigits = 0;
+
+	if ( pBuffer == NULL || size <= 0 ) return -1;
+	if ( decimals < 0 || decimals > CONSOLE_FORMAT_MAX_DECIMALS ) return -1;
+
+	// the magnitude is calculated unsigned, so the smallest negative number does not overflow
+	unsigned long magnitude = ( value < 0 ) ? ( 0UL - (unsigned long)value ) : (unsigned long)value;
+	do
+	{
+		digits[numDigits++] = (char)( '0' + ( magnitude % 10 ) );
+		magnitude /= 10;
+		if ( numDigits == decimals ) digits[numDigits++] = '.';
+	} while ( magnitude != 0 || numDigits <= decimals );
+
+	// a fraction always gets a leading zero, e.g. 0.05 instead of .05
+	if ( digits[numDigits - 1] == '.' ) digits[numDigits++] = '0';
+	if ( value < 0 ) digits[numDigits++] = '-';
+
+	if ( numDigits >= size ) return -1;
+	for ( int i = 0; i < numDigits; i++ ) pBuffer[i] = digits[numDigits - 1 - i];
+	pBuffer[numDigits] = '\0';
+	return numDigits;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_FormatInt( char* pBuffer, int size, long value )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return CONSOLE_FormatFixed(pBuffer, size, value, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_FormatU64( char* pBuffer, int size, unsigned long long value )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// 20 digits are enough for 64 bits, nano printf has no %llu
+	char digits[24];
+	int numDigits = 0;
+
+	if ( pBuffer == NULL || size <= 0 ) return -1;
+
+	do
+	{
+		digits[numDigits++] = (char)( '0' + (int)( value % 10ULL ) );
+		value /= 10ULL;
+	} while ( value != 0 );
+
+	if ( numDigits >= size ) return -1;
+	for ( int i = 0; i < numDigits; i++ ) pBuffer[i] = digits[numDigits - 1 - i];
+	pBuffer[numDigits] = '\0';
+	return numDigits;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_FormatFloat( char* pBuffer, int size, float value, int decimals )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	static const float scales[CONSOLE_FORMAT_MAX_DECIMALS + 1] =
+		{ 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f };
+
+	if ( decimals < 0 || decimals > CONSOLE_FORMAT_MAX_DECIMALS ) return -1;
+
+	// only single precision, so the FPU does the job without any soft float or dtoa of the stdlib. A large value
+	// drops decimals until it fits into 32 bits, those are beyond the precision of a float anyway
+	for ( ; decimals >= 0; decimals-- )
+	{
+		float scaled = value * scales[decimals];
+		scaled += ( scaled < 0.0f ) ? -0.5f : 0.5f;
+		if ( scaled > -2147483520.0f && scaled < 2147483520.0f )
+		{
+			return CONSOLE_FormatFixed(pBuffer, size, (long)scaled, decimals);
+		}
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_PrintFloat( float value, int decimals )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	char buffer[CONSOLE_FORMAT_MAX_DECIMALS + 24];
+	int length = CONSOLE_FormatFloat(buffer, sizeof(buffer), value, decimals);
+	if ( length < 0 ) return -1;
+	return ( fputs(buffer, stdout) < 0 ) ? -1 : length;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CONSOLE_PrintInt( long value )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	char buffer[CONSOLE_FORMAT_MAX_DECIMALS + 24];
+	int length = CONSOLE_FormatFixed(buffer, sizeof(buffer), value, 0);
+	if ( length < 0 ) return -1;
+	return ( fputs(buffer, stdout) < 0 ) ? -1 : length;
+}
@@ -10,6 +10,7 @@
 #ifndef INC_SPINDLE_CONTROLLER_H_
 #define INC_SPINDLE_CONTROLLER_H_
 
+#include "FreeRTOS.h"
 #include "Console.h"
 
 /*!
@@ -18,6 +19,25 @@
  */
 typedef struct SpindleHandle* SpindleHandle_t;
 
+/*!
+ * number of points of the RPM to duty cycle table
+ */
+#define SPINDLE_CAL_POINTS 16
+
+/*!
+ * The SpindleCalibration_t structure is the RPM to duty cycle table of the spindle. It is recorded by the
+ * calibration sweep or with host supplied points and it is stored and loaded by the platform as a plain
+ * block of bytes. The library validates the magic, the checksum and the monotony when loading it.
+ */
+typedef struct SpindleCalibration
+{
+	unsigned int magic;
+	unsigned int count;
+	float        duty[SPINDLE_CAL_POINTS];
+	float        rpm[SPINDLE_CAL_POINTS];
+	unsigned int checksum;
+} SpindleCalibration_t;
+
 /*!
  * The SpindlePhysicalParams_t structure is represents the abstraction functions and members as a container.
  * The objetcs are passed as structure pointer when calling SPINDLE_CreateInstance. It contains function pointers
@@ -124,6 +144,95 @@ typedef struct SpindlePhysicalParams
 	 */
 	void*        context;
 
+	/*!
+	 * This optional function pointer returns the measured absolute RPM of the spindle, e.g. from a tachometer
+	 * input capture. When it is set, the spindle controller can run a PID loop with a fixed period instead of the
+	 * open loop duty cycle and the status reports the measured RPM instead of the requested one. The loop starts
+	 * open and is closed with the console command spindle loop on, since a sensor without signal reads 0 RPM.
+	 *
+	 * The pointer can be null, then the spindle runs open loop
+	 *
+     * @param[in,out] h         optional handle of the spindle library.
+     * @param[in,out] context   optional context pointer the user has passed by the SPINDLE_CreateInstance call.
+	 */
+	float (*getMeasuredRPM)(SpindleHandle_t h, void* context);
+
+	/*!
+	 * proportional gain of the RPM loop in duty cycle per RPM of error
+	 */
+	float        kp;
+
+	/*!
+	 * integral gain of the RPM loop in duty cycle per RPM of error and second
+	 */
+	float        ki;
+
+	/*!
+	 * derivative gain of the RPM loop in duty cycle per RPM/s, it is applied on the measurement
+	 * and not on the error, so setpoint changes do not kick the output
+	 */
+	float        kd;
+
+	/*!
+	 * period of the RPM loop and the speed ramps in milliseconds, 0 selects the default of 10ms
+	 */
+	unsigned int controlPeriodMs;
+
+	/*!
+	 * relative band around the setpoint which counts as settled for the settle time metric,
+	 * e.g. 0.02 for 2%. 0 selects the default of 2%
+	 */
+	float        settleBand;
+
+	/*!
+	 * acceleration of the speed ramp in RPM/s which is used when the absolute speed rises. 0 disables the ramps,
+	 * then a speed change is applied as a step and low speeds get a short startup boost in open loop
+	 */
+	float        accelRPMs;
+
+	/*!
+	 * deceleration of the speed ramp in RPM/s which is used when the absolute speed falls, for stop and when
+	 * reversing through zero. The direction is only changed at zero speed. 0 uses the acceleration value
+	 */
+	float        decelRPMs;
+
+	/*!
+	 * This optional function pointer stores the RPM to duty cycle table in non volatile memory, e.g. a flash sector.
+	 * It is called by the console command spindle cal save, only while the spindle stands still. The function can
+	 * refuse it with -1 as well, e.g. while other parts of the machine move. The return value is 0 on success.
+	 *
+	 * The pointer can be null, then the table can not be saved
+	 *
+     * @param[in,out] h         optional handle of the spindle library.
+     * @param[in,out] context   optional context pointer the user has passed by the SPINDLE_CreateInstance call.
+     * @param[in]     c         table which has to be stored as it is.
+	 */
+	int (*saveCalibration)(SpindleHandle_t h, void* context, const SpindleCalibration_t* c);
+
+	/*!
+	 * This optional function pointer loads the RPM to duty cycle table which has been stored by saveCalibration.
+	 * It is called once by SPINDLE_CreateInstance. The return value is 0 on success, otherwise -1.
+	 *
+	 * The pointer can be null, then the duty cycle is linear in RPM until a table is recorded
+	 *
+     * @param[in,out] h         optional handle of the spindle library.
+     * @param[in,out] context   optional context pointer the user has passed by the SPINDLE_CreateInstance call.
+     * @param[out]    c         receives the stored table.
+	 */
+	int (*loadCalibration)(SpindleHandle_t h, void* context, SpindleCalibration_t* c);
+
+	/*!
+	 * This optional function pointer returns the live position in mm of the axis which sets the radius for the
+	 * constant surface speed, e.g. the cross slide. It is called from the spindle task with the period of the
+	 * RPM loop while the constant surface speed is active, so it must not block.
+	 *
+	 * The pointer can be null, then the constant surface speed is not available
+	 *
+     * @param[in,out] h         optional handle of the spindle library.
+     * @param[in,out] context   optional context pointer the user has passed by the SPINDLE_CreateInstance call.
+	 */
+	float (*getAxisPosition)(SpindleHandle_t h, void* context);
+
 } SpindlePhysicalParams_t;
 
 /*!
@@ -145,6 +254,68 @@ typedef struct SpindlePhysicalParams
  */
 SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, ConsoleHandle_t cH, SpindlePhysicalParams_t* p );
 
+/*!
+ * The SPINDLE_GetStatus function reads the running state and the current RPM of the spindle controller without
+ * sending a command to the controller task. It is meant for periodic status readers like a telemetry task which
+ * must not wait for the command processing. The values are read from the status snapshot, see SPINDLE_GetSnapshot.
+ *
+ * The return value is 0 on success or -1 in case the handle is invalid
+ *
+ * param h of type SpindleHandle_t is the handle which is returned by SPINDLE_CreateInstance
+ * param running of type int* receives 1 when the spindle is running, otherwise 0. Can be null.
+ * param speed of type float* receives the current RPM of the speed ramp, negative values are counter clock wise. Can be null.
+ * In closed loop, it receives the last measured RPM with the sign of the current direction.
+ */
+int SPINDLE_GetStatus( SpindleHandle_t h, int* running, float* speed );
+
+/*!
+ * The SPINDLE_GetSnapshot function reads a consistent copy of the spindle state without any lock and without a
+ * round trip to the controller task. The controller task publishes the state after every command and every tick
+ * of the ramps and the RPM loop, the reader retries in the rare case the task updates the state meanwhile.
+ *
+ * The return value is 0 on success or -1 in case the handle is invalid
+ *
+ * param h of type SpindleHandle_t is the handle which is returned by SPINDLE_CreateInstance
+ * param running of type int* receives 1 when the spindle is running, otherwise 0. Can be null.
+ * param setpoint of type float* receives the requested RPM, negative values are counter clock wise. Can be null.
+ * param speed of type float* receives the current RPM like SPINDLE_GetStatus. Can be null.
+ */
+int SPINDLE_GetSnapshot( SpindleHandle_t h, int* running, float* setpoint, float* speed );
+
+/*!
+ * The SPINDLE_Start function starts the spindle or changes its speed like the console command spindle start.
+ * With wait = 0 the command is fire and forget, it is queued without blocking and the function returns at once.
+ * With wait = 1 the calling task is blocked until the controller processed the command. The reply is sent as
+ * direct task notification, so the calling task must not use its task notification for other purposes.
+ *
+ * The return value is 0 on success or -1 in case the command failed or the queue is full
+ *
+ * param h of type SpindleHandle_t is the handle which is returned by SPINDLE_CreateInstance
+ * param rpm of type float is the requested RPM, negative values are counter clock wise.
+ * param wait of type int selects whether the call waits for the controller.
+ */
+int SPINDLE_Start( SpindleHandle_t h, float rpm, int wait );
+
+/*!
+ * The SPINDLE_Stop function stops the spindle like the console command spindle stop. The wait argument
+ * and the return value behave like the ones of SPINDLE_Start.
+ *
+ * param h of type SpindleHandle_t is the handle which is returned by SPINDLE_CreateInstance
+ * param wait of type int selects whether the call waits for the controller.
+ */
+int SPINDLE_Stop( SpindleHandle_t h, int wait );
+
+/*!
+ * The SPINDLE_StopFromISR function queues a stop command from an interrupt, e.g. after a protection circuit
+ * has already switched off the bridge. It never blocks and it does not wait for the controller.
+ *
+ * The return value is 0 on success or -1 in case the queue is full
+ *
+ * param h of type SpindleHandle_t is the handle which is returned by SPINDLE_CreateInstance
+ * param pxHigherPriorityTaskWoken is set like with xQueueSendFromISR, the caller yields at the end of the ISR.
+ */
+int SPINDLE_StopFromISR( SpindleHandle_t h, BaseType_t* pxHigherPriorityTaskWoken );
+
 
 /*!
  * \mainpage FreeRTOS Spindle Library
@@ -155,7 +326,10 @@ SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, Co
  * in this documentation as well
  *
  * \section static_sec static compile flags of the library
- * There are no additional static compile flags or DEFINES which the user can configure
+ * SPINDLE_STATIC_ALLOCATION places the instance, its task and its command queue in static buffers instead of the
+ * heap. It follows configSUPPORT_STATIC_ALLOCATION of the FreeRTOS config by default. The static stack has
+ * SPINDLE_STATIC_STACK_DEPTH words, 4*configMINIMAL_STACK_SIZE by default, and the stack depth which is passed
+ * to SPINDLE_CreateInstance must not be larger
  * 
  * \section instantiation library instantiation
  * The library is implemented as a singleton pattern. This means that only one instance
@@ -167,8 +341,8 @@ SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, Co
  *
  * \code
  * 
- * // set parameters for the physical system
- * SpindlePhysicalParams_t s;
+ * // set parameters for the physical system, all optional members are zero
+ * SpindlePhysicalParams_t s = { 0 };
  * s.maxRPM             =  9000.0f;
  * s.minRPM             = -9000.0f;
  * s.absMinRPM          =  1600.0f;
@@ -203,6 +377,73 @@ SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, Co
  * // get the status the spindle
  * $> spindle status
  * \endcode
+ *
+ * When the platform provides SpindlePhysicalParams_t[getMeasuredRPM], the spindle can run closed loop. The loop
+ * starts open and is closed or opened while the spindle stands still. The loop command prints on or off, the
+ * gains, the measured RPM, the duty cycle and the settle time of the last setpoint change in ms (-1 while not
+ * settled). The gains can be changed at runtime.
+ *
+ * \code
+ * // print the state of the RPM loop
+ * $> spindle loop
+ *
+ * // close or open the RPM loop
+ * $> spindle loop on
+ * $> spindle loop off
+ *
+ * // change the gains of the RPM loop
+ * $> spindle loop <kp> <ki> <kd>
+ * \endcode
+ *
+ * Speed changes follow ramps in RPM/s when SpindlePhysicalParams_t[accelRPMs] is set. A reversal decelerates
+ * to zero, changes the direction and accelerates again, so the spindle does not need to be stopped before.
+ * The stop command returns immediately, the status reports running until the ramp reached zero. The ramps
+ * can only be changed while the spindle stands still.
+ *
+ * \code
+ * // print the ramps
+ * $> spindle ramp
+ *
+ * // set acceleration and optional deceleration in RPM/s
+ * $> spindle ramp <accel> [<decel>]
+ * \endcode
+ *
+ * With SpindlePhysicalParams_t[getAxisPosition], the spindle can run with constant surface speed for facing. The
+ * RPM is surface / (2 * pi * r), where r is the distance of the axis position to the center, limited by minRPM,
+ * maxRPM and absMinRPM. The setpoint is updated with the period of the RPM loop and follows through the ramps.
+ * The command starts the spindle, the sign of the surface speed is the direction. Start and stop end it.
+ *
+ * \code
+ * // print the state, the radius and the RPM
+ * $> spindle css
+ *
+ * // surface speed in m/min and center of the axis in mm
+ * $> spindle css <surface> <center>
+ *
+ * // keep the current RPM
+ * $> spindle css off
+ * \endcode
+ *
+ * The open loop duty cycle and the feed forward of the RPM loop use a calibrated RPM to duty cycle table with linear
+ * interpolation when one is available, otherwise the duty cycle is linear in RPM. The table is recorded by a sweep
+ * with the tachometer or with points measured by the host, it is stored by SpindlePhysicalParams_t[saveCalibration].
+ *
+ * \code
+ * // print the table
+ * $> spindle cal
+ *
+ * // sweep the duty cycle with the tachometer, this takes some seconds
+ * $> spindle cal run
+ *
+ * // without tachometer: set a raw duty cycle, measure the RPM on the host and store the point
+ * $> spindle cal duty <duty>
+ * $> spindle cal set <duty> <RPM>
+ * $> spindle stop
+ *
+ * // forget or store the table
+ * $> spindle cal clear
+ * $> spindle cal save
+ * \endcode
  */
 
  /*!
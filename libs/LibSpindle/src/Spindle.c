@@ -11,7 +11,6 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
 #include "queue.h"
 #include "timers.h"
 
@@ -19,9 +18,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/queue.h>
+#include <stddef.h>
 #include <math.h>
 
+// default period of the RPM loop in ms
+#define SPINDLE_DEFAULT_CONTROL_PERIOD_MS 10
+// default relative band around the setpoint for the settle time metric
+#define SPINDLE_DEFAULT_SETTLE_BAND 0.02f
+// number of consecutive loop cycles within the band until the spindle counts as settled
+#define SPINDLE_SETTLE_CYCLES 5
+// duration of the low speed boost in ms, only used open loop without ramps
+#define SPINDLE_BOOST_MS 100
+// time for the spindle to follow a duty step of the calibration sweep and number of averaged measurements
+#define SPINDLE_CAL_SETTLE_MS 800
+#define SPINDLE_CAL_MEASUREMENTS 10
+#define SPINDLE_CAL_MAGIC 0x53434C31U
+// radius in mm below which the constant surface speed runs with the maximum RPM
+#define SPINDLE_CSS_MIN_RADIUS 0.1f
+// number of commands which can be queued for the controller task
+#define SPINDLE_QUEUE_LENGTH 16
+
+// the handle, the task and the command queue are static instead of allocated when set to 1
+#ifndef SPINDLE_STATIC_ALLOCATION
+#  define SPINDLE_STATIC_ALLOCATION configSUPPORT_STATIC_ALLOCATION
+#endif
+
+// size of the static stack of the controller task in words, the stack depth of SPINDLE_CreateInstance must not be larger
+#ifndef SPINDLE_STATIC_STACK_DEPTH
+#  define SPINDLE_STATIC_STACK_DEPTH (4 * configMINIMAL_STACK_SIZE)
+#endif
+
 // singleton instance pointer
 // --------------------------------------------------------------------------------------------------------------------
 static SpindleHandle_t SpindleInstancePointer = NULL;
@@ -33,9 +59,24 @@ typedef enum
 	cctNONE      = 0x00,
 	cctSTART     = 0x01,
 	cctSTOP      = 0x02,
-	cctSTATUS    = 0x04,
+	cctLOOP      = 0x08,
+	cctRAMP      = 0x10,
+	cctCALIBRATE = 0x20,
+	cctCSS       = 0x40,
 } CtrlCommandType_t;
 
+// --------------------------------------------------------------------------------------------------------------------
+typedef enum
+// --------------------------------------------------------------------------------------------------------------------
+{
+	ccoSHOW      = 0x00,
+	ccoRUN       = 0x01,
+	ccoDUTY      = 0x02,
+	ccoSET       = 0x03,
+	ccoCLEAR     = 0x04,
+	ccoSAVE      = 0x05,
+} CalibrationOperation_t;
+
 // --------------------------------------------------------------------------------------------------------------------
 typedef struct StepCommandResponse
 // --------------------------------------------------------------------------------------------------------------------
@@ -46,9 +87,28 @@ typedef struct StepCommandResponse
 	{
 		struct
 		{
+			float kp;
+			float ki;
+			float kd;
+			float measured;
+			float duty;
+			int   settleMs;
+			int   closed;
+		} asLoop;
+		struct
+		{
+			float accel;
+			float decel;
+		} asRamp;
+		SpindleCalibration_t asCalibration;
+		struct
+		{
+			int   active;
+			float surface;
+			float center;
+			float radius;
 			float speed;
-			int running;
-		} asStatus;
+		} asCss;
 	} args;
 } StepCommandResponse_t;
 
@@ -69,25 +129,39 @@ typedef struct CtrlCommand
 			{
 				float speed;
 			} asStart;
+			struct
+			{
+				int   set;
+				int   enable;
+				float kp;
+				float ki;
+				float kd;
+			} asLoop;
+			struct
+			{
+				int   set;
+				float accel;
+				float decel;
+			} asRamp;
+			struct
+			{
+				CalibrationOperation_t operation;
+				float duty;
+				float rpm;
+			} asCalibration;
+			struct
+			{
+				int   set;
+				int   enable;
+				float surface;
+				float center;
+			} asCss;
 		} args;
-		SemaphoreHandle_t syncEvent;
+		TaskHandle_t replyTask;
 	} request;
 	StepCommandResponse_t* response;
 } CtrlCommand_t;
 
-// --------------------------------------------------------------------------------------------------------------------
-typedef struct stepSyncEventElement
-// --------------------------------------------------------------------------------------------------------------------
-{
-    struct
-	{
-    	int               allocated;
-    	SemaphoreHandle_t event;
-	} content;
-
-    LIST_ENTRY(stepSyncEventElement) navigate;
-} stepSyncEventElement_t;
-
 // --------------------------------------------------------------------------------------------------------------------
 struct SpindleHandle
 // --------------------------------------------------------------------------------------------------------------------
@@ -99,13 +173,401 @@ struct SpindleHandle
 	int               cancel;
 	SpindlePhysicalParams_t physical;
 	float             currentSpeed;
+	volatile int      isRunning;
+	struct
+	{
+		int           available;
+		int           closed;
+		TickType_t    period;
+		float         kp;
+		float         ki;
+		float         kd;
+		float         integral;
+		float         lastMeasured;
+		volatile float measured;
+		float         duty;
+		TickType_t    changeTick;
+		TickType_t    bandTick;
+		int           settleCount;
+		int           settleMs;
+	} loop;
+	struct
+	{
+		float         accel;
+		float         decel;
+		volatile float speed;
+		int           backward;
+		int           boost;
+		TickType_t    boostEnd;
+	} ramp;
+	SpindleCalibration_t calibration;
+	int               rawDuty;
+	struct
+	{
+		int           active;
+		float         surface;
+		float         center;
+		float         radius;
+	} css;
 	struct
 	{
-		SemaphoreHandle_t lockGuard;
-		LIST_HEAD(pool_list, stepSyncEventElement) pool;
-	} syncEventPool;
+		volatile unsigned int sequence;
+		volatile int   running;
+		volatile float setpoint;
+		volatile float speed;
+	} snapshot;
 };
 
+#if SPINDLE_STATIC_ALLOCATION != 0
+// the singleton instance with its kernel objects, so every address is fixed at link time
+// --------------------------------------------------------------------------------------------------------------------
+static struct SpindleHandle SpindleStaticHandle;
+static StaticTask_t         SpindleStaticTask;
+static StackType_t          SpindleStaticStack[SPINDLE_STATIC_STACK_DEPTH];
+static StaticQueue_t        SpindleStaticQueue;
+static uint8_t              SpindleStaticQueueStorage[SPINDLE_QUEUE_LENGTH * sizeof(CtrlCommand_t)];
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindleLoopReset( SpindleHandle_t h, int setpointChanged )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	h->loop.integral = 0.0f;
+	if ( setpointChanged )
+	{
+		h->loop.changeTick = xTaskGetTickCount();
+		h->loop.settleCount = 0;
+		h->loop.settleMs = -1;
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static unsigned int SpindleCalibrationChecksum( const SpindleCalibration_t* c )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// simple additive checksum over everything in front of the checksum
+	const unsigned char* b = (const unsigned char*)c;
+	unsigned int sum = 0;
+	for ( unsigned int i = 0; i < offsetof(SpindleCalibration_t, checksum); i++ ) sum += b[i];
+	return sum;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int SpindleCalibrationValid( const SpindleCalibration_t* c )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( c->magic != SPINDLE_CAL_MAGIC || c->count < 2 || c->count > SPINDLE_CAL_POINTS ) return 0;
+	if ( c->checksum != SpindleCalibrationChecksum(c) ) return 0;
+
+	// the table must be monotonic in both columns, otherwise the interpolation is ambiguous
+	for ( unsigned int i = 1; i < c->count; i++ )
+	{
+		if ( c->duty[i] <= c->duty[i - 1] || c->rpm[i] < c->rpm[i - 1] ) return 0;
+	}
+	return 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindleCalibrationFinish( SpindleCalibration_t* c )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// measurement noise must not break the monotony, a falling RPM is raised to its predecessor
+	for ( unsigned int i = 1; i < c->count; i++ )
+	{
+		if ( c->rpm[i] < c->rpm[i - 1] ) c->rpm[i] = c->rpm[i - 1];
+	}
+	c->magic = SPINDLE_CAL_MAGIC;
+	c->checksum = SpindleCalibrationChecksum(c);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static float SpindleRPMToDuty( SpindleHandle_t h, float rpm )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	const SpindleCalibration_t* c = &h->calibration;
+	float duty;
+
+	if ( rpm <= 0.0f ) return 0.0f;
+
+	if ( c->magic != SPINDLE_CAL_MAGIC )
+	{
+		// without a table the duty cycle is assumed to be linear in RPM
+		duty = rpm / h->physical.maxRPM;
+	}
+	else
+	{
+		// first point with an RPM above the requested one, the segment in front of it is interpolated
+		unsigned int i = 0;
+		while ( i < c->count - 1 && c->rpm[i] < rpm ) i++;
+
+		float d0 = ( i > 0 ) ? c->duty[i - 1] : 0.0f;
+		float r0 = ( i > 0 ) ? c->rpm[i - 1] : 0.0f;
+		float d1 = c->duty[i];
+		float r1 = c->rpm[i];
+
+		// flat segments are the stall region below the break away duty, their upper end is used
+		duty = ( r1 > r0 ) ? d0 + ( d1 - d0 ) * ( rpm - r0 ) / ( r1 - r0 ) : d1;
+	}
+
+	if ( duty > 1.0f ) duty = 1.0f;
+	return duty;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int SpindleCalibrationWait( SpindleHandle_t h, TickType_t ticks )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the sweep blocks the command processor, so the queue is watched while it waits. A stop ends the sweep and goes
+	// back to the front of the queue for the command processor, every other command is rejected as busy
+	CtrlCommand_t cmd;
+	TickType_t start = xTaskGetTickCount();
+	TickType_t elapsed = 0;
+
+	while ( elapsed < ticks )
+	{
+		if ( xQueueReceive( h->cmdQueue, &cmd, ticks - elapsed ) == pdPASS )
+		{
+			if ( cmd.head.type == cctSTOP )
+			{
+				// the queue has room since the stop was just taken out, the sweep switches the bridge off anyway
+				xQueueSendToFront( h->cmdQueue, &cmd, 0 );
+				return -1;
+			}
+			if ( cmd.response != NULL && cmd.request.replyTask != NULL )
+			{
+				memset(cmd.response, 0, sizeof(StepCommandResponse_t));
+				cmd.response->code = -1;
+				cmd.response->requestID = cmd.head.requestID;
+				xTaskNotifyGive(cmd.request.replyTask);
+			}
+		}
+		elapsed = xTaskGetTickCount() - start;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int SpindleCalibrationRun( SpindleHandle_t h )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	SpindleCalibration_t c;
+	int stopped = 0;
+	memset(&c, 0, sizeof(c));
+
+	// the sweep runs forward from the lowest to the highest duty cycle, every step settles before it is measured
+	h->physical.setDirection(h, h->physical.context, 0 );
+	h->physical.setDutyCycle(h, h->physical.context, 0.0f );
+	h->physical.enaPWM(h, h->physical.context, 1);
+
+	for ( unsigned int i = 0; i < SPINDLE_CAL_POINTS && !h->cancel && !stopped; i++ )
+	{
+		float duty = (float)( i + 1 ) / (float)SPINDLE_CAL_POINTS;
+		float sum = 0.0f;
+
+		h->physical.setDutyCycle(h, h->physical.context, duty );
+		stopped = SpindleCalibrationWait( h, pdMS_TO_TICKS(SPINDLE_CAL_SETTLE_MS) );
+		for ( int m = 0; m < SPINDLE_CAL_MEASUREMENTS && !stopped; m++ )
+		{
+			sum += h->physical.getMeasuredRPM(h, h->physical.context);
+			stopped = SpindleCalibrationWait( h, h->loop.period );
+		}
+		if ( stopped ) break;
+
+		c.duty[i] = duty;
+		c.rpm[i] = sum / (float)SPINDLE_CAL_MEASUREMENTS;
+		c.count = i + 1;
+	}
+
+	h->physical.setDutyCycle(h, h->physical.context, 0.0f );
+	h->physical.enaPWM(h, h->physical.context, 0);
+	h->ramp.backward = 0;
+
+	if ( c.count != SPINDLE_CAL_POINTS ) return -1;
+	SpindleCalibrationFinish(&c);
+	memcpy(&h->calibration, &c, sizeof(c));
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int SpindleCalibrationSet( SpindleHandle_t h, float duty, float rpm )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	SpindleCalibration_t* c = &h->calibration;
+	unsigned int i = 0;
+
+	if ( duty <= 0.0f || duty > 1.0f || rpm < 0.0f ) return -1;
+
+	// host supplied points are kept sorted by duty cycle, an existing duty cycle is overwritten
+	while ( i < c->count && c->duty[i] < duty ) i++;
+	if ( i == c->count || c->duty[i] != duty )
+	{
+		if ( c->count >= SPINDLE_CAL_POINTS ) return -1;
+		memmove(&c->duty[i + 1], &c->duty[i], ( c->count - i ) * sizeof(float));
+		memmove(&c->rpm[i + 1], &c->rpm[i], ( c->count - i ) * sizeof(float));
+		c->count += 1;
+	}
+	c->duty[i] = duty;
+	c->rpm[i] = rpm;
+
+	// the table is only used once it has two points
+	c->magic = 0;
+	if ( c->count >= 2 ) SpindleCalibrationFinish(c);
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindleLoopStep( SpindleHandle_t h, unsigned int running )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	float dt = (float)h->loop.period / (float)configTICK_RATE_HZ;
+	float measured = h->physical.getMeasuredRPM(h, h->physical.context);
+	float derivative = ( measured - h->loop.lastMeasured ) / dt;
+	h->loop.lastMeasured = measured;
+	h->loop.measured = measured;
+
+	if ( running == 0 )
+	{
+		h->loop.integral = 0.0f;
+		h->loop.duty = 0.0f;
+		return;
+	}
+
+	// the open loop duty cycle is the feed forward part, the PID only corrects the error
+	float setpoint = fabsf(h->ramp.speed);
+	float error = setpoint - measured;
+	float feedForward = SpindleRPMToDuty(h, setpoint);
+	float integral = h->loop.integral + h->loop.ki * error * dt;
+	float duty = feedForward + h->loop.kp * error + integral - h->loop.kd * derivative;
+
+	// anti windup, the integral is frozen while the output is saturated and the error drives it further
+	if ( ( duty > 1.0f && error > 0.0f ) || ( duty < 0.0f && error < 0.0f ) )
+	{
+		duty = feedForward + h->loop.kp * error + h->loop.integral - h->loop.kd * derivative;
+	}
+	else
+	{
+		h->loop.integral = integral;
+	}
+
+	if ( duty > 1.0f ) duty = 1.0f;
+	if ( duty < 0.0f ) duty = 0.0f;
+	h->loop.duty = duty;
+	h->physical.setDutyCycle(h, h->physical.context, duty );
+
+	// settle time metric, the time from the setpoint change until the measurement entered the band
+	// and stayed there for some cycles
+	if ( h->loop.settleMs < 0 )
+	{
+		if ( fabsf(error) <= h->physical.settleBand * setpoint )
+		{
+			if ( h->loop.settleCount == 0 ) h->loop.bandTick = xTaskGetTickCount();
+			h->loop.settleCount += 1;
+			if ( h->loop.settleCount >= SPINDLE_SETTLE_CYCLES )
+			{
+				h->loop.settleMs = (int)( ( h->loop.bandTick - h->loop.changeTick ) * 1000U / configTICK_RATE_HZ );
+			}
+		}
+		else
+		{
+			h->loop.settleCount = 0;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static float SpindleLimitSpeed( SpindleHandle_t h, float speed )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( speed < h->physical.minRPM ) speed = h->physical.minRPM;
+	if ( speed > h->physical.maxRPM ) speed = h->physical.maxRPM;
+
+	if ( speed > 0.0f && speed <  h->physical.absMinRPM ) speed =  h->physical.absMinRPM;
+	if ( speed < 0.0f && speed > -h->physical.absMinRPM ) speed = -h->physical.absMinRPM;
+	return speed;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static float SpindleCssSpeed( SpindleHandle_t h )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// surface speed in m/min and radius in mm, the sign of the surface speed is the direction
+	float position = h->physical.getAxisPosition(h, h->physical.context);
+	h->css.radius = fabsf(position - h->css.center);
+
+	float rpm = h->physical.maxRPM;
+	if ( h->css.radius >= SPINDLE_CSS_MIN_RADIUS )
+	{
+		rpm = ( fabsf(h->css.surface) * 1000.0f ) / ( 2.0f * (float)M_PI * h->css.radius );
+	}
+	return SpindleLimitSpeed(h, ( h->css.surface < 0.0f ) ? -rpm : rpm);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindleRampStep( SpindleHandle_t h, float dt )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	float target = h->currentSpeed;
+	float speed = h->ramp.speed;
+
+	if ( h->ramp.accel <= 0.0f )
+	{
+		// ramps are disabled, so the speed jumps to the setpoint
+		speed = target;
+	}
+	else
+	{
+		// away from zero the acceleration is used, towards zero and through it the deceleration
+		int towardsZero = ( speed > 0.0f && target < speed ) || ( speed < 0.0f && target > speed );
+		float step = ( towardsZero ? h->ramp.decel : h->ramp.accel ) * dt;
+
+		if ( fabsf(target - speed) <= step ) speed = target;
+		else speed += ( target > speed ) ? step : -step;
+
+		// a reversal stops at zero for one period, the direction is changed there without load
+		if ( ( h->ramp.speed > 0.0f && speed < 0.0f ) || ( h->ramp.speed < 0.0f && speed > 0.0f ) ) speed = 0.0f;
+	}
+
+	h->ramp.speed = speed;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindleApplySpeed( SpindleHandle_t h )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	int backward = ( h->ramp.speed < 0.0f );
+	if ( h->ramp.speed != 0.0f && backward != h->ramp.backward )
+	{
+		h->ramp.backward = backward;
+		h->physical.setDirection(h, h->physical.context, backward );
+
+		// the integral of the other direction is useless
+		if ( h->loop.closed ) SpindleLoopReset(h, 0);
+	}
+
+	// in closed loop the duty cycle is set by the loop, during the boost it is fixed
+	if ( h->loop.closed == 0 && h->ramp.boost == 0 )
+	{
+		h->physical.setDutyCycle(h, h->physical.context, SpindleRPMToDuty(h, fabsf(h->ramp.speed)) );
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SpindlePublishStatus( SpindleHandle_t h )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	// the task is the only writer, readers retry while the sequence is odd or has changed
+	h->snapshot.sequence += 1;
+	h->snapshot.running = h->isRunning;
+	h->snapshot.setpoint = h->currentSpeed;
+	h->snapshot.speed = h->ramp.speed;
+	if ( h->loop.closed )
+	{
+		// the tachometer has no direction, so the sign of the current direction is used
+		h->snapshot.speed = h->ramp.backward ? -h->loop.measured : h->loop.measured;
+	}
+	h->snapshot.sequence += 1;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 static void SpindleFunction( void * arg )
 // --------------------------------------------------------------------------------------------------------------------
@@ -114,19 +576,40 @@ static void SpindleFunction( void * arg )
 	StepCommandResponse_t asyncResponse;
 	SpindleHandle_t h = (SpindleHandle_t)arg;
 	unsigned int running = 0;
-	unsigned int startupBoost = 0;
+	float dt = (float)h->loop.period / (float)configTICK_RATE_HZ;
 
 	h->physical.enaPWM(h, h->physical.context, 0);
+	h->physical.setDirection(h, h->physical.context, 0 );
 	h->physical.setDutyCycle(h, h->physical.context, 0.0f );
 	h->currentSpeed = 0;
+	h->ramp.speed = 0;
+	h->ramp.backward = 0;
+	SpindlePublishStatus(h);
+	TickType_t nextTick = xTaskGetTickCount() + h->loop.period;
 
 	// now here comes the command processor part
 	while( !h->cancel )
 	{
+		// the periodic tick is only required while the loop is closed, a ramp is active, the boost is running or the
+		// setpoint follows the axis. The wait time is limited by the next tick, so commands do not shift the period.
+		// A raw duty cycle of the calibration is held as it is, neither the ramp nor the loop must touch it
+		TickType_t waitTicks = 100;
+		TickType_t now = xTaskGetTickCount();
+		int tickRequired = h->rawDuty == 0 &&
+			( h->loop.closed || h->ramp.boost || h->css.active || ( h->ramp.speed != h->currentSpeed ) );
+		if ( tickRequired )
+		{
+			waitTicks = ( ( nextTick - now ) <= h->loop.period ) ? ( nextTick - now ) : 0;
+		}
+		else
+		{
+			nextTick = now + h->loop.period;
+		}
+
 		// wait for next command
-		if ( xQueueReceive( h->cmdQueue, &cmd, 100) == pdPASS )
+		if ( xQueueReceive( h->cmdQueue, &cmd, waitTicks) == pdPASS )
 		{
-			if ( cmd.response == NULL || cmd.request.syncEvent == NULL )
+			if ( cmd.response == NULL || cmd.request.replyTask == NULL )
 			{
 				cmd.response = &asyncResponse;
 			}
@@ -140,121 +623,264 @@ static void SpindleFunction( void * arg )
 			case cctNONE:
 				cmd.response->code = 0;
 				break;
+			case cctCSS:
+				cmd.response->code = 0;
+				if ( cmd.request.args.asCss.set )
+				{
+					if ( cmd.request.args.asCss.enable && ( h->physical.getAxisPosition == NULL || cmd.request.args.asCss.surface == 0.0f ) )
+					{
+						cmd.response->code = -1;
+					}
+					else if ( cmd.request.args.asCss.enable )
+					{
+						// the spindle is started with the RPM of the current radius, then it follows the axis with every tick
+						h->css.active = 1;
+						h->css.surface = cmd.request.args.asCss.surface;
+						h->css.center = cmd.request.args.asCss.center;
+						cmd.request.args.asStart.speed = SpindleCssSpeed(h);
+						goto start;
+					}
+					else
+					{
+						// the spindle keeps the last RPM
+						h->css.active = 0;
+					}
+				}
+				cmd.response->args.asCss.active = h->css.active;
+				cmd.response->args.asCss.surface = h->css.surface;
+				cmd.response->args.asCss.center = h->css.center;
+				cmd.response->args.asCss.radius = h->css.radius;
+				cmd.response->args.asCss.speed = h->currentSpeed;
+				break;
 			case cctSTART:
+				// an explicit RPM ends the constant surface speed
+				h->css.active = 0;
+start:
 				cmd.response->code = 0;
-				if ( cmd.request.args.asStart.speed < h->physical.minRPM ) cmd.request.args.asStart.speed = h->physical.minRPM;
-				if ( cmd.request.args.asStart.speed > h->physical.maxRPM ) cmd.request.args.asStart.speed = h->physical.maxRPM;
-
-				if (  cmd.request.args.asStart.speed > 0.0f && cmd.request.args.asStart.speed <  h->physical.absMinRPM ) cmd.request.args.asStart.speed =  h->physical.absMinRPM;
-				if (  cmd.request.args.asStart.speed < 0.0f && cmd.request.args.asStart.speed > -h->physical.absMinRPM ) cmd.request.args.asStart.speed = -h->physical.absMinRPM;
+				h->rawDuty = 0;
+				cmd.request.args.asStart.speed = SpindleLimitSpeed(h, cmd.request.args.asStart.speed);
 
 				int directionChange = 0;
-				if ((h->currentSpeed < 0.0f && cmd.request.args.asStart.speed > 0.0f) ||
-					(h->currentSpeed > 0.0f && cmd.request.args.asStart.speed < 0.0f))
+				if ((h->ramp.speed < 0.0f && cmd.request.args.asStart.speed > 0.0f) ||
+					(h->ramp.speed > 0.0f && cmd.request.args.asStart.speed < 0.0f))
 					directionChange = 1;
+				if ( h->currentSpeed != cmd.request.args.asStart.speed || running == 0 ) SpindleLoopReset(h, 1);
 				h->currentSpeed = cmd.request.args.asStart.speed;
 
-
-				h->physical.setDirection(h, h->physical.context, h->currentSpeed < 0.0f );
-				if ( running == 1 && directionChange == 0 )
+				// with ramps, the speed follows with the next ticks, otherwise it is applied right now
+				if ( h->ramp.accel <= 0.0f )
 				{
-					h->physical.setDutyCycle(h, h->physical.context, ( fabsf(h->currentSpeed) / h->physical.maxRPM) );
-					startupBoost = 0;
-				}
-				else if ( ( running == 0 || directionChange == 1 ) && fabsf(cmd.request.args.asStart.speed) <= (0.25f * h->physical.maxRPM) )
-				{
-					h->physical.setDutyCycle(h, h->physical.context, 0.5f );
-					startupBoost = 1;
-				}
-				if ( startupBoost == 0 )
-				{
-					h->physical.setDutyCycle(h, h->physical.context, ( fabsf(h->currentSpeed) / h->physical.maxRPM ) );
+					SpindleRampStep(h, dt);
+
+					// without ramps and loop, low speeds need a kick to break away
+					h->ramp.boost = 0;
+					if ( h->loop.closed == 0 && ( running == 0 || directionChange == 1 ) &&
+					     fabsf(h->currentSpeed) <= (0.25f * h->physical.maxRPM) )
+					{
+						SpindleApplySpeed(h);
+						h->physical.setDutyCycle(h, h->physical.context, 0.5f );
+						h->ramp.boost = 1;
+						h->ramp.boostEnd = xTaskGetTickCount() + pdMS_TO_TICKS(SPINDLE_BOOST_MS);
+					}
+					else
+					{
+						SpindleApplySpeed(h);
+					}
 				}
 
 				h->physical.enaPWM(h, h->physical.context, 1);
 				running = 1;
+				h->isRunning = 1;
 				break;
 			case cctSTOP:
 				cmd.response->code = 0;
+				h->css.active = 0;
+				h->rawDuty = 0;
 				h->currentSpeed = 0;
-				startupBoost = 0;
+				h->ramp.boost = 0;
 				running = 0;
-				h->physical.setDutyCycle(h, h->physical.context, 0.0f );
-				h->physical.enaPWM(h, h->physical.context, 0);
+				SpindleLoopReset(h, 1);
+				if ( h->ramp.accel <= 0.0f || h->ramp.speed == 0.0f )
+				{
+					h->ramp.speed = 0;
+					h->isRunning = 0;
+					h->physical.setDutyCycle(h, h->physical.context, 0.0f );
+					h->physical.enaPWM(h, h->physical.context, 0);
+				}
 				break;
-			case cctSTATUS:
+			case cctLOOP:
+				cmd.response->code = h->loop.available ? 0 : -1;
+				if ( h->loop.available && cmd.request.args.asLoop.enable >= 0 )
+				{
+					// the loop is only switched while the spindle stands still, the duty cycle would jump otherwise
+					if ( h->isRunning )
+					{
+						cmd.response->code = -1;
+					}
+					else
+					{
+						h->loop.closed = cmd.request.args.asLoop.enable;
+						h->loop.duty = 0.0f;
+						SpindleLoopReset(h, 1);
+					}
+				}
+				if ( h->loop.available && cmd.request.args.asLoop.set )
+				{
+					h->loop.kp = cmd.request.args.asLoop.kp;
+					h->loop.ki = cmd.request.args.asLoop.ki;
+					h->loop.kd = cmd.request.args.asLoop.kd;
+					h->loop.integral = 0.0f;
+				}
+				cmd.response->args.asLoop.kp = h->loop.kp;
+				cmd.response->args.asLoop.ki = h->loop.ki;
+				cmd.response->args.asLoop.kd = h->loop.kd;
+				cmd.response->args.asLoop.measured = h->loop.measured;
+				cmd.response->args.asLoop.duty = h->loop.duty;
+				cmd.response->args.asLoop.settleMs = h->loop.settleMs;
+				cmd.response->args.asLoop.closed = h->loop.closed;
+				break;
+			case cctCALIBRATE:
 				cmd.response->code = 0;
-				cmd.response->args.asStatus.running = running;
-				cmd.response->args.asStatus.speed = h->currentSpeed;
+				switch ( cmd.request.args.asCalibration.operation )
+				{
+				case ccoRUN:
+					// the sweep needs the measurement and a standing spindle, it blocks the controller meanwhile
+					if ( h->isRunning || h->loop.available == 0 )
+					{
+						cmd.response->code = -1;
+						break;
+					}
+					h->isRunning = 1;
+					SpindlePublishStatus(h);
+					cmd.response->code = SpindleCalibrationRun(h);
+					h->isRunning = 0;
+					break;
+				case ccoDUTY:
+					// a raw duty cycle for a host measurement, it is ended by the stop command
+					if ( running || h->ramp.speed != 0.0f || cmd.request.args.asCalibration.duty < 0.0f || cmd.request.args.asCalibration.duty > 1.0f )
+					{
+						cmd.response->code = -1;
+						break;
+					}
+					h->ramp.backward = 0;
+					h->physical.setDirection(h, h->physical.context, 0 );
+					h->physical.setDutyCycle(h, h->physical.context, cmd.request.args.asCalibration.duty );
+					h->physical.enaPWM(h, h->physical.context, 1);
+					h->isRunning = 1;
+					h->rawDuty = 1;
+					break;
+				case ccoSET:
+					cmd.response->code = SpindleCalibrationSet(h, cmd.request.args.asCalibration.duty, cmd.request.args.asCalibration.rpm);
+					break;
+				case ccoCLEAR:
+					memset(&h->calibration, 0, sizeof(h->calibration));
+					break;
+				case ccoSAVE:
+					// storing the table may stall the CPU for a long time, so the spindle has to stand still
+					if ( h->isRunning || h->physical.saveCalibration == NULL || !SpindleCalibrationValid(&h->calibration) )
+					{
+						cmd.response->code = -1;
+						break;
+					}
+					cmd.response->code = h->physical.saveCalibration(h, h->physical.context, &h->calibration);
+					break;
+				default:
+					break;
+				}
+				memcpy(&cmd.response->args.asCalibration, &h->calibration, sizeof(SpindleCalibration_t));
+				break;
+			case cctRAMP:
+				cmd.response->code = 0;
+				if ( cmd.request.args.asRamp.set )
+				{
+					// ramps are only changed while the spindle stands still, otherwise a running ramp would jump
+					if ( h->isRunning )
+					{
+						cmd.response->code = -1;
+					}
+					else
+					{
+						h->ramp.accel = cmd.request.args.asRamp.accel;
+						h->ramp.decel = ( cmd.request.args.asRamp.decel > 0.0f ) ? cmd.request.args.asRamp.decel : h->ramp.accel;
+					}
+				}
+				cmd.response->args.asRamp.accel = h->ramp.accel;
+				cmd.response->args.asRamp.decel = h->ramp.decel;
 				break;
 			default:
 				break;
 			}
 
+			SpindlePublishStatus(h);
+
 			// after processing the command we have to release the caller to keep
-			// synchronous calling mechanism. In case there is no sync object, it was##
+			// synchronous calling mechanism. In case there is no reply task, it was
 			// called asynchronously
-			if ( cmd.request.syncEvent != NULL )
+			if ( cmd.request.replyTask != NULL )
 			{
-				xSemaphoreGive(cmd.request.syncEvent);
+				xTaskNotifyGive(cmd.request.replyTask);
 			}
 		}
-		else
+
+		// ramps, boost and loop run with a fixed period, independent of the command traffic
+		tickRequired = h->rawDuty == 0 &&
+			( h->loop.closed || h->ramp.boost || h->css.active || ( h->ramp.speed != h->currentSpeed ) );
+		if ( tickRequired && ( xTaskGetTickCount() - nextTick ) < ( portMAX_DELAY / 2 ) )
 		{
-			// here we have to do some additional steps to regulate correct rpm in case
-			// the low speed boost has been performed
-			if ( startupBoost == 1 && running == 1 )
+			// the setpoint of the constant surface speed follows the axis position, the ramps keep the changes smooth
+			if ( h->css.active ) h->currentSpeed = SpindleCssSpeed(h);
+
+			if ( h->ramp.boost && ( xTaskGetTickCount() - h->ramp.boostEnd ) < ( portMAX_DELAY / 2 ) )
 			{
-				startupBoost = 0;
-				h->physical.setDutyCycle(h, h->physical.context, ( fabsf(h->currentSpeed) / h->physical.maxRPM) );
+				h->ramp.boost = 0;
 			}
-		}
-	}
-}
 
-// --------------------------------------------------------------------------------------------------------------------
-static SemaphoreHandle_t GetCommandEvent( SpindleHandle_t h )
-// --------------------------------------------------------------------------------------------------------------------
-{
-	xSemaphoreTakeRecursive( h->syncEventPool.lockGuard, -1 );
+			SpindleRampStep(h, dt);
+			SpindleApplySpeed(h);
 
-	stepSyncEventElement_t* el = LIST_FIRST(&h->syncEventPool.pool);
-	while ( el != NULL )
-	{
-		if ( el->content.allocated == 0 )
-		{
-			el->content.allocated = 1;
-			// make sure we the event is in held state
-			xSemaphoreTake( el->content.event, 0 );
-			xSemaphoreGiveRecursive( h->syncEventPool.lockGuard );
-			return el->content.event;
+			// a stop ramp is finished at zero, then the bridge is disabled
+			if ( running == 0 && h->isRunning && h->ramp.speed == 0.0f )
+			{
+				h->isRunning = 0;
+				h->physical.setDutyCycle(h, h->physical.context, 0.0f );
+				h->physical.enaPWM(h, h->physical.context, 0);
+			}
+
+			if ( h->loop.closed ) SpindleLoopStep(h, h->isRunning);
+			SpindlePublishStatus(h);
+			nextTick += h->loop.period;
+
+			// when the task was blocked for more than one period, the missed cycles are skipped
+			if ( ( xTaskGetTickCount() - nextTick ) < ( portMAX_DELAY / 2 ) )
+			{
+				nextTick = xTaskGetTickCount() + h->loop.period;
+			}
 		}
-		el = LIST_NEXT(el, navigate);
 	}
-
-	xSemaphoreGiveRecursive( h->syncEventPool.lockGuard );
-	return 0;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-static void ReleaseCommandEvent( SpindleHandle_t h, SemaphoreHandle_t s )
+static int SpindleSendCommand( SpindleHandle_t h, CtrlCommand_t* cmd, int wait )
 // --------------------------------------------------------------------------------------------------------------------
 {
-	xSemaphoreTakeRecursive( h->syncEventPool.lockGuard, -1 );
+	// the reply is a direct notification of the calling task, so there is no event object to allocate.
+	// Commands without reply are fire and forget and never block the caller
+	cmd->head.requestID = h->nextRequestID;
+	h->nextRequestID += 1;
+	cmd->request.replyTask = wait ? xTaskGetCurrentTaskHandle() : NULL;
+	cmd->response->code = -1;
 
-	stepSyncEventElement_t* el = LIST_FIRST(&h->syncEventPool.pool);
-	while ( el != NULL )
+	if ( pdPASS != xQueueSend( h->cmdQueue, cmd, wait ? portMAX_DELAY : 0 ) )
 	{
-		if ( el->content.allocated == 1 && el->content.event == s)
-		{
-			el->content.allocated = 0;
-			xSemaphoreGiveRecursive( h->syncEventPool.lockGuard );
-			return;
-		}
-		el = LIST_NEXT(el, navigate);
+		return -1;
 	}
 
-	xSemaphoreGiveRecursive( h->syncEventPool.lockGuard );
+	if ( wait )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+		return cmd->response->code;
+	}
+	return 0;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -271,8 +897,6 @@ static int SpindleConsoleFunction( int argc, char** argv, void* ctx )
 	CtrlCommand_t cmd;
 
 	cmd.response       = &response;
-	cmd.head.requestID = h->nextRequestID;
-	h->nextRequestID += 1;
 
 	// first decode the subcommand and all arguments
 	if ( argc == 0 )
@@ -300,8 +924,111 @@ static int SpindleConsoleFunction( int argc, char** argv, void* ctx )
 	}
 	else if ( strcmp(argv[0], "status") == 0 )
 	{
-		// no further arguments, everything in result
-		cmd.head.type = cctSTATUS;
+		// status is read from the snapshot without a round trip to the controller task
+		int running = 0;
+		float setpoint = 0.0f;
+		float speed = 0.0f;
+		SPINDLE_GetSnapshot(h, &running, &setpoint, &speed);
+
+		// status is polled by the host, so the fixed point formatter is used instead of printf
+		CONSOLE_PrintInt(!!running);
+		printf("\r\n");
+		CONSOLE_PrintInt((long)( h->loop.closed ? speed : setpoint ));
+		printf("\r\nOK");
+		return 0;
+	}
+	else if ( strcmp(argv[0], "loop") == 0 )
+	{
+		// no arguments prints the loop state, on and off close and open it, three arguments are the new gains
+		cmd.head.type = cctLOOP;
+		cmd.request.args.asLoop.set = 0;
+		cmd.request.args.asLoop.enable = -1;
+		if ( argc == 2 && ( strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0 ) )
+		{
+			cmd.request.args.asLoop.enable = ( strcmp(argv[1], "on") == 0 );
+		}
+		else if ( argc == 4 )
+		{
+			cmd.request.args.asLoop.set = 1;
+			cmd.request.args.asLoop.kp = (float)atof(argv[1]);
+			cmd.request.args.asLoop.ki = (float)atof(argv[2]);
+			cmd.request.args.asLoop.kd = (float)atof(argv[3]);
+		}
+		else if ( argc != 1 )
+		{
+			printf("loop needs none, on, off or three arguments kp ki kd\r\nFAIL");
+			return -1;
+		}
+	}
+	else if ( strcmp(argv[0], "ramp") == 0 )
+	{
+		// no arguments prints the ramps, otherwise acceleration and optional deceleration in RPM/s
+		cmd.head.type = cctRAMP;
+		cmd.request.args.asRamp.set = 0;
+		if ( argc == 2 || argc == 3 )
+		{
+			cmd.request.args.asRamp.set = 1;
+			cmd.request.args.asRamp.accel = (float)atof(argv[1]);
+			cmd.request.args.asRamp.decel = ( argc == 3 ) ? (float)atof(argv[2]) : 0.0f;
+			if ( cmd.request.args.asRamp.accel < 0.0f || cmd.request.args.asRamp.decel < 0.0f )
+			{
+				printf("ramps must not be negative\r\nFAIL");
+				return -1;
+			}
+		}
+		else if ( argc != 1 )
+		{
+			printf("ramp needs none, one or two arguments accel decel\r\nFAIL");
+			return -1;
+		}
+	}
+	else if ( strcmp(argv[0], "css") == 0 )
+	{
+		// no arguments prints the state, off ends it, otherwise surface speed in m/min and center of the axis in mm
+		cmd.head.type = cctCSS;
+		cmd.request.args.asCss.set = 0;
+		if ( argc == 2 && strcmp(argv[1], "off") == 0 )
+		{
+			cmd.request.args.asCss.set = 1;
+			cmd.request.args.asCss.enable = 0;
+		}
+		else if ( argc == 3 )
+		{
+			cmd.request.args.asCss.set = 1;
+			cmd.request.args.asCss.enable = 1;
+			cmd.request.args.asCss.surface = (float)atof(argv[1]);
+			cmd.request.args.asCss.center = (float)atof(argv[2]);
+		}
+		else if ( argc != 1 )
+		{
+			printf("css needs none, off or two arguments surface center\r\nFAIL");
+			return -1;
+		}
+	}
+	else if ( strcmp(argv[0], "cal") == 0 )
+	{
+		// cal prints the table, the other operations are run, duty <d>, set <d> <rpm>, clear and save
+		cmd.head.type = cctCALIBRATE;
+		cmd.request.args.asCalibration.operation = ccoSHOW;
+		if ( argc == 2 && strcmp(argv[1], "run") == 0 ) cmd.request.args.asCalibration.operation = ccoRUN;
+		else if ( argc == 2 && strcmp(argv[1], "clear") == 0 ) cmd.request.args.asCalibration.operation = ccoCLEAR;
+		else if ( argc == 2 && strcmp(argv[1], "save") == 0 ) cmd.request.args.asCalibration.operation = ccoSAVE;
+		else if ( argc == 3 && strcmp(argv[1], "duty") == 0 )
+		{
+			cmd.request.args.asCalibration.operation = ccoDUTY;
+			cmd.request.args.asCalibration.duty = (float)atof(argv[2]);
+		}
+		else if ( argc == 4 && strcmp(argv[1], "set") == 0 )
+		{
+			cmd.request.args.asCalibration.operation = ccoSET;
+			cmd.request.args.asCalibration.duty = (float)atof(argv[2]);
+			cmd.request.args.asCalibration.rpm = (float)atof(argv[3]);
+		}
+		else if ( argc != 1 )
+		{
+			printf("cal needs none or one of run, clear, save, duty <d> or set <d> <rpm>\r\nFAIL");
+			return -1;
+		}
 	}
 	else
 	{
@@ -310,24 +1037,59 @@ static int SpindleConsoleFunction( int argc, char** argv, void* ctx )
 	}
 
 	// now pass the request to the controller
-	cmd.request.syncEvent = GetCommandEvent(h);
-
-	if ( pdPASS != xQueueSend( h->cmdQueue, &cmd, -1 ) )
-	{
-		ReleaseCommandEvent(h, cmd.request.syncEvent );
-		return -1;
-	}
-
-	xSemaphoreTake( cmd.request.syncEvent, -1 );
-	ReleaseCommandEvent(h, cmd.request.syncEvent );
+	SpindleSendCommand(h, &cmd, 1);
 
 	// now decode the result in case there is one
 	if ( response.code == 0 )
 	{
-		if ( cmd.head.type == cctSTATUS )
+		if ( cmd.head.type == cctLOOP )
 		{
-			printf("%d\r\n", !!cmd.response->args.asStatus.running);
-			printf("%d\r\n", (int)cmd.response->args.asStatus.speed);
+			printf("%s\r\nkp ", cmd.response->args.asLoop.closed ? "on" : "off");
+			CONSOLE_PrintFloat(cmd.response->args.asLoop.kp, 6);
+			printf("\r\nki ");
+			CONSOLE_PrintFloat(cmd.response->args.asLoop.ki, 6);
+			printf("\r\nkd ");
+			CONSOLE_PrintFloat(cmd.response->args.asLoop.kd, 6);
+			printf("\r\nmeasured ");
+			CONSOLE_PrintInt((long)cmd.response->args.asLoop.measured);
+			printf("\r\nduty ");
+			CONSOLE_PrintFloat(cmd.response->args.asLoop.duty, 3);
+			printf("\r\nsettle ");
+			CONSOLE_PrintInt(cmd.response->args.asLoop.settleMs);
+			printf("\r\n");
+		}
+		else if ( cmd.head.type == cctCALIBRATE )
+		{
+			// one line per point, duty and RPM
+			const SpindleCalibration_t* c = &cmd.response->args.asCalibration;
+			printf("%s\r\n", ( c->magic == SPINDLE_CAL_MAGIC ) ? "calibrated" : "linear");
+			for ( unsigned int i = 0; i < c->count; i++ )
+			{
+				CONSOLE_PrintFloat(c->duty[i], 3);
+				printf(" ");
+				CONSOLE_PrintInt((long)c->rpm[i]);
+				printf("\r\n");
+			}
+		}
+		else if ( cmd.head.type == cctCSS )
+		{
+			printf("%s\r\nsurface ", cmd.response->args.asCss.active ? "on" : "off");
+			CONSOLE_PrintFloat(cmd.response->args.asCss.surface, 1);
+			printf("\r\ncenter ");
+			CONSOLE_PrintFloat(cmd.response->args.asCss.center, 3);
+			printf("\r\nradius ");
+			CONSOLE_PrintFloat(cmd.response->args.asCss.radius, 3);
+			printf("\r\nrpm ");
+			CONSOLE_PrintInt((long)cmd.response->args.asCss.speed);
+			printf("\r\n");
+		}
+		else if ( cmd.head.type == cctRAMP )
+		{
+			printf("accel ");
+			CONSOLE_PrintInt((long)cmd.response->args.asRamp.accel);
+			printf("\r\ndecel ");
+			CONSOLE_PrintInt((long)cmd.response->args.asRamp.decel);
+			printf("\r\n");
 		}
 		printf("OK");
 	}
@@ -344,7 +1106,7 @@ static int SpindleConsoleFunction( int argc, char** argv, void* ctx )
 static void SpindleRegisterBasicCommands( SpindleHandle_t h, ConsoleHandle_t cH )
 // --------------------------------------------------------------------------------------------------------------------
 {
-	CONSOLE_RegisterCommand(cH, "spindle", "<<spindle>> is used to control a spindle motor.\r\nValid subcommands are start, stop, status.\r\nStart needs an additional RPM argument!",
+	CONSOLE_RegisterCommand(cH, "spindle", "<<spindle>> is used to control a spindle motor.\r\nValid subcommands are start, stop, status, loop, ramp, css and cal.\r\nStart needs an additional RPM argument!\r\nLoop prints the RPM loop, closes it with on, opens it with off or sets its gains with kp ki kd.\r\nRamp prints the ramps or sets them with accel [decel] in RPM/s.\r\nCss runs with constant surface speed, see css <m/min> <center mm> and css off.\r\nCal prints or records the RPM to duty table, see cal run, duty, set, clear and save.",
 			SpindleConsoleFunction, h);
 }
 
@@ -360,39 +1122,52 @@ SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, Co
 	     p->minRPM >= p->maxRPM || p->setDutyCycle == NULL || cH == NULL )
 		return NULL;
 
+#if SPINDLE_STATIC_ALLOCATION != 0
+	if ( uxStackDepth > SPINDLE_STATIC_STACK_DEPTH ) return NULL;
+
+	struct SpindleHandle* h = &SpindleStaticHandle;
+	memset(h, 0, sizeof(struct SpindleHandle));
+#else
 	struct SpindleHandle* h = calloc(sizeof(struct SpindleHandle), 1);
 	ON_NULL_GOTO_ERROR(h);
+#endif
 
 	if ( h == NULL ) return NULL;
 	h->consoleH = cH;
 	h->cancel = 0;
 	h->nextRequestID = 0;
-	h->cmdQueue = xQueueCreate(16, sizeof(CtrlCommand_t));
+#if SPINDLE_STATIC_ALLOCATION != 0
+	h->cmdQueue = xQueueCreateStatic(SPINDLE_QUEUE_LENGTH, sizeof(CtrlCommand_t), SpindleStaticQueueStorage, &SpindleStaticQueue);
+#else
+	h->cmdQueue = xQueueCreate(SPINDLE_QUEUE_LENGTH, sizeof(CtrlCommand_t));
+#endif
 	ON_NULL_GOTO_ERROR(h->cmdQueue);
 
 	// copy arguments
 	memcpy(&h->physical, p, sizeof(SpindlePhysicalParams_t));
 
-	// now we create the sync event pool
-	LIST_INIT(&h->syncEventPool.pool);
-	h->syncEventPool.lockGuard = xSemaphoreCreateRecursiveMutex();
-	ON_NULL_GOTO_ERROR(h->syncEventPool.lockGuard);
-	for ( int i = 0; i < 8; i++)
-	{
-		stepSyncEventElement_t* el = (stepSyncEventElement_t*)calloc(sizeof(stepSyncEventElement_t), 1);
-		ON_NULL_GOTO_ERROR(el);
-		el->content.allocated = 0;
-		el->content.event = xSemaphoreCreateBinary();
-		if (el->content.event == NULL)
-		{
-			free(el);
-			el = NULL;
-			goto error;
-		}
-		else
-		{
-			LIST_INSERT_HEAD(&h->syncEventPool.pool, el, navigate);
-		}
+	// the RPM loop needs a measurement and starts open. A missing or broken sensor reads 0 RPM, then a closed
+	// loop would wind the duty cycle up to 100%, so it is only closed on request with spindle loop on
+	if ( h->physical.controlPeriodMs == 0 ) h->physical.controlPeriodMs = SPINDLE_DEFAULT_CONTROL_PERIOD_MS;
+	if ( h->physical.settleBand <= 0.0f ) h->physical.settleBand = SPINDLE_DEFAULT_SETTLE_BAND;
+	h->loop.available = ( h->physical.getMeasuredRPM != NULL );
+	h->loop.closed = 0;
+	h->loop.period = pdMS_TO_TICKS(h->physical.controlPeriodMs);
+	if ( h->loop.period == 0 ) h->loop.period = 1;
+	h->loop.kp = h->physical.kp;
+	h->loop.ki = h->physical.ki;
+	h->loop.kd = h->physical.kd;
+	h->loop.settleMs = -1;
+
+	// ramps of zero are disabled, the deceleration defaults to the acceleration
+	h->ramp.accel = ( h->physical.accelRPMs > 0.0f ) ? h->physical.accelRPMs : 0.0f;
+	h->ramp.decel = ( h->physical.decelRPMs > 0.0f ) ? h->physical.decelRPMs : h->ramp.accel;
+
+	// a stored table is only used when it is intact, otherwise the duty cycle stays linear
+	if ( h->physical.loadCalibration != NULL &&
+	     ( h->physical.loadCalibration(h, h->physical.context, &h->calibration) != 0 || !SpindleCalibrationValid(&h->calibration) ) )
+	{
+		memset(&h->calibration, 0, sizeof(h->calibration));
 	}
 
 	// setup the console commands
@@ -400,7 +1175,11 @@ SpindleHandle_t SPINDLE_CreateInstance( unsigned int uxStackDepth, int xPrio, Co
 	SpindleInstancePointer = h;
 
 	// setup the task which handles all communications and the RPM generation
+#if SPINDLE_STATIC_ALLOCATION != 0
+	h->tHandle = xTaskCreateStatic(SpindleFunction, "spindlectrl", uxStackDepth, h, xPrio, SpindleStaticStack, &SpindleStaticTask);
+#else
 	xTaskCreate(SpindleFunction, "spindlectrl", uxStackDepth, h, xPrio, &h->tHandle);
+#endif
 	ON_NULL_GOTO_ERROR(h->tHandle);
 	return h;
 
@@ -413,37 +1192,85 @@ error:
 			h->cmdQueue = NULL;
 		}
 
-		if (h->syncEventPool.lockGuard != NULL)
-		{
-			vSemaphoreDelete(h->syncEventPool.lockGuard);
-			h->syncEventPool.lockGuard = NULL;
-		}
-
-		// first clean all event elements
-		stepSyncEventElement_t* el = NULL;
-		stepSyncEventElement_t* tel = NULL;
-		for (el = LIST_FIRST(&h->syncEventPool.pool); el && (tel = LIST_NEXT(el, navigate), 1); el = tel)
-		{
-			if (el->content.event != NULL)
-			{
-				vSemaphoreDelete(el->content.event);
-				el->content.event = NULL;
-			}
-		}
-
-		// now remove all elements one by one from the list and free them
-		while (!LIST_EMPTY(&h->syncEventPool.pool))
-		{
-			stepSyncEventElement_t* el = LIST_FIRST(&h->syncEventPool.pool);
-			if (el != NULL)
-			{
-				LIST_REMOVE(el, navigate);
-				free(el);
-			}
-		}
-
+#if SPINDLE_STATIC_ALLOCATION == 0
 		free(h);
+#endif
 	}
 
 	return NULL;
 }
+
+// --------------------------------------------------------------------------------------------------------------------
+int SPINDLE_GetSnapshot( SpindleHandle_t h, int* running, float* setpoint, float* speed )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( h == NULL ) return -1;
+
+	int r;
+	float sp;
+	float sv;
+	unsigned int sequence;
+
+	// the controller task is the only writer, so a consistent copy is read without any lock
+	do
+	{
+		sequence = h->snapshot.sequence;
+		r  = h->snapshot.running;
+		sp = h->snapshot.setpoint;
+		sv = h->snapshot.speed;
+	} while ( ( sequence & 1U ) || sequence != h->snapshot.sequence );
+
+	if ( running != NULL ) *running = r;
+	if ( setpoint != NULL ) *setpoint = sp;
+	if ( speed != NULL ) *speed = sv;
+	return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SPINDLE_GetStatus( SpindleHandle_t h, int* running, float* speed )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	return SPINDLE_GetSnapshot(h, running, NULL, speed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SPINDLE_Start( SpindleHandle_t h, float rpm, int wait )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( h == NULL ) return -1;
+
+	StepCommandResponse_t response = { 0 };
+	CtrlCommand_t cmd;
+	cmd.response = &response;
+	cmd.head.type = cctSTART;
+	cmd.request.args.asStart.speed = rpm;
+	return SpindleSendCommand(h, &cmd, wait);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SPINDLE_Stop( SpindleHandle_t h, int wait )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( h == NULL ) return -1;
+
+	StepCommandResponse_t response = { 0 };
+	CtrlCommand_t cmd;
+	cmd.response = &response;
+	cmd.head.type = cctSTOP;
+	return SpindleSendCommand(h, &cmd, wait);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SPINDLE_StopFromISR( SpindleHandle_t h, BaseType_t* pxHigherPriorityTaskWoken )
+// --------------------------------------------------------------------------------------------------------------------
+{
+	if ( h == NULL ) return -1;
+
+	// the response of an asynchronous command is never read, so the controller uses its own
+	CtrlCommand_t cmd;
+	cmd.response = NULL;
+	cmd.head.requestID = 0;
+	cmd.head.type = cctSTOP;
+	cmd.request.replyTask = NULL;
+	return ( pdPASS == xQueueSendFromISR( h->cmdQueue, &cmd, pxHigherPriorityTaskWoken ) ) ? 0 : -1;
+}
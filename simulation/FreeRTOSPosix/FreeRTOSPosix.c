@@ -0,0 +1,694 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+#include "stm32f7xx_hal.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stream_buffer.h"
+#include "init.h"
+#include "mempool.h"
+#include "perf.h"
+#include "SessionFormat.h"
+
+// termios defines CR1 and CR2, so it is included after the register definitions of the HAL mock
+#include <termios.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+#define CONSOLE_RX_BUFFER_SIZE 256
+#define CONSOLE_RX_POLL_MS     10
+#define SESSION_LINE_SIZE      4096
+
+// --------------------------------------------------------------------------------------------------------------------
+SPI_HandleTypeDef hspi1 = { .Instance = SPI1, .ErrorCode = 0, .Lock = HAL_UNLOCKED, .hdmarx = 0, .hdmatx = 0 };
+TIM_HandleTypeDef htim1 = { .Instance = TIM1, .hdma = { 0 }, .Lock = HAL_UNLOCKED, .Channel = 0 };
+TIM_HandleTypeDef htim2 = { .Instance = TIM2, .hdma = { 0 }, .Lock = HAL_UNLOCKED, .Channel = 0 };
+TIM_HandleTypeDef htim4 = { .Instance = TIM4, .hdma = { 0 }, .Lock = HAL_UNLOCKED, .Channel = 0 };
+
+// --------------------------------------------------------------------------------------------------------------------
+#define PLANT_PARAMETER(name) { #name, offsetof(HAL_MOCK_Plant_t, name) }
+
+static const struct
+{
+    const char* name;
+    size_t offset;
+} plantParameters[] =
+{
+    PLANT_PARAMETER(holdingTorque),
+    PLANT_PARAMETER(ratedCurrent),
+    PLANT_PARAMETER(cornerRate),
+    PLANT_PARAMETER(rotorInertia),
+    PLANT_PARAMETER(loadMass),
+    PLANT_PARAMETER(leadMm),
+    PLANT_PARAMETER(loadForce),
+    PLANT_PARAMETER(frictionTorque),
+    PLANT_PARAMETER(damping),
+    PLANT_PARAMETER(currentRipple),
+    PLANT_PARAMETER(switchResistance),
+    PLANT_PARAMETER(thermalResistance),
+    PLANT_PARAMETER(thermalTimeConstant),
+    PLANT_PARAMETER(ambient),
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+static int consoleRxFd = -1;
+static int consoleTxFd = -1;
+static int virtualTime = 0;
+static uint64_t timeLimitNs = 0;
+static const char* exitReason = "reset";
+static FILE* report = NULL;
+static FILE* consoleLog = NULL;
+static StreamBufferHandle_t consoleRx = NULL;
+
+// recorded console input, every record is delivered once its time has come
+static struct
+{
+    uint64_t* timeNs;
+    char** data;
+    size_t* len;
+    size_t count;
+    size_t next;
+    size_t offset;
+} session;
+
+// --------------------------------------------------------------------------------------------------------------------
+void* pvPortMalloc(size_t xSize)
+// --------------------------------------------------------------------------------------------------------------------
+{
+#if MEMPOOL_FOR_KERNEL
+    void* p = mempool_alloc(xSize);
+#else
+    void* p = malloc(xSize);
+#endif
+    return p;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void vPortFree(void* pv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+#if MEMPOOL_FOR_KERNEL
+    mempool_free(pv);
+#else
+    free(pv);
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t xPortGetFreeHeapSize(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return 0xFFFFFFFF;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+size_t xPortGetMinimumEverFreeHeapSize(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return 0xFFFFFFFF;
+}
+
+//! No implementation needed, but stub provided in case application already calls vPortInitialiseBlocks
+// --------------------------------------------------------------------------------------------------------------------
+void vPortInitialiseBlocks(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void vAssertCalled(const char* const pcFileName, unsigned long ulLine)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // there is no debugger attached to step out of the assertion, the core dump is more useful than a hanging process
+    fprintf(stderr, "assertion failed in %s:%lu\n", pcFileName, ulLine);
+    abort();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void vApplicationMallocFailedHook(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fprintf(stderr, "out of memory\n");
+    abort();
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void vApplicationIdleHook(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (virtualTime)
+    {
+        // nothing runs, so the virtual time jumps to the next event of the HAL mock
+        HAL_MOCK_RunNextEvent();
+    }
+    else
+    {
+        // the WFI of the target, otherwise the idle task would spin a host core
+        vPortWaitForInterrupt();
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void SysTick_Handler(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    PERF_ENTER();
+
+    // the tick of the HAL runs from the start, the kernel only gets it once the scheduler has started
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        xPortSysTickHandler();
+    }
+
+    // the wraps of the cycle counter are only seen when it is read at least once per wrap
+    (void)getRunTimeCounterValue();
+    PERF_EXIT(PERF_SYSTICK);
+
+    // a scenario which never finishes, e.g. a reference run of a stalled motor, must not block a batch run
+    if (timeLimitNs != 0 && HAL_MOCK_GetTimeNs() >= timeLimitNs)
+    {
+        exitReason = "time-limit";
+        exit(3);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void LogConsole(char direction, const char* data, size_t len)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (consoleLog == NULL) return;
+
+    // the counters let the replay harness attribute the motion and the driver traffic to the commands
+    fprintf(consoleLog, "%c %llu %llu %llu %llu ", direction, (unsigned long long)HAL_MOCK_GetTimeNs(),
+        (unsigned long long)HAL_MOCK_GetStepEdges(), (unsigned long long)HAL_MOCK_GetLastStepEdgeNs(),
+        (unsigned long long)HAL_MOCK_GetSpiTransfers());
+    SessionWriteBytes(consoleLog, data, len);
+    fputc('\n', consoleLog);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int LoadSession(const char* path)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char line[SESSION_LINE_SIZE];
+    char bytes[SESSION_LINE_SIZE];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        lineNo += 1;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        // "<ms> <quoted bytes>", the time is relative to the start of the recording
+        char* text;
+        unsigned long long ms = strtoull(line, &text, 10);
+        size_t len;
+        while (*text == ' ') text++;
+        if (text == line || SessionParseBytes(text, bytes, sizeof(bytes), &len) == NULL)
+        {
+            fprintf(stderr, "%s:%d: invalid record\n", path, lineNo);
+            fclose(f);
+            return -1;
+        }
+
+        size_t n = session.count + 1;
+        session.timeNs = realloc(session.timeNs, n * sizeof(*session.timeNs));
+        session.data = realloc(session.data, n * sizeof(*session.data));
+        session.len = realloc(session.len, n * sizeof(*session.len));
+        char* copy = malloc(len + 1);
+        if (session.timeNs == NULL || session.data == NULL || session.len == NULL || copy == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            fclose(f);
+            return -1;
+        }
+        memcpy(copy, bytes, len);
+        session.timeNs[session.count] = (uint64_t)ms * 1000000ULL;
+        session.data[session.count] = copy;
+        session.len[session.count] = len;
+        session.count = n;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static ssize_t ReadSession(char* buf, size_t size)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (session.next == session.count)
+    {
+        // the commands before have completed, so the end of the session ends the simulation
+        exitReason = "eof";
+        exit(0);
+    }
+
+    // a record which is due while a command runs waits in the buffer of the UART like on the target
+    if (session.timeNs[session.next] > HAL_MOCK_GetTimeNs()) return 0;
+
+    size_t len = session.len[session.next] - session.offset;
+    if (len > size) len = size;
+    memcpy(buf, session.data[session.next] + session.offset, len);
+    session.offset += len;
+    if (session.offset == session.len[session.next])
+    {
+        session.next += 1;
+        session.offset = 0;
+    }
+    return (ssize_t)len;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static ssize_t ConsoleRead(void* cookie, char* buf, size_t size)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)cookie;
+
+    // the console polls getchar() until it returns a character, so a timeout is reported as EOF. glibc does not keep
+    // the error flag of a stream sticky, the next getchar() reads again
+    size_t received = 0;
+    if (session.timeNs != NULL)
+    {
+        ssize_t len = ReadSession(buf, size);
+        if (len > 0)
+        {
+            LogConsole('I', buf, (size_t)len);
+            return len;
+        }
+        if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+        {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+    }
+    else if (virtualTime)
+    {
+        // the input is consumed as soon as the console asks for it, so a script takes the same virtual time on
+        // every run. Waiting for input lets the virtual time run on, a closed pipe only reports POLLHUP
+        struct pollfd pfd = { .fd = consoleRxFd, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLIN | POLLHUP)) != 0)
+        {
+            ssize_t len = read(consoleRxFd, buf, size);
+            if (len > 0)
+            {
+                LogConsole('I', buf, (size_t)len);
+                return len;
+            }
+
+            // the commands before have completed, so the end of a script ends the simulation like a reset
+            if (len == 0)
+            {
+                exitReason = "eof";
+                exit(0);
+            }
+        }
+        if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+        {
+            vTaskDelay(pdMS_TO_TICKS(CONSOLE_RX_POLL_MS));
+        }
+    }
+    else if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+    {
+        received = xStreamBufferReceive(consoleRx, buf, size, pdMS_TO_TICKS(CONSOLE_RX_POLL_MS));
+    }
+    if (received == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (ssize_t)received;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static ssize_t ConsoleWrite(void* cookie, const char* buf, size_t size)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)cookie;
+
+    LogConsole('O', buf, size);
+
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t res = write(consoleTxFd, buf + written, size - written);
+        if (res > 0)
+        {
+            written += (size_t)res;
+        }
+        else if (res < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            // nobody reads the pseudo terminal, the output is dropped like on an unconnected UART
+            break;
+        }
+    }
+    return (ssize_t)size;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void* ConsoleRxThread(void* arg)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    (void)arg;
+    char buf[64];
+
+    while (1)
+    {
+        struct pollfd pfd = { .fd = consoleRxFd, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, -1) < 0) continue;
+
+        ssize_t len = read(consoleRxFd, buf, sizeof(buf));
+        if (len == 0)
+        {
+            // end of the input stream, the simulation keeps running until it is reset by the console
+            break;
+        }
+        if (len < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000000L };
+                nanosleep(&ts, NULL);
+            }
+            continue;
+        }
+
+        // this thread is the UART RX interrupt of the simulated core
+        ssize_t sent = 0;
+        while (sent < len)
+        {
+            BaseType_t woken = pdFALSE;
+            __disable_irq();
+            sent += (ssize_t)xStreamBufferSendFromISR(consoleRx, buf + sent, (size_t)(len - sent), &woken);
+            portYIELD_FROM_ISR(woken);
+            __enable_irq();
+
+            if (sent < len)
+            {
+                struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000L };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    return NULL;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int OpenConsole(int useStdio)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (useStdio)
+    {
+        consoleRxFd = STDIN_FILENO;
+        consoleTxFd = STDOUT_FILENO;
+    }
+    else
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+        {
+            perror("posix_openpt");
+            return -1;
+        }
+
+        const char* name = ptsname(master);
+        if (name == NULL)
+        {
+            perror("ptsname");
+            return -1;
+        }
+
+        // the slave is kept open, otherwise the master reports EIO between two sessions of a terminal program
+        int slave = open(name, O_RDWR | O_NOCTTY);
+        if (slave < 0)
+        {
+            perror(name);
+            return -1;
+        }
+
+        struct termios tio;
+        if (tcgetattr(slave, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            tcsetattr(slave, TCSANOW, &tio);
+        }
+
+        // the output must not block the simulated core while no terminal program is connected
+        fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+        consoleRxFd = master;
+        consoleTxFd = master;
+        fprintf(stderr, "console on %s\n", name);
+    }
+
+#if configSUPPORT_STATIC_ALLOCATION
+    static StaticStreamBuffer_t consoleRxBuffer;
+    static uint8_t consoleRxStorage[CONSOLE_RX_BUFFER_SIZE + 1];
+    consoleRx = xStreamBufferCreateStatic(CONSOLE_RX_BUFFER_SIZE, 1, consoleRxStorage, &consoleRxBuffer);
+#else
+    consoleRx = xStreamBufferCreate(CONSOLE_RX_BUFFER_SIZE, 1);
+#endif
+    if (consoleRx == NULL) return -1;
+
+    cookie_io_functions_t rdFuncs = { .read = ConsoleRead, .write = NULL, .seek = NULL, .close = NULL };
+    cookie_io_functions_t wrFuncs = { .read = NULL, .write = ConsoleWrite, .seek = NULL, .close = NULL };
+    FILE* in = fopencookie(NULL, "r", rdFuncs);
+    FILE* out = fopencookie(NULL, "w", wrFuncs);
+    if (in == NULL || out == NULL) return -1;
+
+    setvbuf(in, NULL, _IONBF, 0);
+    setvbuf(out, NULL, _IONBF, 0);
+    stdin = in;
+    stdout = out;
+
+    // in virtual time the console reads the input itself, an interrupt thread would make the timing depend on the host
+    if (!virtualTime)
+    {
+        pthread_t rxThread;
+        if (pthread_create(&rxThread, NULL, ConsoleRxThread, NULL) != 0) return -1;
+        pthread_detach(rxThread);
+    }
+
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int SetPlantParameter(HAL_MOCK_Plant_t* plant, const char* assignment)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    const char* value = strchr(assignment, '=');
+    if (value == NULL) return -1;
+
+    for (size_t i = 0; i < sizeof(plantParameters) / sizeof(plantParameters[0]); i++)
+    {
+        if (strlen(plantParameters[i].name) == (size_t)(value - assignment) &&
+            strncmp(plantParameters[i].name, assignment, (size_t)(value - assignment)) == 0)
+        {
+            char* end;
+            float f = strtof(value + 1, &end);
+            if (end == value + 1 || *end != '\0') return -1;
+            *(float*)((char*)plant + plantParameters[i].offset) = f;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void ReportOnExit(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    HAL_MOCK_PlantStats_t stats;
+    int hasPlant = (HAL_MOCK_GetPlantStats(&stats) == 0);
+
+    // one "key=value" per line, read by the batch runner
+    if (report != NULL)
+    {
+        fprintf(report, "exit=%s\n", exitReason);
+        fprintf(report, "virtual_ns=%llu\n", (unsigned long long)HAL_MOCK_GetTimeNs());
+        fprintf(report, "step_edges=%llu\n", (unsigned long long)HAL_MOCK_GetStepEdges());
+        fprintf(report, "abs_pos=%ld\n", (long)HAL_MOCK_GetDriverPosition());
+        if (hasPlant)
+        {
+            fprintf(report, "commanded=%lld\n", (long long)stats.commanded);
+            fprintf(report, "rotor=%lld\n", (long long)stats.rotor);
+            fprintf(report, "slips=%u\n", (unsigned int)stats.slips);
+            fprintf(report, "missed_steps=%u\n", (unsigned int)stats.missedSteps);
+            fprintf(report, "max_lag=%.3f\n", (double)stats.maxLag);
+            fprintf(report, "max_junction=%.1f\n", (double)stats.maxJunction);
+            fprintf(report, "ocd=%u\n", (unsigned int)stats.ocdEvents);
+            fprintf(report, "th_warn=%u\n", (unsigned int)stats.thWarnEvents);
+            fprintf(report, "th_sd=%u\n", (unsigned int)stats.thSdEvents);
+        }
+        fclose(report);
+        report = NULL;
+    }
+
+    if (consoleLog != NULL)
+    {
+        fclose(consoleLog);
+        consoleLog = NULL;
+    }
+
+    if (!hasPlant) return;
+
+    // the console is closed by the reset, so the report goes to stderr like the other messages of the simulator
+    fprintf(stderr, "plant: time %.3f s, commanded %lld, rotor %lld, slips %u, missed steps %u, max lag %.2f full steps\n",
+        (double)HAL_MOCK_GetTimeNs() / 1e9, (long long)stats.commanded, (long long)stats.rotor, (unsigned int)stats.slips,
+        (unsigned int)stats.missedSteps, (double)stats.maxLag);
+    fprintf(stderr, "plant: junction %.1f C, max %.1f C, OCD %u, TH_WARN %u, TH_SD %u\n",
+        (double)stats.junction, (double)stats.maxJunction, (unsigned int)stats.ocdEvents,
+        (unsigned int)stats.thWarnEvents, (unsigned int)stats.thSdEvents);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main( int argc, char** argv )
+// --------------------------------------------------------------------------------------------------------------------
+{
+    int useStdio = 0;
+    int usePlant = 0;
+    FILE* stepTrace = NULL;
+    HAL_MOCK_Plant_t plant;
+    HAL_MOCK_GetDefaultPlant(&plant);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stdio") == 0)
+        {
+            useStdio = 1;
+        }
+        else if (strcmp(argv[i], "--virtual") == 0)
+        {
+            virtualTime = 1;
+        }
+        else if (strcmp(argv[i], "--step-trace") == 0 && i + 1 < argc)
+        {
+            stepTrace = fopen(argv[++i], "w");
+            if (stepTrace == NULL)
+            {
+                perror(argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+        {
+            report = fopen(argv[++i], "w");
+            if (report == NULL)
+            {
+                perror(argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc)
+        {
+            if (LoadSession(argv[++i]) != 0) return -1;
+            if (session.count == 0)
+            {
+                fprintf(stderr, "%s has no records\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--console-log") == 0 && i + 1 < argc)
+        {
+            consoleLog = fopen(argv[++i], "w");
+            if (consoleLog == NULL)
+            {
+                perror(argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc)
+        {
+            char* end;
+            double seconds = strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || seconds <= 0.0)
+            {
+                fprintf(stderr, "invalid time limit %s\n", argv[i]);
+                return -1;
+            }
+            timeLimitNs = (uint64_t)(seconds * 1e9);
+        }
+        else if (strcmp(argv[i], "--plant") == 0)
+        {
+            usePlant = 1;
+        }
+        else if (strcmp(argv[i], "--plant-param") == 0 && i + 1 < argc)
+        {
+            usePlant = 1;
+            if (SetPlantParameter(&plant, argv[++i]) != 0)
+            {
+                fprintf(stderr, "invalid plant parameter %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--stdio] [--virtual] [--step-trace file] [--plant] [--plant-param name=value]\n"
+                "       [--report file] [--time-limit seconds] [--session file] [--console-log file]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    if (stepTrace != NULL && !virtualTime)
+    {
+        fprintf(stderr, "the step trace needs --virtual\n");
+        return -1;
+    }
+
+    if ((usePlant || report != NULL || timeLimitNs != 0 || session.count != 0 || consoleLog != NULL) && !virtualTime)
+    {
+        fprintf(stderr, "the plant model, the report, the time limit, the session and the console log need --virtual\n");
+        return -1;
+    }
+
+    if (virtualTime)
+    {
+        // one clock drives the tick and the timers of the mock, the simulation runs as fast as the host allows
+        vPortUseExternalTick();
+        HAL_MOCK_StartVirtualTime(SysTick_Handler);
+        HAL_MOCK_SetStepTrace(stepTrace);
+
+        // the step edges drive the rotor, the counters are reported when the simulation ends
+        if (usePlant && HAL_MOCK_SetPlant(&plant) != 0)
+        {
+            fprintf(stderr, "the plant parameters are invalid\n");
+            return -1;
+        }
+        atexit(ReportOnExit);
+    }
+
+    // a closed pipe must not kill the simulation, the output is dropped instead
+    signal(SIGPIPE, SIG_IGN);
+
+    if (OpenConsole(useStdio) != 0)
+    {
+        fprintf(stderr, "the console could not be opened\n");
+        return -1;
+    }
+
+    init(htim2, &hspi1, &htim1, &htim4);
+    vTaskStartScheduler();
+
+    return -1;
+}
@@ -0,0 +1,71 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+#include <ctype.h>
+#include <stdlib.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+#include "SessionFormat.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+void SessionWriteBytes(FILE* f, const char* data, size_t len)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fputc('"', f);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)data[i];
+        switch (c)
+        {
+        case '\r': fputs("\\r", f); break;
+        case '\n': fputs("\\n", f); break;
+        case '\t': fputs("\\t", f); break;
+        case '\\': fputs("\\\\", f); break;
+        case '"':  fputs("\\\"", f); break;
+        default:
+            if (c >= 0x20 && c < 0x7F) fputc(c, f);
+            else fprintf(f, "\\x%02X", c);
+            break;
+        }
+    }
+    fputc('"', f);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+const char* SessionParseBytes(const char* text, char* out, size_t size, size_t* len)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    size_t n = 0;
+    if (*text++ != '"') return NULL;
+
+    while (*text != '"')
+    {
+        char c = *text++;
+        if (c == '\0' || n == size) return NULL;
+        if (c == '\\')
+        {
+            c = *text++;
+            switch (c)
+            {
+            case 'r': c = '\r'; break;
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case '\\': break;
+            case '"': break;
+            case 'x':
+                if (!isxdigit((unsigned char)text[0]) || !isxdigit((unsigned char)text[1])) return NULL;
+                {
+                    char hex[3] = { text[0], text[1], '\0' };
+                    c = (char)strtol(hex, NULL, 16);
+                }
+                text += 2;
+                break;
+            default:
+                return NULL;
+            }
+        }
+        out[n++] = c;
+    }
+
+    *len = n;
+    return text + 1;
+}
@@ -0,0 +1,567 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+// Batch runner of the Linux simulator: every scenario runs in its own FreeRTOSPosix process in virtual time, so the
+// scenarios are isolated from each other and as many run in parallel as the host has cores. The results are
+// aggregated into one CSV report.
+//
+// The scenario list has one scenario per line, "#" starts a comment:
+//
+//   <name> <script> [VAR=value ...] [-- simulator options ...]
+//
+// The script holds the console commands, the end of the script ends the simulation. "$(VAR)" is replaced in the
+// script, the name and the simulator options. A value "{a,b,c}" expands the line into one scenario per value, the
+// lists of several variables are combined, which gives parameter sweeps:
+//
+//   move_$(SPEED)_$(TVAL)  move.txt  SPEED={5000,10000,20000} TVAL={20,40}  -- --plant
+//
+// A relative script path is relative to the directory of the scenario list.
+// --------------------------------------------------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+#define MAX_TOKENS     64
+#define MAX_VARIABLES  16
+#define MAX_VALUES     64
+#define MAX_TEXT       4096
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+    char name[256];
+    char script[1024];
+    char* options[MAX_TOKENS];
+    int numOptions;
+    char variables[MAX_VARIABLES][2][256];
+    int numVariables;
+} Scenario_t;
+
+typedef struct
+{
+    pid_t pid;
+    struct timespec started;
+    int timedOut;
+} Job_t;
+
+typedef struct
+{
+    const char* result;
+    int exitCode;
+    int fails;
+    double wallMs;
+    char report[1024];
+} Result_t;
+
+// --------------------------------------------------------------------------------------------------------------------
+static Scenario_t* scenarios = NULL;
+static int numScenarios = 0;
+static int capScenarios = 0;
+
+// --------------------------------------------------------------------------------------------------------------------
+static double ElapsedMs(const struct timespec* from)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - from->tv_sec) * 1000.0 + (double)(now.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Substitute(char* out, size_t size, const char* in, const Scenario_t* sc)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    size_t n = 0;
+    while (*in != '\0' && n + 1 < size)
+    {
+        const char* end;
+        if (in[0] == '$' && in[1] == '(' && (end = strchr(in + 2, ')')) != NULL)
+        {
+            int found = 0;
+            for (int i = 0; i < sc->numVariables; i++)
+            {
+                if (strlen(sc->variables[i][0]) == (size_t)(end - in - 2) &&
+                    strncmp(sc->variables[i][0], in + 2, (size_t)(end - in - 2)) == 0)
+                {
+                    n += (size_t)snprintf(out + n, size - n, "%s", sc->variables[i][1]);
+                    if (n >= size) n = size - 1;
+                    found = 1;
+                    break;
+                }
+            }
+            if (found)
+            {
+                in = end + 1;
+                continue;
+            }
+        }
+        out[n++] = *in++;
+    }
+    out[n] = '\0';
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int AddScenario(char* tokens[], int numTokens, int firstOption, char* names[], char* values[][MAX_VALUES],
+    int counts[], int numVariables, const char* baseDir)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // odometer over the value lists of all variables
+    int index[MAX_VARIABLES] = { 0 };
+    while (1)
+    {
+        if (numScenarios == capScenarios)
+        {
+            capScenarios = (capScenarios == 0) ? 64 : capScenarios * 2;
+            Scenario_t* grown = realloc(scenarios, (size_t)capScenarios * sizeof(Scenario_t));
+            if (grown == NULL) return -1;
+            scenarios = grown;
+        }
+
+        Scenario_t* sc = &scenarios[numScenarios];
+        memset(sc, 0, sizeof(*sc));
+        sc->numVariables = numVariables;
+        for (int i = 0; i < numVariables; i++)
+        {
+            snprintf(sc->variables[i][0], sizeof(sc->variables[i][0]), "%s", names[i]);
+            snprintf(sc->variables[i][1], sizeof(sc->variables[i][1]), "%s", values[i][index[i]]);
+        }
+
+        Substitute(sc->name, sizeof(sc->name), tokens[0], sc);
+        char script[1024];
+        Substitute(script, sizeof(script), tokens[1], sc);
+        int length = (script[0] == '/') ? snprintf(sc->script, sizeof(sc->script), "%s", script)
+                                        : snprintf(sc->script, sizeof(sc->script), "%s/%s", baseDir, script);
+        if (length < 0 || (size_t)length >= sizeof(sc->script))
+        {
+            fprintf(stderr, "script path too long: %s\n", script);
+            return -2;
+        }
+
+        for (int i = firstOption; i < numTokens && sc->numOptions < MAX_TOKENS; i++)
+        {
+            char option[1024];
+            Substitute(option, sizeof(option), tokens[i], sc);
+            sc->options[sc->numOptions++] = strdup(option);
+        }
+
+        // the name is a file name in the output directory
+        for (char* c = sc->name; *c != '\0'; c++)
+        {
+            if (*c == '/' || *c == ' ') *c = '_';
+        }
+        numScenarios += 1;
+
+        int v = numVariables - 1;
+        while (v >= 0 && ++index[v] == counts[v])
+        {
+            index[v] = 0;
+            v -= 1;
+        }
+        if (v < 0) return 0;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int LoadScenarios(const char* path)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char dirBuf[1024];
+    snprintf(dirBuf, sizeof(dirBuf), "%s", path);
+    const char* baseDir = dirname(dirBuf);
+
+    char line[MAX_TEXT];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        lineNo += 1;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char* tokens[MAX_TOKENS];
+        int numTokens = 0;
+        for (char* t = strtok(line, " \t\r\n"); t != NULL && numTokens < MAX_TOKENS; t = strtok(NULL, " \t\r\n"))
+        {
+            tokens[numTokens++] = t;
+        }
+        if (numTokens == 0) continue;
+        if (numTokens < 2)
+        {
+            fprintf(stderr, "%s:%d: a scenario needs a name and a script\n", path, lineNo);
+            fclose(f);
+            return -1;
+        }
+
+        char* names[MAX_VARIABLES];
+        char* values[MAX_VARIABLES][MAX_VALUES];
+        int counts[MAX_VARIABLES];
+        int numVariables = 0;
+        int i = 2;
+        for (; i < numTokens && strcmp(tokens[i], "--") != 0; i++)
+        {
+            char* eq = strchr(tokens[i], '=');
+            if (eq == NULL || eq == tokens[i] || numVariables == MAX_VARIABLES)
+            {
+                fprintf(stderr, "%s:%d: invalid variable %s\n", path, lineNo, tokens[i]);
+                fclose(f);
+                return -1;
+            }
+            *eq = '\0';
+            names[numVariables] = tokens[i];
+            counts[numVariables] = 0;
+
+            char* value = eq + 1;
+            size_t len = strlen(value);
+            if (len >= 2 && value[0] == '{' && value[len - 1] == '}')
+            {
+                value[len - 1] = '\0';
+                for (char* v = strtok(value + 1, ","); v != NULL && counts[numVariables] < MAX_VALUES; v = strtok(NULL, ","))
+                {
+                    values[numVariables][counts[numVariables]++] = v;
+                }
+            }
+            else
+            {
+                values[numVariables][counts[numVariables]++] = value;
+            }
+            if (counts[numVariables] == 0)
+            {
+                fprintf(stderr, "%s:%d: %s has no value\n", path, lineNo, names[numVariables]);
+                fclose(f);
+                return -1;
+            }
+            numVariables += 1;
+        }
+
+        int added = AddScenario(tokens, numTokens, i + 1, names, values, counts, numVariables, baseDir);
+        if (added != 0)
+        {
+            if (added == -1) fprintf(stderr, "out of memory\n");
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static pid_t StartScenario(const Scenario_t* sc, const char* simulator, const char* outDir, double timeLimit)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char path[1024];
+    char text[MAX_TEXT];
+    char substituted[MAX_TEXT];
+
+    // the script is substituted into the output directory, so a failed scenario can be run again by hand
+    FILE* in = fopen(sc->script, "r");
+    if (in == NULL)
+    {
+        perror(sc->script);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s.in", outDir, sc->name);
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        fclose(in);
+        return -1;
+    }
+    while (fgets(text, sizeof(text), in) != NULL)
+    {
+        Substitute(substituted, sizeof(substituted), text, sc);
+        fputs(substituted, out);
+    }
+    fclose(in);
+    fclose(out);
+
+    char logPath[1024];
+    char reportPath[1024];
+    char limit[32];
+    snprintf(logPath, sizeof(logPath), "%s/%s.log", outDir, sc->name);
+    snprintf(reportPath, sizeof(reportPath), "%s/%s.report", outDir, sc->name);
+    snprintf(limit, sizeof(limit), "%g", timeLimit);
+    unlink(reportPath);
+
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    // child: the script is the console input, the console output and the messages of the simulator are the log
+    int inFd = open(path, O_RDONLY);
+    int logFd = open(logPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (inFd < 0 || logFd < 0) _exit(127);
+    dup2(inFd, STDIN_FILENO);
+    dup2(logFd, STDOUT_FILENO);
+    dup2(logFd, STDERR_FILENO);
+    close(inFd);
+    close(logFd);
+
+    char* argv[MAX_TOKENS + 16];
+    int argc = 0;
+    argv[argc++] = (char*)simulator;
+    argv[argc++] = "--stdio";
+    argv[argc++] = "--virtual";
+    argv[argc++] = "--report";
+    argv[argc++] = reportPath;
+    argv[argc++] = "--time-limit";
+    argv[argc++] = limit;
+    for (int i = 0; i < sc->numOptions; i++) argv[argc++] = sc->options[i];
+    argv[argc] = NULL;
+
+    execv(simulator, argv);
+    _exit(127);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void CollectResult(const Scenario_t* sc, const char* outDir, int status, int timedOut, Result_t* res)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char path[1024];
+    char line[MAX_TEXT];
+
+    res->exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    res->fails = 0;
+    res->report[0] = '\0';
+
+    // every console command which failed ends with a line "FAIL"
+    snprintf(path, sizeof(path), "%s/%s.log", outDir, sc->name);
+    FILE* log = fopen(path, "r");
+    if (log != NULL)
+    {
+        while (fgets(line, sizeof(line), log) != NULL)
+        {
+            if (strncmp(line, "FAIL", 4) == 0 && (line[4] == '\r' || line[4] == '\n' || line[4] == '\0')) res->fails += 1;
+        }
+        fclose(log);
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.report", outDir, sc->name);
+    FILE* rep = fopen(path, "r");
+    char exitReason[64] = "";
+    if (rep != NULL)
+    {
+        size_t n = 0;
+        while (fgets(line, sizeof(line), rep) != NULL)
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (strncmp(line, "exit=", 5) == 0) snprintf(exitReason, sizeof(exitReason), "%s", line + 5);
+            else if (n + strlen(line) + 2 < sizeof(res->report))
+            {
+                n += (size_t)snprintf(res->report + n, sizeof(res->report) - n, "%s;", line);
+            }
+        }
+        fclose(rep);
+    }
+
+    if (timedOut) res->result = "timeout";
+    else if (!WIFEXITED(status) || rep == NULL) res->result = "crash";
+    else if (strcmp(exitReason, "time-limit") == 0) res->result = "time-limit";
+    else if (res->exitCode != 0 || res->fails != 0) res->result = "fail";
+    else res->result = "ok";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static const char* ReportValue(const Result_t* res, const char* key, char* buf, size_t size)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    size_t len = strlen(key);
+    for (const char* p = res->report; *p != '\0'; )
+    {
+        const char* end = strchr(p, ';');
+        if (end == NULL) break;
+        if (strncmp(p, key, len) == 0 && p[len] == '=')
+        {
+            size_t n = (size_t)(end - p - (ptrdiff_t)len - 1);
+            if (n >= size) n = size - 1;
+            memcpy(buf, p + len + 1, n);
+            buf[n] = '\0';
+            return buf;
+        }
+        p = end + 1;
+    }
+    return "";
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Usage(const char* self)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fprintf(stderr, "usage: %s [-j jobs] [-s simulator] [-d outdir] [-o report.csv] [-l virtual-seconds] [-t wall-seconds] "
+        "scenarios\n", self);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* outDir = "batch";
+    const char* reportPath = NULL;
+    double timeLimit = 600.0;
+    double wallLimit = 600.0;
+    char simulator[1024];
+
+    // the simulator is built next to the runner
+    char selfBuf[1024];
+    snprintf(selfBuf, sizeof(selfBuf), "%s", argv[0]);
+    snprintf(simulator, sizeof(simulator), "%s/FreeRTOSPosix", dirname(selfBuf));
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:s:d:o:l:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j': jobs = strtol(optarg, NULL, 10); break;
+        case 's': snprintf(simulator, sizeof(simulator), "%s", optarg); break;
+        case 'd': outDir = optarg; break;
+        case 'o': reportPath = optarg; break;
+        case 'l': timeLimit = strtod(optarg, NULL); break;
+        case 't': wallLimit = strtod(optarg, NULL); break;
+        default: Usage(argv[0]); return -1;
+        }
+    }
+    if (optind + 1 != argc || jobs < 1 || timeLimit <= 0.0 || wallLimit <= 0.0)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    if (LoadScenarios(argv[optind]) != 0) return -1;
+    if (numScenarios == 0)
+    {
+        fprintf(stderr, "%s has no scenarios\n", argv[optind]);
+        return -1;
+    }
+    if (mkdir(outDir, 0755) != 0 && errno != EEXIST)
+    {
+        perror(outDir);
+        return -1;
+    }
+
+    Result_t* results = calloc((size_t)numScenarios, sizeof(Result_t));
+    Job_t* running = calloc((size_t)numScenarios, sizeof(Job_t));
+    if (results == NULL || running == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    struct timespec batchStart;
+    clock_gettime(CLOCK_MONOTONIC, &batchStart);
+
+    int next = 0;
+    int active = 0;
+    int done = 0;
+    while (done < numScenarios)
+    {
+        while (active < jobs && next < numScenarios)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &running[next].started);
+            running[next].pid = StartScenario(&scenarios[next], simulator, outDir, timeLimit);
+            if (running[next].pid < 0)
+            {
+                results[next].result = "error";
+                results[next].exitCode = -1;
+                done += 1;
+            }
+            else
+            {
+                active += 1;
+            }
+            next += 1;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0)
+        {
+            // the wall clock limit catches a simulator which hangs without advancing the virtual time
+            for (int i = 0; i < next; i++)
+            {
+                if (running[i].pid > 0 && !running[i].timedOut && ElapsedMs(&running[i].started) > wallLimit * 1000.0)
+                {
+                    running[i].timedOut = 1;
+                    kill(running[i].pid, SIGKILL);
+                }
+            }
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000L };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        for (int i = 0; i < next; i++)
+        {
+            if (running[i].pid != pid) continue;
+
+            Result_t* res = &results[i];
+            res->wallMs = ElapsedMs(&running[i].started);
+            CollectResult(&scenarios[i], outDir, status, running[i].timedOut, res);
+            running[i].pid = 0;
+            active -= 1;
+            done += 1;
+            printf("[%d/%d] %-40s %-10s %8.1f ms\n", done, numScenarios, scenarios[i].name, res->result, res->wallMs);
+            fflush(stdout);
+            break;
+        }
+    }
+
+    double batchMs = ElapsedMs(&batchStart);
+
+    char defaultReport[1024];
+    if (reportPath == NULL)
+    {
+        snprintf(defaultReport, sizeof(defaultReport), "%s/report.csv", outDir);
+        reportPath = defaultReport;
+    }
+    FILE* csv = fopen(reportPath, "w");
+    if (csv == NULL)
+    {
+        perror(reportPath);
+        return -1;
+    }
+
+    static const char* const columns[] = { "virtual_ns", "step_edges", "abs_pos", "commanded", "rotor", "slips",
+        "missed_steps", "max_lag", "max_junction", "ocd", "th_warn", "th_sd" };
+    fprintf(csv, "name,result,exit_code,fails,wall_ms");
+    for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++) fprintf(csv, ",%s", columns[c]);
+    fprintf(csv, "\n");
+
+    int failed = 0;
+    double virtualNs = 0.0;
+    for (int i = 0; i < numScenarios; i++)
+    {
+        char buf[64];
+        const Result_t* res = &results[i];
+        if (strcmp(res->result, "ok") != 0) failed += 1;
+        virtualNs += strtod(ReportValue(res, "virtual_ns", buf, sizeof(buf)), NULL);
+
+        fprintf(csv, "%s,%s,%d,%d,%.1f", scenarios[i].name, res->result, res->exitCode, res->fails, res->wallMs);
+        for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++)
+        {
+            fprintf(csv, ",%s", ReportValue(res, columns[c], buf, sizeof(buf)));
+        }
+        fprintf(csv, "\n");
+    }
+    fclose(csv);
+
+    printf("%d scenarios, %d failed, %.2f s wall, %.2f s virtual, report %s\n", numScenarios, failed, batchMs / 1000.0,
+        virtualNs / 1e9, reportPath);
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+// --------------------------------------------------------------------------------------------------------------------
+// Converts a dump of the event trace of the firmware, see stepper/Core/Src/Code/trace.c, into the trace event JSON
+// format of chrome://tracing and ui.perfetto.dev. The input is the captured console output of "trace dump" or
+// "trace dump -b" from the board or the simulator, everything around the records is skipped:
+//
+//   (sleep 1; printf 'trace on\r\n'; sleep 1; printf 'trace dump -b\r\n'; sleep 2) | timeout 5 ./FreeRTOSPosix --stdio | ./TraceTimeline -o trace.json
+//
+// Every task gets a track with its running slices, the SPI transfers and console commands it executed and its queue
+// operations. The moves, timer chunks and step interrupts are on the track "stepper", queue operations of interrupts
+// on the track "interrupts". Events before the first context switch, or of a trace without the group "task", are on
+// the track "unknown task". The times of the records are the 64 bit run time counter of the firmware in cycles.
+// --------------------------------------------------------------------------------------------------------------------
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+// events of stepper/Core/Inc/Code/trace.h
+enum
+{
+    TRACE_MOVE_START = 1,
+    TRACE_MOVE_SEGMENT,
+    TRACE_MOVE_DONE,
+    TRACE_STEP_ISR,
+    TRACE_SPI_BEGIN,
+    TRACE_SPI_END,
+    TRACE_QUEUE_SEND,
+    TRACE_QUEUE_RECEIVE,
+    TRACE_TASK_SWITCH,
+    TRACE_CMD_BEGIN,
+    TRACE_CMD_END
+};
+
+#define TRACE_SYNC_0    0xA5
+#define TRACE_SYNC_1    0x7E
+#define BINARY_RECORD   19
+
+#define MAX_TASKS       256
+#define TID_STEPPER     1000
+#define TID_INTERRUPTS  1001
+#define TID_UNKNOWN     1002
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+    uint64_t time;
+    uint16_t event;
+    uint16_t arg;
+    uint32_t value;
+    uint64_t extended;   // cycles since the first record
+    size_t order;
+} Record_t;
+
+typedef struct
+{
+    char name[8];
+    int seen;
+    int spiDepth;
+    int cmdDepth;
+} Task_t;
+
+// --------------------------------------------------------------------------------------------------------------------
+static Record_t* records = NULL;
+static size_t numRecords = 0;
+static size_t capRecords = 0;
+static double clockHz = 0.0;
+static unsigned long headerEvents = 0;
+
+static Task_t tasks[MAX_TASKS + 1];   // the last one holds the events before the first context switch
+static int first = 1;
+
+// --------------------------------------------------------------------------------------------------------------------
+static void AddRecord(uint64_t time, uint16_t event, uint16_t arg, uint32_t value)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (numRecords == capRecords)
+    {
+        capRecords = capRecords ? 2 * capRecords : 1024;
+        records = realloc(records, capRecords * sizeof(Record_t));
+        if (records == NULL)
+        {
+            perror("realloc");
+            exit(-1);
+        }
+    }
+    Record_t* r = &records[numRecords];
+    r->time = time;
+    r->event = event;
+    r->arg = arg;
+    r->value = value;
+    r->order = numRecords;
+    numRecords++;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint32_t GetUint32(const unsigned char* p)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static uint64_t GetUint64(const unsigned char* p)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return (uint64_t)GetUint32(p) | ((uint64_t)GetUint32(&p[4]) << 32);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Parse(const unsigned char* data, size_t length)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    size_t pos = 0;
+    while (pos < length)
+    {
+        const unsigned char* p = &data[pos];
+        size_t left = length - pos;
+
+        if (left >= BINARY_RECORD && p[0] == TRACE_SYNC_0 && p[1] == TRACE_SYNC_1)
+        {
+            unsigned char checksum = 0;
+            for (int i = 2; i < BINARY_RECORD - 1; i++) checksum += p[i];
+            if (checksum == p[BINARY_RECORD - 1])
+            {
+                AddRecord(GetUint64(&p[2]), (uint16_t)(p[10] | (p[11] << 8)), (uint16_t)(p[12] | (p[13] << 8)),
+                    GetUint32(&p[14]));
+                pos += BINARY_RECORD;
+                continue;
+            }
+        }
+
+        // the CSV lines are short, so a copy of the rest of the line can be terminated for sscanf
+        if (left >= 3 && p[0] == '$' && (p[1] == 'H' || p[1] == 'E') && p[2] == ',')
+        {
+            char line[128];
+            size_t n = 0;
+            while (n < left && n < sizeof(line) - 1 && p[n] != '\r' && p[n] != '\n') n++;
+            memcpy(line, p, n);
+            line[n] = '\0';
+
+            unsigned long long t;
+            unsigned long a, b, c, d;
+            if (p[1] == 'H' && sscanf(line, "$H,%lu,%lu,%lu", &a, &b, &c) == 3)
+            {
+                clockHz = (double)a;
+                headerEvents = b;
+            }
+            else if (p[1] == 'E' && sscanf(line, "$E,%llu,%lu,%lu,%lu", &t, &b, &c, &d) == 4)
+            {
+                AddRecord((uint64_t)t, (uint16_t)b, (uint16_t)c, (uint32_t)d);
+            }
+            pos += n;
+            continue;
+        }
+        pos++;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int CompareRecords(const void* a, const void* b)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    const Record_t* ra = a;
+    const Record_t* rb = b;
+    if (ra->extended != rb->extended) return (ra->extended < rb->extended) ? -1 : 1;
+    return (ra->order < rb->order) ? -1 : (ra->order > rb->order);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Unpack(char* out, uint32_t value)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // up to four chars, the first one in the lowest byte. Only chars which need no escape in JSON are kept
+    int n = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char ch = (char)((value >> (8 * i)) & 0xFF);
+        if (ch == '\0') break;
+        out[n++] = (ch >= 0x20 && ch < 0x7F && ch != '"' && ch != '\\') ? ch : '?';
+    }
+    out[n] = '\0';
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+__attribute__((format(printf, 2, 3)))
+static void Emit(FILE* out, const char* fmt, ...)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(out, first ? "\n  " : ",\n  ");
+    vfprintf(out, fmt, args);
+    va_end(args);
+    first = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static double Micros(const Record_t* r)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    return (double)r->extended * 1e6 / clockHz;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Convert(FILE* out)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // the timeline starts with the oldest record, an interrupt can have written it behind a younger one
+    uint64_t minimum = records[0].time;
+    for (size_t i = 0; i < numRecords; i++)
+    {
+        if (records[i].time < minimum) minimum = records[i].time;
+    }
+    for (size_t i = 0; i < numRecords; i++) records[i].extended = records[i].time - minimum;
+    qsort(records, numRecords, sizeof(Record_t), CompareRecords);
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    Emit(out, "{\"ph\": \"M\", \"pid\": 1, \"name\": \"process_name\", \"args\": {\"name\": \"firmware\"}}");
+    Emit(out, "{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", \"args\": {\"name\": \"stepper\"}}",
+        TID_STEPPER);
+    Emit(out, "{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", \"args\": {\"name\": \"interrupts\"}}",
+        TID_INTERRUPTS);
+    Emit(out, "{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", \"args\": {\"name\": \"unknown task\"}}",
+        TID_UNKNOWN);
+
+    // the task which was running before the first switch is unknown, or the switches are not recorded at all
+    int current = -1;
+    double sliceStart = 0.0;
+    int moveOpen = 0;
+    double last = (numRecords > 0) ? Micros(&records[numRecords - 1]) : 0.0;
+
+    for (size_t i = 0; i < numRecords; i++)
+    {
+        const Record_t* r = &records[i];
+        double ts = Micros(r);
+        int tid = (current >= 0) ? current : TID_UNKNOWN;
+        Task_t* task = (current >= 0) ? &tasks[current] : &tasks[MAX_TASKS];
+        char name[8];
+
+        switch (r->event)
+        {
+        case TRACE_TASK_SWITCH:
+        {
+            int next = r->arg % MAX_TASKS;
+            if (current >= 0 && ts > sliceStart)
+            {
+                Emit(out, "{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"name\": \"%s\", "
+                    "\"cat\": \"task\"}", current, sliceStart, ts - sliceStart, tasks[current].name);
+            }
+            if (!tasks[next].seen)
+            {
+                Unpack(tasks[next].name, r->value);
+                tasks[next].seen = 1;
+                Emit(out, "{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", \"args\": {\"name\": "
+                    "\"%s #%d\"}}", next, tasks[next].name, next);
+            }
+            current = next;
+            sliceStart = ts;
+            break;
+        }
+
+        case TRACE_SPI_BEGIN:
+            task->spiDepth++;
+            Emit(out, "{\"ph\": \"B\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"spi\", \"cat\": \"spi\", "
+                "\"args\": {\"bytes\": %u}}", tid, ts, (unsigned)r->value);
+            break;
+
+        case TRACE_SPI_END:
+            // the begin can be lost at the start of the ring
+            if (task->spiDepth == 0) break;
+            task->spiDepth--;
+            Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"spi\", \"cat\": \"spi\", "
+                "\"args\": {\"status\": %u}}", tid, ts, (unsigned)r->value);
+            break;
+
+        case TRACE_CMD_BEGIN:
+            task->cmdDepth++;
+            Unpack(name, r->value);
+            Emit(out, "{\"ph\": \"B\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"%s\", \"cat\": \"console\"}",
+                tid, ts, name);
+            break;
+
+        case TRACE_CMD_END:
+            if (task->cmdDepth == 0) break;
+            task->cmdDepth--;
+            Unpack(name, r->value);
+            Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"%s\", \"cat\": \"console\", "
+                "\"args\": {\"result\": %d}}", tid, ts, name, (int)(int16_t)r->arg);
+            break;
+
+        case TRACE_QUEUE_SEND:
+        case TRACE_QUEUE_RECEIVE:
+            Emit(out, "{\"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"%s\", "
+                "\"cat\": \"queue\", \"args\": {\"queue\": \"0x%08x\", \"type\": %u}}",
+                (r->arg & 0x100) ? TID_INTERRUPTS : tid, ts, (r->event == TRACE_QUEUE_SEND) ? "send" : "receive",
+                (unsigned)r->value, (unsigned)(r->arg & 0xFF));
+            break;
+
+        case TRACE_MOVE_START:
+            moveOpen = 1;
+            Emit(out, "{\"ph\": \"B\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"move\", \"cat\": \"stepper\", "
+                "\"args\": {\"pulses\": %u, \"dir\": %u}}", TID_STEPPER, ts, (unsigned)r->value, (unsigned)r->arg);
+            break;
+
+        case TRACE_MOVE_DONE:
+            if (!moveOpen) break;
+            moveOpen = 0;
+            Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"move\", \"cat\": \"stepper\", "
+                "\"args\": {\"done\": %d, \"completed\": %u}}", TID_STEPPER, ts, (int)r->value, (unsigned)r->arg);
+            break;
+
+        case TRACE_MOVE_SEGMENT:
+        case TRACE_STEP_ISR:
+            Emit(out, "{\"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"%s\", "
+                "\"cat\": \"stepper\", \"args\": {\"pulses\": %u}}", TID_STEPPER, ts,
+                (r->event == TRACE_MOVE_SEGMENT) ? "segment" : "step_isr", (unsigned)r->value);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // slices which are still open at the end of the ring are closed with the last record
+    if (current >= 0 && last > sliceStart)
+    {
+        Emit(out, "{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"name\": \"%s\", "
+            "\"cat\": \"task\"}", current, sliceStart, last - sliceStart, tasks[current].name);
+    }
+    for (int t = 0; t <= MAX_TASKS; t++)
+    {
+        int tid = (t < MAX_TASKS) ? t : TID_UNKNOWN;
+        for (; tasks[t].spiDepth > 0; tasks[t].spiDepth--)
+        {
+            Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"spi\"}", tid, last);
+        }
+        for (; tasks[t].cmdDepth > 0; tasks[t].cmdDepth--)
+        {
+            Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f}", tid, last);
+        }
+    }
+    if (moveOpen)
+    {
+        Emit(out, "{\"ph\": \"E\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"name\": \"move\"}", TID_STEPPER, last);
+    }
+    fprintf(out, "\n]}\n");
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Usage(const char* self)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fprintf(stderr, "usage: %s [-c clock-hz] [-o timeline.json] [dump]\n", self);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    const char* outPath = NULL;
+    double clockOverride = 0.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': clockOverride = atof(optarg); break;
+        case 'o': outPath = optarg; break;
+        default: Usage(argv[0]); return -1;
+        }
+    }
+    if (optind + 1 < argc)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    FILE* in = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0)
+    {
+        in = fopen(argv[optind], "rb");
+        if (in == NULL)
+        {
+            perror(argv[optind]);
+            return -1;
+        }
+    }
+
+    // the whole dump is read first, a binary record can span any read
+    size_t length = 0;
+    size_t capacity = 1 << 16;
+    unsigned char* data = malloc(capacity);
+    size_t n;
+    while (data != NULL && (n = fread(&data[length], 1, capacity - length, in)) > 0)
+    {
+        length += n;
+        if (length == capacity)
+        {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    if (in != stdin) fclose(in);
+    if (data == NULL)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    Parse(data, length);
+    free(data);
+
+    if (clockOverride > 0.0) clockHz = clockOverride;
+    if (clockHz <= 0.0)
+    {
+        fprintf(stderr, "no $H header in the dump, the clock is required with -c\n");
+        return -1;
+    }
+    if (numRecords == 0)
+    {
+        fprintf(stderr, "no trace records in the dump\n");
+        return -1;
+    }
+
+    FILE* out = stdout;
+    if (outPath != NULL)
+    {
+        out = fopen(outPath, "w");
+        if (out == NULL)
+        {
+            perror(outPath);
+            return -1;
+        }
+    }
+    Convert(out);
+    if (out != stdout) fclose(out);
+
+    int numTasks = 0;
+    for (int t = 0; t < MAX_TASKS; t++) numTasks += tasks[t].seen;
+    fprintf(stderr, "%zu records of %lu events, %d tasks, %.3f ms\n", numRecords, headerEvents, numTasks,
+        (double)records[numRecords - 1].extended * 1e3 / clockHz);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+/*-----------------------------------------------------------
+ * Application specific definitions.
+ *
+ * These definitions should be adjusted for your particular hardware and
+ * application requirements.
+ *
+ * These parameters and more are described within the 'configuration' section of the
+ * FreeRTOS API documentation available on the FreeRTOS.org web site.
+ *
+ * See http://www.freertos.org/a00110.html
+ *----------------------------------------------------------*/
+
+/* USER CODE BEGIN Includes */
+/* Section where include file can be added */
+/* USER CODE END Includes */
+
+/* Ensure definitions are only used by the compiler, and not by the assembler. */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  #include <stdint.h>
+  extern uint32_t SystemCoreClock;
+  extern void trace_task_switched_in(uint32_t number, const char* name);
+  extern void trace_queue(int receive, const void* queue, uint8_t type, int from_isr);
+#endif
+#define configENABLE_FPU                         1
+#define configENABLE_MPU                         0
+
+#define configUSE_PREEMPTION                     1
+/* 1 places the tasks, queues, semaphores and library handles in static buffers, the kernel provides the idle and
+   timer task memory. The dynamic allocation stays for the run time statistics of the kernel */
+#ifndef configSUPPORT_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION          0
+#endif
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configKERNEL_PROVIDED_STATIC_MEMORY      1
+#define configUSE_IDLE_HOOK                      1
+#define configUSE_TICK_HOOK                      0
+#define configCPU_CLOCK_HZ                       ( SystemCoreClock )
+#define configTICK_RATE_HZ                       ((TickType_t)1000)
+#define configMAX_PRIORITIES                     ( 7 )
+#define configMINIMAL_STACK_SIZE                 ((uint16_t)1024)
+#define configTOTAL_HEAP_SIZE                    ((size_t)0x20000)
+#define configMAX_TASK_NAME_LEN                  ( 16 )
+#define configGENERATE_RUN_TIME_STATS            1
+#define configUSE_TRACE_FACILITY                 1
+#define configUSE_STATS_FORMATTING_FUNCTIONS     1
+#define configUSE_16_BIT_TICKS                   0
+#define configUSE_MUTEXES                        1
+#define configUSE_TIMERS                         1
+#define configTIMER_TASK_PRIORITY                ( configMAX_PRIORITIES - 1 )
+#define configTIMER_QUEUE_LENGTH                 8
+#define configTIMER_TASK_STACK_DEPTH             ( configMINIMAL_STACK_SIZE * 4 )
+#define configCHECK_FOR_STACK_OVERFLOW           0
+#define configUSE_RECURSIVE_MUTEXES              1
+#define configUSE_MALLOC_FAILED_HOOK             1
+#define configUSE_COUNTING_SEMAPHORES            1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+/* USER CODE BEGIN MESSAGE_BUFFER_LENGTH_TYPE */
+/* Defaults to size_t for backward compatibility, but can be changed
+   if lengths will always be less than the number of bytes in a size_t. */
+#define configMESSAGE_BUFFER_LENGTH_TYPE         size_t
+/* USER CODE END MESSAGE_BUFFER_LENGTH_TYPE */
+
+/* Co-routine definitions. */
+#define configUSE_CO_ROUTINES                    0
+#define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
+
+/* The following flag must be enabled only when using newlib */
+#define configUSE_NEWLIB_REENTRANT          0
+#define configCHECK_HANDLER_INSTALLATION    1
+/* Set the following definitions to 1 to include the API function, or zero
+to exclude the API function. */
+#define INCLUDE_vTaskPrioritySet             1
+#define INCLUDE_uxTaskPriorityGet            1
+#define INCLUDE_vTaskDelete                  1
+#define INCLUDE_vTaskCleanUpResources        0
+#define INCLUDE_vTaskSuspend                 1
+#define INCLUDE_vTaskDelayUntil              1
+#define INCLUDE_vTaskDelay                   1
+#define INCLUDE_xTaskGetSchedulerState       1
+
+/* Cortex-M specific definitions. */
+#ifdef __NVIC_PRIO_BITS
+ /* __BVIC_PRIO_BITS will be specified when CMSIS is being used. */
+ #define configPRIO_BITS         __NVIC_PRIO_BITS
+#else
+ #define configPRIO_BITS         4
+#endif
+
+/* The lowest interrupt priority that can be used in a call to a "set priority"
+function. */
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY   15
+
+/* The highest interrupt priority that can be used by any interrupt service
+routine that makes calls to interrupt safe FreeRTOS API functions.  DO NOT CALL
+INTERRUPT SAFE FREERTOS API FUNCTIONS FROM ANY INTERRUPT THAT HAS A HIGHER
+PRIORITY THAN THIS! (higher priorities are lower numeric values. */
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 5
+
+/* Interrupt priorities used by the kernel port layer itself.  These are generic
+to all Cortex-M ports, and do not rely on any particular library functions. */
+#define configKERNEL_INTERRUPT_PRIORITY 		( configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
+/* !!!! configMAX_SYSCALL_INTERRUPT_PRIORITY must not be set to zero !!!!
+See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY 	( configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
+
+/* Normal assert() semantics without relying on the provision of an assert.h
+header file. */
+/* USER CODE BEGIN 1 */
+extern void vAssertCalled( const char * const pcFileName, unsigned long ulLine );
+#define configASSERT( x ) if ((x) == 0) {taskDISABLE_INTERRUPTS(); vAssertCalled( __FILE__, __LINE__);}
+/* USER CODE END 1 */
+
+/* The tasks of the POSIX simulator run on pthread stacks, the stacks allocated by the kernel only hold the thread
+data of the port. The idle hook sleeps until the next interrupt instead of spinning on a host core. */
+
+/* USER CODE BEGIN 2 */
+/* Definitions needed when configGENERATE_RUN_TIME_STATS is on */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()  //SetupRunTimeStatsTimer
+#define portGET_RUN_TIME_COUNTER_VALUE() (xTaskGetTickCount())//GetHighFrequencyTickValue
+
+#define configISR_STACK_SIZE_WORDS 4096
+/* USER CODE END 2 */
+
+/* USER CODE BEGIN Defines */
+#define configAPPLICATION_ALLOCATED_HEAP           1
+#define configRECORD_STACK_HIGH_ADDRESS            1  /* 1: record stack high address for the debugger, 0: do not record stack high address */
+/* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* context switches and queue operations of the kernel go into the event trace, see trace.c */
+#define traceTASK_SWITCHED_IN() trace_task_switched_in(pxCurrentTCB->uxTCBNumber, pxCurrentTCB->pcTaskName)
+#define traceQUEUE_SEND(pxQueue) trace_queue(0, (pxQueue), (pxQueue)->ucQueueType, 0)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) trace_queue(0, (pxQueue), (pxQueue)->ucQueueType, 1)
+#define traceQUEUE_RECEIVE(pxQueue) trace_queue(1, (pxQueue), (pxQueue)->ucQueueType, 0)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) trace_queue(1, (pxQueue), (pxQueue)->ucQueueType, 1)
+
+
+/* USER CODE END Defines */
+
+#endif /* FREERTOS_CONFIG_H */
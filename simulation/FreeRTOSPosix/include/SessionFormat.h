@@ -0,0 +1,21 @@
+#ifndef SESSION_FORMAT_H_
+#define SESSION_FORMAT_H_ SESSION_FORMAT_H_
+
+// text format of the recorded console sessions and of the console log of the simulator, shared with the replay
+// harness of libs/LibL6474/test/Replay
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*! \brief Writes the bytes as a quoted C string, non printable bytes are escaped as \r, \n, \t, \\, \" or \xHH */
+void SessionWriteBytes(FILE* f, const char* data, size_t len);
+
+/*! \brief Parses a quoted string written by SessionWriteBytes
+ *
+ * \param text points to the opening quote
+ * \param out receives the bytes, at most size
+ * \param len receives the number of bytes
+ * \return the character behind the closing quote, NULL if the string is malformed or does not fit */
+const char* SessionParseBytes(const char* text, char* out, size_t size, size_t* len);
+
+#endif /* SESSION_FORMAT_H_ */
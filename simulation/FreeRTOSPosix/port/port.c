@@ -0,0 +1,506 @@
+/*
+ * FreeRTOS port for the POSIX simulator of the stepper firmware, see portmacro.h for the execution model.
+ *
+ * The upstream GCC/Posix port is not part of the vendored kernel, so the simulator brings its own. It does not
+ * use signals, which keeps the firmware free to block in stdio and lets the HAL mock raise interrupts from plain
+ * pthreads.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* The pthread stack is independent of the FreeRTOS stack, which only holds the thread data. */
+#define portTHREAD_STACK_SIZE    ( 256U * 1024U )
+#define portNSEC_PER_SEC         ( 1000000000L )
+#define portTICK_PERIOD_NS       ( portNSEC_PER_SEC / configTICK_RATE_HZ )
+
+typedef struct THREAD
+{
+    pthread_t xThread;
+    pthread_mutex_t xMutex;
+    pthread_cond_t xCond;
+    BaseType_t xRunnable;
+    BaseType_t xDying;
+    TaskFunction_t pxCode;
+    void * pvParams;
+} Thread_t;
+
+/* The thread data is placed at the top of the task stack, pxTopOfStack points right below it. */
+#define prvGetThreadFromTask( xTask )    ( ( Thread_t * ) ( *( StackType_t ** ) ( xTask ) + 1 ) )
+
+/* The one lock of the simulated core, held while interrupts are masked or a critical section is entered. */
+static pthread_mutex_t xInterruptMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Critical nesting and interrupt mask are per thread, so interrupt threads and tasks can use the same API. */
+static __thread UBaseType_t uxCriticalNesting = 0;
+static __thread BaseType_t xInterruptsDisabled = pdFALSE;
+static __thread Thread_t * pxThisThread = NULL;
+
+/* Set by interrupts which made a higher priority task ready, taken by the running task at its next kernel call. */
+static volatile BaseType_t xPendingYield = pdFALSE;
+
+/* Wakes the idle task from vPortWaitForInterrupt(). */
+static pthread_mutex_t xWakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xWakeCond;
+
+static pthread_mutex_t xEndMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xEndCond = PTHREAD_COND_INITIALIZER;
+static BaseType_t xSchedulerEnd = pdFALSE;
+
+static pthread_t xTickThread;
+static BaseType_t xExternalTick = pdFALSE;
+static volatile BaseType_t xSchedulerStarted = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+static void prvResumeThread( Thread_t * pxThread )
+{
+    pthread_mutex_lock( &pxThread->xMutex );
+    pxThread->xRunnable = pdTRUE;
+    pthread_cond_signal( &pxThread->xCond );
+    pthread_mutex_unlock( &pxThread->xMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSuspendThread( Thread_t * pxThread )
+{
+    BaseType_t xDying;
+
+    pthread_mutex_lock( &pxThread->xMutex );
+
+    while( ( pxThread->xRunnable == pdFALSE ) && ( pxThread->xDying == pdFALSE ) )
+    {
+        pthread_cond_wait( &pxThread->xCond, &pxThread->xMutex );
+    }
+
+    pxThread->xRunnable = pdFALSE;
+    xDying = pxThread->xDying;
+    pthread_mutex_unlock( &pxThread->xMutex );
+
+    if( xDying != pdFALSE )
+    {
+        pthread_exit( NULL );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvWakeIdle( void )
+{
+    pthread_mutex_lock( &xWakeMutex );
+    pthread_cond_broadcast( &xWakeCond );
+    pthread_mutex_unlock( &xWakeMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+    Thread_t * pxSelf = pxThisThread;
+    Thread_t * pxNext;
+
+    /* an interrupt can pend the next switch while the threads are handed over, so this loops until it is taken */
+    do
+    {
+        pthread_mutex_lock( &xInterruptMutex );
+        xPendingYield = pdFALSE;
+        vTaskSwitchContext();
+        pxNext = prvGetThreadFromTask( xTaskGetCurrentTaskHandle() );
+        pthread_mutex_unlock( &xInterruptMutex );
+
+        if( pxNext != pxSelf )
+        {
+            prvResumeThread( pxNext );
+            prvSuspendThread( pxSelf );
+        }
+    } while( xPendingYield != pdFALSE );
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvThreadEntry( void * pvParams )
+{
+    Thread_t * pxThread = ( Thread_t * ) pvParams;
+
+    pxThisThread = pxThread;
+
+    /* the task starts when it is scheduled the first time */
+    prvSuspendThread( pxThread );
+
+    if( xPendingYield != pdFALSE )
+    {
+        prvSwitchContext();
+    }
+
+    pxThread->pxCode( pxThread->pvParams );
+
+    /* tasks must not return, the thread is cleaned up by the idle task */
+    vTaskDelete( NULL );
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void * prvTickThread( void * pvParams )
+{
+    struct timespec xNext;
+
+    ( void ) pvParams;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNext );
+
+    for( ; ; )
+    {
+        /* the deadline is absolute, so the tick does not drift with the load of the host */
+        xNext.tv_nsec += portTICK_PERIOD_NS;
+
+        if( xNext.tv_nsec >= portNSEC_PER_SEC )
+        {
+            xNext.tv_nsec -= portNSEC_PER_SEC;
+            xNext.tv_sec += 1;
+        }
+
+        while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xNext, NULL ) == EINTR )
+        {
+        }
+
+        xPortSysTickHandler();
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+void xPortSysTickHandler( void )
+{
+    vPortEnterCritical();
+
+    if( xTaskIncrementTick() != pdFALSE )
+    {
+        vPortYieldFromISR( pdTRUE );
+    }
+
+    vPortExitCritical();
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortUseExternalTick( void )
+{
+    xExternalTick = pdTRUE;
+}
+
+/*-----------------------------------------------------------*/
+
+StackType_t * pxPortInitialiseStack( StackType_t * pxTopOfStack,
+                                     TaskFunction_t pxCode,
+                                     void * pvParameters )
+{
+    Thread_t * pxThread;
+    pthread_attr_t xAttr;
+
+    pxThread = ( Thread_t * ) ( ( ( uintptr_t ) ( pxTopOfStack + 1 ) - sizeof( Thread_t ) ) &
+                                ~( ( uintptr_t ) portBYTE_ALIGNMENT - 1U ) );
+    memset( pxThread, 0, sizeof( Thread_t ) );
+    pxThread->pxCode = pxCode;
+    pxThread->pvParams = pvParameters;
+    pthread_mutex_init( &pxThread->xMutex, NULL );
+    pthread_cond_init( &pxThread->xCond, NULL );
+
+    pthread_attr_init( &xAttr );
+    pthread_attr_setstacksize( &xAttr, portTHREAD_STACK_SIZE );
+
+    if( pthread_create( &pxThread->xThread, &xAttr, prvThreadEntry, pxThread ) != 0 )
+    {
+        fprintf( stderr, "could not create the thread of a task\n" );
+        abort();
+    }
+
+    pthread_attr_destroy( &xAttr );
+
+    return ( StackType_t * ) pxThread - 1;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortStartScheduler( void )
+{
+    pthread_condattr_t xCondAttr;
+
+    pthread_condattr_init( &xCondAttr );
+    pthread_condattr_setclock( &xCondAttr, CLOCK_MONOTONIC );
+    pthread_cond_init( &xWakeCond, &xCondAttr );
+    pthread_condattr_destroy( &xCondAttr );
+
+    /* everything pended while the tasks were created is covered by starting the first task */
+    xPendingYield = pdFALSE;
+    xSchedulerStarted = pdTRUE;
+
+    /* xTaskStartScheduler() masked the interrupts in this thread, which is no task and only waits from now on */
+    vPortEnableInterrupts();
+
+    if( ( xExternalTick == pdFALSE ) && ( pthread_create( &xTickThread, NULL, prvTickThread, NULL ) != 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    prvResumeThread( prvGetThreadFromTask( xTaskGetCurrentTaskHandle() ) );
+
+    pthread_mutex_lock( &xEndMutex );
+
+    while( xSchedulerEnd == pdFALSE )
+    {
+        pthread_cond_wait( &xEndCond, &xEndMutex );
+    }
+
+    pthread_mutex_unlock( &xEndMutex );
+
+    return pdPASS;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+    pthread_mutex_lock( &xEndMutex );
+    xSchedulerEnd = pdTRUE;
+    pthread_cond_signal( &xEndCond );
+    pthread_mutex_unlock( &xEndMutex );
+
+    /* the calling task never continues, main returns from vTaskStartScheduler() and ends the process */
+    if( pxThisThread != NULL )
+    {
+        for( ; ; )
+        {
+            pause();
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+    if( pxThisThread == NULL )
+    {
+        /* an interrupt thread can not switch, the running task does */
+        vPortYieldFromISR( pdTRUE );
+    }
+    else if( uxCriticalNesting > 0 )
+    {
+        /* like a pended PendSV the switch follows when the critical section is left */
+        xPendingYield = pdTRUE;
+    }
+    else
+    {
+        prvSwitchContext();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( BaseType_t xSwitchRequired )
+{
+    if( ( xSwitchRequired == pdFALSE ) || ( xSchedulerStarted == pdFALSE ) )
+    {
+        return;
+    }
+
+    xPendingYield = pdTRUE;
+
+    if( pxThisThread == NULL )
+    {
+        prvWakeIdle();
+    }
+    else if( uxCriticalNesting == 0 )
+    {
+        prvSwitchContext();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+    if( uxCriticalNesting == 0 )
+    {
+        pthread_mutex_lock( &xInterruptMutex );
+    }
+
+    uxCriticalNesting++;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+    if( uxCriticalNesting == 0 )
+    {
+        return;
+    }
+
+    uxCriticalNesting--;
+
+    if( uxCriticalNesting == 0 )
+    {
+        pthread_mutex_unlock( &xInterruptMutex );
+
+        if( ( xPendingYield != pdFALSE ) && ( xSchedulerStarted != pdFALSE ) )
+        {
+            if( pxThisThread != NULL )
+            {
+                prvSwitchContext();
+            }
+            else
+            {
+                prvWakeIdle();
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+    if( xInterruptsDisabled == pdFALSE )
+    {
+        xInterruptsDisabled = pdTRUE;
+        vPortEnterCritical();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+    if( xInterruptsDisabled != pdFALSE )
+    {
+        xInterruptsDisabled = pdFALSE;
+        vPortExitCritical();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxPortSetInterruptMask( void )
+{
+    vPortEnterCritical();
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( UBaseType_t uxMask )
+{
+    ( void ) uxMask;
+    vPortExitCritical();
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortCleanUpTCB( void * pxTCB )
+{
+    Thread_t * pxThread = prvGetThreadFromTask( pxTCB );
+
+    /* the thread waits to be scheduled, it exits instead and is joined before its stack is freed */
+    pthread_mutex_lock( &pxThread->xMutex );
+    pxThread->xDying = pdTRUE;
+    pthread_cond_signal( &pxThread->xCond );
+    pthread_mutex_unlock( &pxThread->xMutex );
+
+    if( pxThread != pxThisThread )
+    {
+        pthread_join( pxThread->xThread, NULL );
+    }
+
+    pthread_cond_destroy( &pxThread->xCond );
+    pthread_mutex_destroy( &pxThread->xMutex );
+}
+
+/*-----------------------------------------------------------*/
+
+void vPortWaitForInterrupt( void )
+{
+    struct timespec xTimeout;
+
+    clock_gettime( CLOCK_MONOTONIC, &xTimeout );
+    xTimeout.tv_nsec += portTICK_PERIOD_NS;
+
+    if( xTimeout.tv_nsec >= portNSEC_PER_SEC )
+    {
+        xTimeout.tv_nsec -= portNSEC_PER_SEC;
+        xTimeout.tv_sec += 1;
+    }
+
+    /* the interrupt sets the pending flag before it takes the wake lock, so no wake up is lost */
+    pthread_mutex_lock( &xWakeMutex );
+
+    if( xPendingYield == pdFALSE )
+    {
+        pthread_cond_timedwait( &xWakeCond, &xWakeMutex, &xTimeout );
+    }
+
+    pthread_mutex_unlock( &xWakeMutex );
+
+    if( xPendingYield != pdFALSE )
+    {
+        prvSwitchContext();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* CMSIS core functions of the simulated Cortex-M, PRIMASK is the interrupt mask of the calling thread. */
+void __disable_irq( void )
+{
+    vPortDisableInterrupts();
+}
+
+/*-----------------------------------------------------------*/
+
+void __enable_irq( void )
+{
+    vPortEnableInterrupts();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t __get_PRIMASK( void )
+{
+    return ( xInterruptsDisabled != pdFALSE ) ? 1U : 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t __get_BASEPRI( void )
+{
+    /* the critical sections of the kernel raise BASEPRI on the target, here they are the nesting beyond PRIMASK */
+    UBaseType_t uxMasked = ( xInterruptsDisabled != pdFALSE ) ? 1U : 0U;
+
+    return ( uxCriticalNesting > uxMasked ) ? configMAX_SYSCALL_INTERRUPT_PRIORITY : 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+void __set_PRIMASK( uint32_t priMask )
+{
+    if( ( priMask & 1U ) != 0U )
+    {
+        vPortDisableInterrupts();
+    }
+    else
+    {
+        vPortEnableInterrupts();
+    }
+}
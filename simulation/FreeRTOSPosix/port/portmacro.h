@@ -0,0 +1,118 @@
+/*
+ * FreeRTOS port for the POSIX simulator of the stepper firmware.
+ *
+ * Every task runs in its own pthread, but only the thread of the current task is allowed to run. The interrupts
+ * of the simulated core are threads as well (tick, HAL mock, console RX), they mask each other and the critical
+ * sections of the tasks with one global lock. A context switch requested by an interrupt is taken by the running
+ * task at its next kernel call, there is no asynchronous preemption of plain application code.
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/*-----------------------------------------------------------
+ * Port specific definitions.
+ *-----------------------------------------------------------
+ */
+
+/* Type definitions. */
+#define portCHAR                 char
+#define portFLOAT                float
+#define portDOUBLE               double
+#define portLONG                 long
+#define portSHORT                short
+#define portSTACK_TYPE           uintptr_t
+#define portBASE_TYPE            long
+#define portPOINTER_SIZE_TYPE    uintptr_t
+
+typedef portSTACK_TYPE           StackType_t;
+typedef long                     BaseType_t;
+typedef unsigned long            UBaseType_t;
+
+#if ( configTICK_TYPE_WIDTH_IN_BITS == TICK_TYPE_WIDTH_16_BITS )
+    typedef uint16_t             TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) 0xffff
+#elif ( configTICK_TYPE_WIDTH_IN_BITS == TICK_TYPE_WIDTH_32_BITS )
+    typedef uint32_t             TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) 0xffffffffUL
+    #define portTICK_TYPE_IS_ATOMIC    1
+#elif ( configTICK_TYPE_WIDTH_IN_BITS == TICK_TYPE_WIDTH_64_BITS )
+    typedef uint64_t             TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) 0xffffffffffffffffULL
+    #define portTICK_TYPE_IS_ATOMIC    1
+#else
+    #error configTICK_TYPE_WIDTH_IN_BITS set to unsupported tick type width.
+#endif
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH          ( -1 )
+#define portTICK_PERIOD_MS        ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT        8
+#define portNOP()                 __asm volatile ( "nop" )
+#define portMEMORY_BARRIER()      __sync_synchronize()
+#define portSOFTWARE_BARRIER()    __asm volatile ( "" ::: "memory" )
+
+/* Scheduler utilities. */
+extern void vPortYield( void );
+extern void vPortYieldFromISR( BaseType_t xSwitchRequired );
+
+#define portYIELD()                                 vPortYield()
+#define portYIELD_FROM_ISR( xSwitchRequired )       vPortYieldFromISR( xSwitchRequired )
+#define portEND_SWITCHING_ISR( xSwitchRequired )    vPortYieldFromISR( xSwitchRequired )
+
+/* Critical section management. The nesting is counted per thread, interrupt threads use the same functions. */
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+extern void vPortDisableInterrupts( void );
+extern void vPortEnableInterrupts( void );
+extern UBaseType_t uxPortSetInterruptMask( void );
+extern void vPortClearInterruptMask( UBaseType_t uxMask );
+
+#define portENTER_CRITICAL()                        vPortEnterCritical()
+#define portEXIT_CRITICAL()                         vPortExitCritical()
+#define portDISABLE_INTERRUPTS()                    vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()                     vPortEnableInterrupts()
+#define portSET_INTERRUPT_MASK_FROM_ISR()           uxPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( x )      vPortClearInterruptMask( x )
+
+/* The thread of a deleted task is joined before its stack, which holds the thread data, is freed. */
+extern void vPortCleanUpTCB( void * pxTCB );
+#define portCLEAN_UP_TCB( pxTCB )                   vPortCleanUpTCB( pxTCB )
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters )    void vFunction( void * pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters )          void vFunction( void * pvParameters )
+
+/* The generic task selection is used, the priorities are few. */
+#ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
+    #define configUSE_PORT_OPTIMISED_TASK_SELECTION    0
+#endif
+
+#if ( configUSE_PORT_OPTIMISED_TASK_SELECTION == 1 )
+    #error configUSE_PORT_OPTIMISED_TASK_SELECTION is not supported by the POSIX simulator port.
+#endif
+
+/* Waits for the next interrupt of the simulated core, the idle hook calls it instead of spinning. */
+extern void vPortWaitForInterrupt( void );
+
+/* The tick is generated by a thread of the port on the wall clock. A simulation with its own clock calls
+ * vPortUseExternalTick() before the scheduler is started and xPortSysTickHandler() for every tick. */
+extern void vPortUseExternalTick( void );
+extern void xPortSysTickHandler( void );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* PORTMACRO_H */
@@ -10,8 +10,26 @@
 
 #include "main.h"
 #include "Console.h"
+#include "Spindle.h"
+
+typedef struct {
+	int position;          // shadow position in steps, no SPI transfer required
+	int steps_per_second;  // commanded step rate, 0 when not running
+	int is_running;
+	int status;            // L6474 status bits like "stepper status", only updated on request
+} StepperSample_t;
 
 void init(TIM_HandleTypeDef tim2_handle, SPI_HandleTypeDef* hspi1, TIM_HandleTypeDef* tim1_handle, TIM_HandleTypeDef* tim4_handle);
-void init_spindle(ConsoleHandle_t console_handle, TIM_HandleTypeDef tim_handle);
+SpindleHandle_t init_spindle(ConsoleHandle_t console_handle, TIM_HandleTypeDef tim_handle);
 void init_stepper(ConsoleHandle_t console_handle, SPI_HandleTypeDef* hspi1, TIM_HandleTypeDef* tim1_handle, TIM_HandleTypeDef* tim4_handle);
+void init_telemetry(ConsoleHandle_t console_handle, SpindleHandle_t spindle_handle);
+void init_feed(ConsoleHandle_t console_handle, SpindleHandle_t spindle_handle);
+void init_mempool(ConsoleHandle_t console_handle);
+void init_perf(ConsoleHandle_t console_handle);
+void init_trace(ConsoleHandle_t console_handle);
+int stepper_sample(StepperSample_t* sample, int with_status);
+float stepper_position_mm(void);
+int spindle_current_ma(void);
+void stepper_gear_index(uint32_t period_us, int pulses_per_rev);
+void stepper_set_feed_override(int percent);
 #endif /* INC_CODE_INIT_H_ */
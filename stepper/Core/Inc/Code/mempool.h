@@ -0,0 +1,42 @@
+/*
+ * mempool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+
+#ifndef INC_CODE_MEMPOOL_H_
+#define INC_CODE_MEMPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// subsystems which take their runtime allocations from the fixed-block pools, the others use newlib malloc
+#ifndef MEMPOOL_FOR_KERNEL
+#define MEMPOOL_FOR_KERNEL 1   // pvPortMalloc: tasks, queues, semaphores, stream buffers
+#endif
+#ifndef MEMPOOL_FOR_L6474
+#define MEMPOOL_FOR_L6474 1    // the handle of LibL6474, unless it is static
+#endif
+#ifndef MEMPOOL_FOR_CONSOLE
+#define MEMPOOL_FOR_CONSOLE 1  // line buffers, commands, aliases and scripts of the console
+#endif
+
+typedef struct {
+	uint32_t block_size;
+	uint32_t blocks;
+	uint32_t used;
+	uint32_t peak;
+	uint32_t allocs;
+	uint32_t misses;           // requests of this size class served by malloc because the pool was empty
+} MemPoolStats_t;
+
+// a request larger than the largest block or for an empty pool falls back to malloc, free takes both
+void* mempool_alloc(size_t size);
+void mempool_free(void* ptr);
+
+// returns -1 behind the last pool
+int mempool_stats(int pool, MemPoolStats_t* stats);
+uint32_t mempool_oversize(void);
+
+#endif /* INC_CODE_MEMPOOL_H_ */
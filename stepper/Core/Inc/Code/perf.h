@@ -0,0 +1,106 @@
+/*
+ * perf.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+
+#ifndef INC_CODE_PERF_H_
+#define INC_CODE_PERF_H_
+
+#include <stdint.h>
+#include "main.h"
+
+// 0 removes the accounting from the interrupt handlers completely, the perf command then only prints zeros
+#ifndef PERF_ENABLE
+#define PERF_ENABLE 1
+#endif
+
+typedef enum {
+	PERF_TIM1_UP = 0,   // step timer update
+	PERF_TIM1_CC,       // step timer compare, the end of a step pulse train
+	PERF_SPI1,          // L6474 transfers
+	PERF_SYSTICK,       // HAL tick and kernel tick
+	PERF_UART_TX,       // polled console output per char, measured in task context including preemption
+	PERF_SLOTS
+} PerfSlot_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max;       // cycles
+	uint64_t total;     // cycles
+} PerfCounter_t;
+
+extern PerfCounter_t perf_counters[PERF_SLOTS];
+
+// latency of the tick: SysTick counts down at the core clock and raises the interrupt when it reloads, so LOAD - VAL
+// at the entry of the handler are the cycles since the tick was due. max - min is the jitter
+typedef struct {
+	uint32_t count;
+	uint32_t min;       // cycles
+	uint32_t max;       // cycles
+	uint64_t total;     // cycles
+} PerfLatency_t;
+
+extern PerfLatency_t perf_systick_latency;
+
+// the cycle counter of the core, the simulator derives it from the host clock
+#ifdef __arm__
+#define PERF_CYCLES() (DWT->CYCCNT)
+#else
+uint32_t perf_host_cycles(void);
+#define PERF_CYCLES() perf_host_cycles()
+#endif
+
+// run time counter of the kernel, the cycle counter extended to 64 bit
+void configureTimerForRunTimeStats(void);
+unsigned long long getRunTimeCounterValue(void);
+
+// the run time counter for the kernel hooks. The simulator reads its 64 bit host clock directly, because unmasking
+// its interrupts in a hook could switch the task inside the kernel
+#ifdef __arm__
+#define PERF_RUN_TIME() getRunTimeCounterValue()
+#else
+uint64_t perf_host_run_time(void);
+#define PERF_RUN_TIME() perf_host_run_time()
+#endif
+
+static inline void perf_record(PerfSlot_t slot, uint32_t cycles) {
+	PerfCounter_t* counter = &perf_counters[slot];
+	counter->count++;
+	counter->total += cycles;
+	if (cycles > counter->max) counter->max = cycles;
+}
+
+static inline void perf_latency(PerfLatency_t* latency, uint32_t cycles) {
+	if (latency->count == 0 || cycles < latency->min) latency->min = cycles;
+	if (cycles > latency->max) latency->max = cycles;
+	latency->count++;
+	latency->total += cycles;
+}
+
+// PERF_ENTER at the top of a handler, PERF_EXIT with its slot at the bottom. Every slot is only written by its own
+// handler, so there is no lock. PERF_EXIT_TASK is for slots which are shared by several tasks
+#if PERF_ENABLE
+#define PERF_ENTER() uint32_t perf_entry = PERF_CYCLES()
+#define PERF_EXIT(slot) perf_record((slot), PERF_CYCLES() - perf_entry)
+#define PERF_EXIT_TASK(slot) do { \
+		uint32_t perf_primask = __get_PRIMASK(); \
+		__disable_irq(); \
+		perf_record((slot), PERF_CYCLES() - perf_entry); \
+		__set_PRIMASK(perf_primask); \
+	} while (0)
+#else
+#define PERF_ENTER()
+#define PERF_EXIT(slot)
+#define PERF_EXIT_TASK(slot)
+#endif
+
+// first statement of SysTick_Handler, the simulator has no SysTick counter
+#if PERF_ENABLE && defined(__arm__)
+#define PERF_SYSTICK_LATENCY() perf_latency(&perf_systick_latency, SysTick->LOAD - SysTick->VAL)
+#else
+#define PERF_SYSTICK_LATENCY()
+#endif
+
+#endif /* INC_CODE_PERF_H_ */
@@ -0,0 +1,38 @@
+/*
+ * tcm.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+
+#ifndef INC_CODE_TCM_H_
+#define INC_CODE_TCM_H_
+
+// 0 leaves the hot code in flash and the hot data wherever the linker puts it, e.g. to compare the latencies of
+// the "perf" command with and without the tightly coupled memories
+#ifndef TCM_ENABLE
+#define TCM_ENABLE 1
+#endif
+
+// ITCM_FUNC runs a function from the ITCM RAM at 0x00000000, zero wait states and not behind the I-cache. The startup
+// copies the functions from flash, see STM32F746ZGTX_FLASH.ld. Calls between flash and ITCM go through veneers of
+// the linker, so a whole interrupt chain belongs there and not only single functions of it.
+// DTCM_BSS places zero initialized data at the start of the RAM, which is the DTCM.
+#if TCM_ENABLE && defined(__arm__)
+#define ITCM_FUNC __attribute__((section(".itcm_text"), noinline))
+#define DTCM_BSS __attribute__((section(".bss.dtcm")))
+#else
+#define ITCM_FUNC
+#define DTCM_BSS
+#endif
+
+// the D-cache does not cover the DTCM, so DMA buffers there need no cache maintenance. They stay there without
+// TCM_ENABLE as well, the caches are always on. The RAM build has its code in the DTCM, there the linker aligns
+// the DMA buffers to a block in the SRAM which main makes non-cacheable with the MPU
+#ifdef __arm__
+#define DMA_BUFFER __attribute__((section(".bss.dma")))
+#else
+#define DMA_BUFFER
+#endif
+
+#endif /* INC_CODE_TCM_H_ */
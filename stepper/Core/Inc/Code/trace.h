@@ -0,0 +1,61 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+
+#ifndef INC_CODE_TRACE_H_
+#define INC_CODE_TRACE_H_
+
+#include <stdint.h>
+
+// 0 removes the recording from the stepper, the kernel hooks and the console, the trace command then stays empty
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+
+// number of records in the ring, a power of two. Every record takes 16 bytes of RAM
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 2048
+#endif
+
+typedef enum {
+	TRACE_MOVE_START = 1, // arg: direction, value: pulses of the move
+	TRACE_MOVE_SEGMENT,   // value: pulses of the next timer chunk
+	TRACE_MOVE_DONE,      // arg: 1 completed, 0 canceled, value: pulses done
+	TRACE_STEP_ISR,       // value: pulses left behind the finished chunk
+	TRACE_SPI_BEGIN,      // value: bytes of the transfer
+	TRACE_SPI_END,        // value: HAL status
+	TRACE_QUEUE_SEND,     // arg: queue type, 0x100 from an interrupt, value: address of the queue
+	TRACE_QUEUE_RECEIVE,  // like TRACE_QUEUE_SEND
+	TRACE_TASK_SWITCH,    // arg: task number, value: first four chars of the task name
+	TRACE_CMD_BEGIN,      // value: first four chars of the command
+	TRACE_CMD_END,        // arg: result, value: first four chars of the command
+	TRACE_EVENT_TYPES
+} TraceEvent_t;
+
+typedef struct {
+	uint64_t time;        // cycles of the run time counter, see PERF_RUN_TIME
+	uint16_t event;
+	uint16_t arg;
+	uint32_t value;
+} TraceRecord_t;
+
+#if TRACE_ENABLE
+// callable from interrupts and every task, the slot is claimed with an atomic increment and never locked
+void trace_event(TraceEvent_t event, uint16_t arg, uint32_t value);
+
+// up to four chars of a name in one value, the first char in the lowest byte
+uint32_t trace_pack(const char* text, int length);
+
+#define TRACE(event, arg, value) trace_event((event), (uint16_t)(arg), (uint32_t)(value))
+#else
+#define TRACE(event, arg, value)
+#endif
+
+// hooks of the kernel, see FreeRTOSConfig.h
+void trace_task_switched_in(uint32_t number, const char* name);
+void trace_queue(int receive, const void* queue, uint8_t type, int from_isr);
+
+#endif /* INC_CODE_TRACE_H_ */
@@ -14,5 +14,22 @@
 #define CONSOLE_LINE_SIZE 120
 #define CONSOLE_COMMAND_MAX_LENGTH 64
 #define CONSOLE_HELP_MAX_LENGTH 512
+#define CONSOLE_SCRIPT_MAX_LENGTH 512
+#define CONSOLE_MACHINE_MODE 0
+#define CONSOLE_PIPELINE_WINDOW 4
+#define CONSOLE_PIPELINE_RESPONSE_SIZE 256
+#define CONSOLE_PIPELINE_STACK_DEPTH (2*1024)
+
+#include "mempool.h"
+#if MEMPOOL_FOR_CONSOLE
+#define CONSOLE_MALLOC mempool_alloc
+#define CONSOLE_FREE mempool_free
+#endif
+
+#include "trace.h"
+#if TRACE_ENABLE
+#define CONSOLE_TRACE_COMMAND_BEGIN(cmd, cmdLen) TRACE(TRACE_CMD_BEGIN, 0, trace_pack((cmd), (cmdLen)))
+#define CONSOLE_TRACE_COMMAND_END(cmd, cmdLen, result) TRACE(TRACE_CMD_END, (result), trace_pack((cmd), (cmdLen)))
+#endif
 
 #endif /* INC_CONSOLE_CONSOLECONFIG_H_ */
@@ -23,15 +23,29 @@
   extern uint32_t SystemCoreClock;
 /* USER CODE BEGIN 0 */
     extern void configureTimerForRunTimeStats(void);
-    extern unsigned long getRunTimeCounterValue(void);
+    extern unsigned long long getRunTimeCounterValue(void);
+    extern void trace_task_switched_in(uint32_t number, const char* name);
+    extern void trace_queue(int receive, const void* queue, uint8_t type, int from_isr);
+    /* the tick and the context switch of the kernel run from the ITCM, the declarations place the definitions of
+       tasks.c and port.c. BaseType_t of the port is long */
+    #include "tcm.h"
+    extern void vTaskSwitchContext(void) ITCM_FUNC;
+    extern long xTaskIncrementTick(void) ITCM_FUNC;
+    extern void xPortSysTickHandler(void) ITCM_FUNC;
+    extern void PendSV_Handler(void) ITCM_FUNC;
 /* USER CODE END 0 */
 #endif
 #define configENABLE_FPU                         1
 #define configENABLE_MPU                         0
 
 #define configUSE_PREEMPTION                     1
+/* 1 places the tasks, queues, semaphores and library handles in static buffers, the kernel provides the idle and
+   timer task memory. The dynamic allocation stays for the run time statistics of the kernel */
+#ifndef configSUPPORT_STATIC_ALLOCATION
 #define configSUPPORT_STATIC_ALLOCATION          0
+#endif
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configKERNEL_PROVIDED_STATIC_MEMORY      1
 #define configUSE_IDLE_HOOK                      0
 #define configUSE_TICK_HOOK                      0
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
@@ -121,9 +135,11 @@ standard names. */
 //#define xPortSysTickHandler SysTick_Handler
 
 /* USER CODE BEGIN 2 */
-/* Definitions needed when configGENERATE_RUN_TIME_STATS is on */
-#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()  //SetupRunTimeStatsTimer
-#define portGET_RUN_TIME_COUNTER_VALUE() (xTaskGetTickCount())//GetHighFrequencyTickValue
+/* Definitions needed when configGENERATE_RUN_TIME_STATS is on, the run time is counted in CPU cycles by the DWT,
+   see perf.c */
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() configureTimerForRunTimeStats()
+#define portGET_RUN_TIME_COUNTER_VALUE() getRunTimeCounterValue()
 
 #define configISR_STACK_SIZE_WORDS 4096
 #define configUSE_NEWLIB_REENTRANT 1
@@ -133,6 +149,12 @@ standard names. */
 #define configAPPLICATION_ALLOCATED_HEAP           1
 #define configRECORD_STACK_HIGH_ADDRESS            1  /* 1: record stack high address for the debugger, 0: do not record stack high address */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* context switches and queue operations of the kernel go into the event trace, see trace.c */
+#define traceTASK_SWITCHED_IN() trace_task_switched_in(pxCurrentTCB->uxTCBNumber, pxCurrentTCB->pcTaskName)
+#define traceQUEUE_SEND(pxQueue) trace_queue(0, (pxQueue), (pxQueue)->ucQueueType, 0)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) trace_queue(0, (pxQueue), (pxQueue)->ucQueueType, 1)
+#define traceQUEUE_RECEIVE(pxQueue) trace_queue(1, (pxQueue), (pxQueue)->ucQueueType, 0)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) trace_queue(1, (pxQueue), (pxQueue)->ucQueueType, 1)
 
 
 /* USER CODE END Defines */
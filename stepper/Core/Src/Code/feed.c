@@ -0,0 +1,206 @@
+/*
+ * feed.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stdio.h"
+#include "string.h"
+#include "stdlib.h"
+#include "math.h"
+#include "Console.h"
+#include "Spindle.h"
+#include "main.h"
+#include "init.h"
+
+#define FEED_STACK_SIZE configMINIMAL_STACK_SIZE
+#define FEED_PRIORITY (tskIDLE_PRIORITY + 2)
+#define FEED_PERIOD_MS 20
+
+// limits of the override in percent of the commanded feed
+#define FEED_OVERRIDE_MIN 10
+#define FEED_OVERRIDE_MAX 200
+
+// the feed is reduced linearly from the knee on and reaches the minimum at the full load, both in percent of the limits
+#define FEED_LOAD_KNEE 70
+#define FEED_LOAD_FULL 120
+#define FEED_MIN_ADAPTIVE 20
+
+// the feed drops immediately but is restored with this step per period, 2% per 20ms is 100% per second
+#define FEED_RESTORE_STEP 2
+
+typedef struct {
+	TaskHandle_t task;
+	SpindleHandle_t spindle;
+	volatile int adaptive;
+	int limit_ma;
+	int max_droop;
+	int manual;
+	volatile int override;
+	volatile int load;     // percent of the limits, -1 when none of them is sensed
+} FeedContext;
+
+static FeedContext feed_ctx;
+
+#if configSUPPORT_STATIC_ALLOCATION
+static StaticTask_t feed_tcb;
+static StackType_t feed_stack[FEED_STACK_SIZE];
+#endif
+
+static int feed_load(FeedContext* ctx) {
+	int load = 0;
+
+	// current in percent of the limit. It is not sensed in one spindle direction, then only the droop term is left
+	int current_ma = spindle_current_ma();
+	if (ctx->limit_ma > 0 && current_ma >= 0) {
+		load = current_ma * 100 / ctx->limit_ma;
+	}
+	else if (ctx->limit_ma > 0 && ctx->max_droop == 0) {
+		return -1;
+	}
+
+	// RPM droop against the setpoint in percent of the allowed droop, this also holds the feed while the spindle
+	// accelerates in closed loop
+	int running = 0;
+	float setpoint = 0.0f;
+	float speed = 0.0f;
+	SPINDLE_GetSnapshot(ctx->spindle, &running, &setpoint, &speed);
+	if (running && ctx->max_droop > 0 && fabsf(setpoint) > 0.0f) {
+		int droop = (int)((fabsf(setpoint) - fabsf(speed)) * 100.0f / fabsf(setpoint));
+		int droop_load = droop * 100 / ctx->max_droop;
+		if (droop_load > load) load = droop_load;
+	}
+	return load;
+}
+
+static int feed_target(FeedContext* ctx, int load) {
+	if (load <= FEED_LOAD_KNEE) return ctx->manual;
+
+	int minimum = (ctx->manual < FEED_MIN_ADAPTIVE) ? ctx->manual : FEED_MIN_ADAPTIVE;
+	if (load >= FEED_LOAD_FULL) return minimum;
+	return ctx->manual - (load - FEED_LOAD_KNEE) * (ctx->manual - minimum) / (FEED_LOAD_FULL - FEED_LOAD_KNEE);
+}
+
+static void FeedFunction(void* arg) {
+	FeedContext* ctx = (FeedContext*)arg;
+	TickType_t last_wake = xTaskGetTickCount();
+
+	while (1) {
+		if (!ctx->adaptive) {
+			// the manual override is set by the command, the task sleeps until adaptive mode is enabled again
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			last_wake = xTaskGetTickCount();
+			continue;
+		}
+
+		// without any sensed load the feed drops to the minimum, the cut is not watched anymore
+		int load = feed_load(ctx);
+		int target = feed_target(ctx, (load < 0) ? FEED_LOAD_FULL : load);
+		int override = ctx->override;
+
+		// a rising load must be answered at once, the restore is slow so the feed does not oscillate at the knee
+		if (target < override) override = target;
+		else if (override < target) override = (override + FEED_RESTORE_STEP < target) ? override + FEED_RESTORE_STEP : target;
+
+		// the console has a higher priority and may have switched the mode meanwhile
+		taskENTER_CRITICAL();
+		ctx->load = load;
+		if (ctx->adaptive && override != ctx->override) {
+			ctx->override = override;
+			stepper_set_feed_override(override);
+		}
+		taskEXIT_CRITICAL();
+
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(FEED_PERIOD_MS));
+	}
+}
+
+static int feedConsoleFunction(int argc, char** argv, void* ctx) {
+	FeedContext* feed = (FeedContext*)ctx;
+
+	if (argc == 0) {
+		printf("override %d\r\nmanual %d\r\nadapt %s\r\n", feed->override, feed->manual, feed->adaptive ? "on" : "off");
+		if (feed->load < 0) printf("load not sensed\r\nOK\r\n");
+		else printf("load %d\r\nOK\r\n", feed->load);
+		return 0;
+	}
+
+	if (argc == 2 && strcmp(argv[0], "adapt") == 0 && strcmp(argv[1], "off") == 0) {
+		// the manual override is restored
+		feed->adaptive = 0;
+		feed->override = feed->manual;
+		stepper_set_feed_override(feed->manual);
+		printf("OK\r\n");
+		return 0;
+	}
+
+	if (argc == 3 && strcmp(argv[0], "adapt") == 0) {
+		int limit_ma = atoi(argv[1]);
+		int max_droop = atoi(argv[2]);
+		if (limit_ma < 0 || max_droop < 0 || max_droop > 100 || (limit_ma == 0 && max_droop == 0)) {
+			printf("Invalid current limit or droop\r\nFAIL\r\n");
+			return -1;
+		}
+		if (max_droop == 0 && spindle_current_ma() < 0) {
+			printf("Spindle current not sensed in this direction, a droop is required\r\nFAIL\r\n");
+			return -1;
+		}
+
+		if (feed->task == NULL) {
+#if configSUPPORT_STATIC_ALLOCATION
+			feed->task = xTaskCreateStatic(FeedFunction, "feed", FEED_STACK_SIZE, feed, FEED_PRIORITY, feed_stack, &feed_tcb);
+			if (feed->task == NULL) {
+#else
+			if (xTaskCreate(FeedFunction, "feed", FEED_STACK_SIZE, feed, FEED_PRIORITY, &feed->task) != pdPASS) {
+#endif
+				feed->task = NULL;
+				printf("Could not create feed task\r\nFAIL\r\n");
+				return -1;
+			}
+		}
+
+		feed->adaptive = 0;
+		feed->limit_ma = limit_ma;
+		feed->max_droop = max_droop;
+		feed->adaptive = 1;
+		xTaskNotifyGive(feed->task);
+
+		printf("OK\r\n");
+		return 0;
+	}
+
+	if (argc == 1) {
+		int percent = atoi(argv[0]);
+		if (percent < FEED_OVERRIDE_MIN || percent > FEED_OVERRIDE_MAX) {
+			printf("Invalid override\r\nFAIL\r\n");
+			return -1;
+		}
+
+		// in adaptive mode the manual override is the upper limit
+		feed->manual = percent;
+		if (!feed->adaptive) {
+			feed->override = percent;
+			stepper_set_feed_override(percent);
+		}
+		printf("OK\r\n");
+		return 0;
+	}
+
+	printf("Invalid number of arguments\r\nFAIL\r\n");
+	return -1;
+}
+
+void init_feed(ConsoleHandle_t console_handle, SpindleHandle_t spindle_handle) {
+	memset(&feed_ctx, 0, sizeof(feed_ctx));
+	feed_ctx.spindle = spindle_handle;
+	feed_ctx.manual = 100;
+	feed_ctx.override = 100;
+
+	CONSOLE_RegisterCommand(console_handle, "feed", "<<feed percent>> scales the rate of stepper moves, also while they run.\r\n"
+			"<<feed adapt mA droop>> reduces the feed with the spindle current in mA or the RPM droop in %, 0 disables either.\r\n"
+			"The current is not sensed in every spindle direction, there only the droop is used.\r\n"
+			"<<feed adapt off>> restores the manual override.",
+			feedConsoleFunction, &feed_ctx);
+}
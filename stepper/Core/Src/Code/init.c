@@ -58,6 +58,11 @@ void init(TIM_HandleTypeDef tim_handle, SPI_HandleTypeDef* hspi1, TIM_HandleType
 	  CONSOLE_RegisterCommand(console_handle, "capability", "prints a specified string of capability bits", CapabilityFunc, NULL);
 
 
-	  init_spindle(console_handle, tim_handle);
+	  SpindleHandle_t spindle_handle = init_spindle(console_handle, tim_handle);
 	  init_stepper(console_handle, hspi1, tim1_handle, tim4_handle);
+	  init_telemetry(console_handle, spindle_handle);
+	  init_feed(console_handle, spindle_handle);
+	  init_mempool(console_handle);
+	  init_perf(console_handle);
+	  init_trace(console_handle);
 }
@@ -0,0 +1,171 @@
+/*
+ * mempool.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stdio.h"
+#include "stdint.h"
+#include "stdlib.h"
+#include "Console.h"
+#include "main.h"
+#include "init.h"
+#include "mempool.h"
+
+// Fixed-block pools in size classes. Every pool is a static array of equal blocks, the free blocks are linked
+// through their first word. Allocation and release only unlink or link one block with interrupts off, so both
+// take constant time and the pools can not fragment. Blocks which have never been used are handed out from the
+// end of the array, so no initialization is required before the first allocation of the kernel.
+
+typedef struct MemPoolBlock {
+	struct MemPoolBlock* next;
+} MemPoolBlock;
+
+typedef struct {
+	uint32_t block_size;
+	uint32_t blocks;
+	uint8_t* storage;
+	MemPoolBlock* free_list;
+	uint32_t unused;           // index of the first block which has never been allocated
+	uint32_t used;
+	uint32_t peak;
+	uint32_t allocs;
+	uint32_t misses;
+} MemPool;
+
+// the block sizes are multiples of 8, so every block is aligned like malloc. The largest class holds the command,
+// alias and script entries of the console. The counts leave headroom over the peaks of the "pools" command after
+// start up and a move, task stacks and the handles of the console and spindle stay on the heap
+static uint64_t storage_32[32 * 16 / 8];
+static uint64_t storage_64[64 * 32 / 8];
+static uint64_t storage_128[128 * 32 / 8];
+static uint64_t storage_256[256 * 16 / 8];
+static uint64_t storage_640[640 * 32 / 8];
+
+static MemPool pools[] = {
+	{ .block_size = 32,  .blocks = 16, .storage = (uint8_t*)storage_32 },
+	{ .block_size = 64,  .blocks = 32, .storage = (uint8_t*)storage_64 },
+	{ .block_size = 128, .blocks = 32, .storage = (uint8_t*)storage_128 },
+	{ .block_size = 256, .blocks = 16, .storage = (uint8_t*)storage_256 },
+	{ .block_size = 640, .blocks = 32, .storage = (uint8_t*)storage_640 },
+};
+
+#define NUM_POOLS ((int)(sizeof(pools) / sizeof(pools[0])))
+
+static uint32_t oversize;
+
+void* mempool_alloc(size_t size) {
+	if (size == 0) size = 1;
+
+	// the classes are sorted, the first one which fits wastes the least
+	for (int i = 0; i < NUM_POOLS; i++) {
+		MemPool* pool = &pools[i];
+		if (size > pool->block_size) continue;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		MemPoolBlock* block = pool->free_list;
+		if (block != NULL) {
+			pool->free_list = block->next;
+		}
+		else if (pool->unused < pool->blocks) {
+			block = (MemPoolBlock*)&pool->storage[pool->unused * pool->block_size];
+			pool->unused++;
+		}
+
+		if (block != NULL) {
+			pool->used++;
+			if (pool->used > pool->peak) pool->peak = pool->used;
+			pool->allocs++;
+		}
+		else {
+			pool->misses++;
+		}
+
+		__set_PRIMASK(primask);
+
+		// an empty pool does not borrow from the larger classes, they are sized for their own users
+		return (block != NULL) ? (void*)block : malloc(size);
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	oversize++;
+	__set_PRIMASK(primask);
+
+	return malloc(size);
+}
+
+void mempool_free(void* ptr) {
+	if (ptr == NULL) return;
+
+	uint8_t* address = (uint8_t*)ptr;
+	for (int i = 0; i < NUM_POOLS; i++) {
+		MemPool* pool = &pools[i];
+		if (address < pool->storage || address >= pool->storage + pool->blocks * pool->block_size) continue;
+
+		MemPoolBlock* block = (MemPoolBlock*)ptr;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		block->next = pool->free_list;
+		pool->free_list = block;
+		pool->used--;
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	free(ptr);
+}
+
+int mempool_stats(int index, MemPoolStats_t* stats) {
+	if (index < 0 || index >= NUM_POOLS || stats == NULL) {
+		return -1;
+	}
+
+	MemPool* pool = &pools[index];
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stats->block_size = pool->block_size;
+	stats->blocks = pool->blocks;
+	stats->used = pool->used;
+	stats->peak = pool->peak;
+	stats->allocs = pool->allocs;
+	stats->misses = pool->misses;
+	__set_PRIMASK(primask);
+
+	return 0;
+}
+
+uint32_t mempool_oversize(void) {
+	return oversize;
+}
+
+static int PoolsFunc(int argc, char** argv, void* ctx) {
+	(void)argv;
+	(void)ctx;
+
+	if (argc != 0) {
+		printf("Invalid number of arguments\r\nFAIL");
+		return -1;
+	}
+
+	// one line per size class: block size, blocks, used, peak, allocations and misses which went to malloc
+	MemPoolStats_t stats;
+	for (int i = 0; mempool_stats(i, &stats) == 0; i++) {
+		printf("%lu %lu %lu %lu %lu %lu\r\n", (unsigned long)stats.block_size, (unsigned long)stats.blocks,
+			(unsigned long)stats.used, (unsigned long)stats.peak, (unsigned long)stats.allocs,
+			(unsigned long)stats.misses);
+	}
+	printf("oversize %lu\r\nOK", (unsigned long)mempool_oversize());
+
+	return 0;
+}
+
+void init_mempool(ConsoleHandle_t console_handle) {
+	CONSOLE_RegisterCommand(console_handle, "pools", "prints block size, blocks, used, peak, allocations and misses of every memory pool", PoolsFunc, NULL);
+}
@@ -0,0 +1,127 @@
+/*
+ * perf.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stdio.h"
+#include "stdint.h"
+#include "string.h"
+#include "Console.h"
+#include "main.h"
+#include "init.h"
+#include "perf.h"
+#include "tcm.h"
+#ifndef __arm__
+#include <time.h>
+#endif
+
+DTCM_BSS PerfCounter_t perf_counters[PERF_SLOTS];
+DTCM_BSS PerfLatency_t perf_systick_latency;
+
+static const char* const slot_names[PERF_SLOTS] = {
+	[PERF_TIM1_UP] = "tim1_up",
+	[PERF_TIM1_CC] = "tim1_cc",
+	[PERF_SPI1]    = "spi1",
+	[PERF_SYSTICK] = "systick",
+	[PERF_UART_TX] = "uart_tx",
+};
+
+// the 32 bit cycle counter wraps after 24s at 180MHz, the wraps are counted on every read and the tick reads it
+static uint32_t cycles_last;
+static uint32_t cycles_wraps;
+static uint64_t perf_since;
+
+#ifndef __arm__
+uint64_t perf_host_run_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+	return ns * (SystemCoreClock / 1000000U) / 1000U;
+}
+
+uint32_t perf_host_cycles(void) {
+	return (uint32_t)perf_host_run_time();
+}
+#endif
+
+void configureTimerForRunTimeStats(void) {
+#ifdef __arm__
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55;     // the DWT of the Cortex-M7 is locked after reset
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+// read by the tick, so it runs from the ITCM like the tick
+ITCM_FUNC unsigned long long getRunTimeCounterValue(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t now = PERF_CYCLES();
+	if (now < cycles_last) cycles_wraps++;
+	cycles_last = now;
+	uint64_t value = ((uint64_t)cycles_wraps << 32) | now;
+
+	__set_PRIMASK(primask);
+	return value;
+}
+
+static int PerfFunc(int argc, char** argv, void* ctx) {
+	(void)ctx;
+
+	if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		memset(perf_counters, 0, sizeof(perf_counters));
+		memset(&perf_systick_latency, 0, sizeof(perf_systick_latency));
+		__set_PRIMASK(primask);
+		perf_since = getRunTimeCounterValue();
+		printf("OK");
+		return 0;
+	}
+
+	if (argc != 0) {
+		printf("Invalid arguments\r\nFAIL");
+		return -1;
+	}
+
+	// a consistent copy, the handlers must not update a slot while it is printed
+	PerfCounter_t counters[PERF_SLOTS];
+	PerfLatency_t latency;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memcpy(counters, perf_counters, sizeof(counters));
+	latency = perf_systick_latency;
+	__set_PRIMASK(primask);
+
+	// the counters are 64 bit wide, nano printf has no %llu
+	char elapsed[24];
+	CONSOLE_FormatU64(elapsed, sizeof(elapsed), getRunTimeCounterValue() - perf_since);
+	printf("clock %lu\r\nelapsed %s\r\n", (unsigned long)SystemCoreClock, elapsed);
+
+	// one line per handler: count, total and maximum cycles per call
+	for (int i = 0; i < PERF_SLOTS; i++) {
+		char total[24];
+		CONSOLE_FormatU64(total, sizeof(total), counters[i].total);
+		printf("%s %lu %s %lu\r\n", slot_names[i], (unsigned long)counters[i].count, total,
+			(unsigned long)counters[i].max);
+	}
+
+	// the latency of the tick: count, total, minimum and maximum cycles
+	char total[24];
+	CONSOLE_FormatU64(total, sizeof(total), latency.total);
+	printf("systick_latency %lu %s %lu %lu\r\n", (unsigned long)latency.count, total, (unsigned long)latency.min,
+		(unsigned long)latency.max);
+	printf("OK");
+
+	return 0;
+}
+
+void init_perf(ConsoleHandle_t console_handle) {
+	perf_since = getRunTimeCounterValue();
+	CONSOLE_RegisterCommand(console_handle, "perf", "prints count, total and maximum cycles of the profiled interrupt handlers and count, total, minimum and maximum latency of the tick, perf reset clears them", PerfFunc, NULL);
+}
@@ -6,14 +6,78 @@
  */
 #include "Spindle.h"
 #include "Console.h"
-#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include "main.h"
+#include "init.h"
+#include "tcm.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+// the tachometer is captured with TIM5 CH4 on PA3 (A0), the counter runs with 1MHz
+#define TACH_TIMER_CLOCK 1000000U
+#define TACH_PULSES_PER_REV 1
+// without an edge for this time, the spindle counts as stopped
+#define TACH_TIMEOUT_MS 200
+// the gearing is stopped when an index is missing for more than this number of index periods
+#define TACH_GEAR_TIMEOUT_PERIODS 2
+
+TIM_HandleTypeDef htim5;
+
+typedef struct {
+	volatile uint32_t last_capture;
+	volatile uint32_t period;
+	volatile uint32_t edges;
+	volatile TickType_t last_edge;
+} TachContext;
+
+static TachContext tach;
+
+// the current sense output SI_R (PA0) is sampled by ADC1 IN0. Every PWM period one conversion is triggered
+// by TIM2 CH2 in the middle of the on-time, DMA2 stream 0 writes the samples into a circular buffer
+#define CURRENT_SAMPLES 32
+// SI_R only reports the current which the high side of the R half bridge sources, that is direction 1 (CH4, negative
+// RPM). In direction 0 the L half bridge sources it and SI_L (PE0) has no ADC channel, so neither the filter nor the
+// trip see it. Swapped motor leads change the sign of the RPM but not the sensed bridge
+#define CURRENT_SENSED_DIRECTION 1
+// BTS7960 current sense ratio kILIS and the IS resistor of the module
+#define CURRENT_SENSE_RATIO 8500U
+#define CURRENT_SENSE_OHM 1000U
+#define CURRENT_ADC_MV 3300U
+#define CURRENT_ADC_RANGE 4096U
+#define CURRENT_TRIP_MA_DEFAULT 8000
+// first order low pass over the block means, the new value has a weight of 1/8
+#define CURRENT_FILTER_DIV 8
+
+DMA_HandleTypeDef hdma_adc1;
+
+// the RPM to duty table is stored in the last flash sector, the linker script keeps the sector free of code
+#define CALIBRATION_SECTOR FLASH_SECTOR_7
+#define CALIBRATION_ADDRESS 0x080C0000U
+
+typedef struct {
+	uint16_t samples[CURRENT_SAMPLES];
+	volatile int32_t filtered_ma;
+	volatile int32_t peak_ma;
+	int32_t trip_ma;
+	volatile int tripped;
+	volatile uint32_t trips;
+	int available;
+	SpindleHandle_t spindle;
+} CurrentContext;
+
+// the ADC writes samples by DMA, see DMA_BUFFER
+DMA_BUFFER static CurrentContext current;
 
 typedef struct {
 	int direction;
+	volatile int enabled;
 	TIM_HandleTypeDef pwm;
 } SpindleContext;
 
+SpindleContext ctx;
+
 void SPINDLE_SetDirection(SpindleHandle_t h, void* context, int direction) {
 	(void) h;
 
@@ -28,15 +92,22 @@ void SPINDLE_SetDutyCycle(SpindleHandle_t h, void* context, float duty) {
 	SpindleContext* ctx = (SpindleContext*) context;
 
 	int arr = TIM2->ARR;
+	int on = (int)((float)arr * duty);
+
+	// after an overcurrent trip, the bridge stays off until the trip is reset
+	if (current.tripped) on = 0;
 
 	if (ctx->direction) {
 		TIM2->CCR3 = 0;
-		TIM2->CCR4 = (int)((float)arr * duty);
+		TIM2->CCR4 = on;
 	}
 	else {
-		TIM2->CCR3 = (int)((float)arr * duty);
+		TIM2->CCR3 = on;
 		TIM2->CCR4 = 0;
 	}
+
+	// the current is sampled in the middle of the on-time, the rising edge of CH2 triggers the ADC
+	TIM2->CCR2 = (on / 2 > 0) ? (on / 2) : 1;
 }
 
 void SPINDLE_EnaPWM(SpindleHandle_t h, void* context, int enable) {
@@ -44,6 +115,9 @@ void SPINDLE_EnaPWM(SpindleHandle_t h, void* context, int enable) {
 
 	SpindleContext* ctx = (SpindleContext*) context;
 
+	if (current.tripped) enable = 0;
+	ctx->enabled = enable;
+
 	HAL_GPIO_WritePin(SPINDLE_ENA_L_GPIO_Port, SPINDLE_ENA_L_Pin, enable);
 	HAL_GPIO_WritePin(SPINDLE_ENA_R_GPIO_Port, SPINDLE_ENA_R_Pin, enable);
 
@@ -57,14 +131,327 @@ void SPINDLE_EnaPWM(SpindleHandle_t h, void* context, int enable) {
 	}
 }
 
-SpindleContext ctx;
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim) {
+	if (htim->Instance != TIM5) return;
+
+	// the counter is 32 bit wide, so the unsigned difference is valid across one overflow
+	uint32_t capture = HAL_TIM_ReadCapturedValue(htim, TIM_CHANNEL_4);
+	if (tach.edges > 0) {
+		tach.period = capture - tach.last_capture;
+	}
+	tach.last_capture = capture;
+	tach.edges += 1;
+	tach.last_edge = xTaskGetTickCountFromISR();
+
+	// CH3 compares against the time of the next expected index, so a missing index is detected in hardware
+	uint32_t timeout = (tach.edges > 1) ? TACH_GEAR_TIMEOUT_PERIODS * tach.period : TACH_TIMEOUT_MS * 1000U;
+	__HAL_TIM_SET_COMPARE(htim, TIM_CHANNEL_3, capture + timeout);
+	__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_CC3);
+
+	// the feed of the electronic gearing follows directly in the interrupt
+	if (tach.edges > 1) {
+		stepper_gear_index(tach.period, TACH_PULSES_PER_REV);
+	}
+}
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim) {
+	if (htim->Instance != TIM5 || htim->Channel != HAL_TIM_ACTIVE_CHANNEL_3) return;
+
+	// the index is overdue, a period of 0 stops the gearing
+	stepper_gear_index(0, TACH_PULSES_PER_REV);
+}
+
+float SPINDLE_GetAxisPosition(SpindleHandle_t h, void* context) {
+	(void) h;
+	(void) context;
 
-void init_spindle(ConsoleHandle_t console_handle, TIM_HandleTypeDef tim_handle) {
+	// the shadow position of the stepper, readable without SPI while a move is running
+	return stepper_position_mm();
+}
+
+float SPINDLE_GetMeasuredRPM(SpindleHandle_t h, void* context) {
+	(void) h;
+	(void) context;
+
+	uint32_t period = tach.period;
+	if (tach.edges < 2 || period == 0 || (xTaskGetTickCount() - tach.last_edge) > pdMS_TO_TICKS(TACH_TIMEOUT_MS)) {
+		return 0.0f;
+	}
+	return (60.0f * (float)TACH_TIMER_CLOCK) / ((float)period * (float)TACH_PULSES_PER_REV);
+}
+
+static int init_tach(void) {
+	GPIO_InitTypeDef gpio = {0};
+	TIM_IC_InitTypeDef ic = {0};
+
+	__HAL_RCC_TIM5_CLK_ENABLE();
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+
+	gpio.Pin = GPIO_PIN_3;
+	gpio.Mode = GPIO_MODE_AF_PP;
+	gpio.Pull = GPIO_PULLUP;
+	gpio.Speed = GPIO_SPEED_FREQ_LOW;
+	gpio.Alternate = GPIO_AF2_TIM5;
+	HAL_GPIO_Init(GPIOA, &gpio);
+
+	// the APB1 timers run with twice the bus clock since APB1 is divided
+	htim5.Instance = TIM5;
+	htim5.Init.Prescaler = (2 * HAL_RCC_GetPCLK1Freq()) / TACH_TIMER_CLOCK - 1;
+	htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim5.Init.Period = 0xFFFFFFFF;
+	htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim5.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	if (HAL_TIM_IC_Init(&htim5) != HAL_OK) return -1;
+
+	ic.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+	ic.ICSelection = TIM_ICSELECTION_DIRECTTI;
+	ic.ICPrescaler = TIM_ICPSC_DIV1;
+	ic.ICFilter = 0x8;
+	if (HAL_TIM_IC_ConfigChannel(&htim5, &ic, TIM_CHANNEL_4) != HAL_OK) return -1;
+
+	// CH3 is a plain compare without output for the index timeout, it is moved along with every edge
+	TIM5->CCMR2 &= ~(TIM_CCMR2_CC3S | TIM_CCMR2_OC3M);
+	__HAL_TIM_ENABLE_IT(&htim5, TIM_IT_CC3);
+
+	// below configMAX_SYSCALL_INTERRUPT_PRIORITY, the callback uses the FromISR API
+	HAL_NVIC_SetPriority(TIM5_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(TIM5_IRQn);
+
+	return (HAL_TIM_IC_Start_IT(&htim5, TIM_CHANNEL_4) == HAL_OK) ? 0 : -1;
+}
+
+static int32_t current_adc_to_ma(uint32_t raw) {
+	return (int32_t)(((uint64_t)raw * CURRENT_ADC_MV * CURRENT_SENSE_RATIO) / ((uint64_t)CURRENT_ADC_RANGE * CURRENT_SENSE_OHM));
+}
+
+static uint32_t current_ma_to_adc(int32_t ma) {
+	uint64_t raw = ((uint64_t)ma * CURRENT_ADC_RANGE * CURRENT_SENSE_OHM) / ((uint64_t)CURRENT_ADC_MV * CURRENT_SENSE_RATIO);
+	return (raw < CURRENT_ADC_RANGE) ? (uint32_t)raw : (CURRENT_ADC_RANGE - 1);
+}
+
+static void current_process(const uint16_t* samples, int count) {
+	uint32_t sum = 0;
+	uint16_t max = 0;
+
+	for (int i = 0; i < count; i++) {
+		sum += samples[i];
+		if (samples[i] > max) max = samples[i];
+	}
+
+	int32_t mean_ma = current_adc_to_ma(sum / count);
+	current.filtered_ma += (mean_ma - current.filtered_ma) / CURRENT_FILTER_DIV;
+
+	int32_t max_ma = current_adc_to_ma(max);
+	if (max_ma > current.peak_ma) current.peak_ma = max_ma;
+}
+
+static void current_half_complete(DMA_HandleTypeDef* hdma) {
+	(void) hdma;
+	current_process(&current.samples[0], CURRENT_SAMPLES / 2);
+}
+
+static void current_complete(DMA_HandleTypeDef* hdma) {
+	(void) hdma;
+	current_process(&current.samples[CURRENT_SAMPLES / 2], CURRENT_SAMPLES / 2);
+}
+
+void SPINDLE_OvercurrentIRQHandler(void) {
+	if ((ADC1->SR & ADC_SR_AWD) == 0) return;
+	ADC1->SR = ~(uint32_t)ADC_SR_AWD;
+
+	// the bridge is switched off right here in the period of the sample, the controller is informed afterwards
+	TIM2->CCR3 = 0;
+	TIM2->CCR4 = 0;
+	SPINDLE_ENA_L_GPIO_Port->BSRR = (uint32_t)SPINDLE_ENA_L_Pin << 16;
+	SPINDLE_ENA_R_GPIO_Port->BSRR = (uint32_t)SPINDLE_ENA_R_Pin << 16;
+
+	if (!current.tripped) {
+		BaseType_t woken = pdFALSE;
+		current.tripped = 1;
+		current.trips += 1;
+		SPINDLE_StopFromISR(current.spindle, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+}
+
+static int current_sensed(void) {
+	// the L half bridge only sources current while the bridge is enabled, at standstill both directions are zero
+	return current.available && (ctx.direction == CURRENT_SENSED_DIRECTION || !ctx.enabled);
+}
+
+int spindle_current_ma(void) {
+	return current_sensed() ? current.filtered_ma : -1;
+}
+
+static int init_current(TIM_HandleTypeDef* pwm) {
+	GPIO_InitTypeDef gpio = {0};
+	TIM_OC_InitTypeDef oc = {0};
+
+	current.trip_ma = CURRENT_TRIP_MA_DEFAULT;
+
+	// SI_R is a plain input after the CubeMX init, it is switched to analog here
+	gpio.Pin = SPINDLE_SI_R_Pin;
+	gpio.Mode = GPIO_MODE_ANALOG;
+	gpio.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(SPINDLE_SI_R_GPIO_Port, &gpio);
+
+	__HAL_RCC_ADC1_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+
+	hdma_adc1.Instance = DMA2_Stream0;
+	hdma_adc1.Init.Channel = DMA_CHANNEL_0;
+	hdma_adc1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	hdma_adc1.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_adc1.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_adc1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+	hdma_adc1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+	hdma_adc1.Init.Mode = DMA_CIRCULAR;
+	hdma_adc1.Init.Priority = DMA_PRIORITY_HIGH;
+	hdma_adc1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&hdma_adc1) != HAL_OK) return -1;
+	hdma_adc1.XferHalfCpltCallback = current_half_complete;
+	hdma_adc1.XferCpltCallback = current_complete;
+
+	HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 7, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+	// the bus addresses are 32 bit, the simulator only arms the stream and never writes through them
+	if (HAL_DMA_Start_IT(&hdma_adc1, (uint32_t)(uintptr_t)&ADC1->DR, (uint32_t)(uintptr_t)current.samples,
+			CURRENT_SAMPLES) != HAL_OK) return -1;
+
+	// there is no ADC HAL driver in the project, so ADC1 is set up directly: PCLK2 / 4, 56 cycles sample time,
+	// one conversion of IN0 on the rising edge of TIM2 CH2 and the analog watchdog on the trip threshold
+	ADC->CCR = (ADC->CCR & ~ADC_CCR_ADCPRE) | ADC_CCR_ADCPRE_0;
+	ADC1->SMPR2 = (3U << ADC_SMPR2_SMP0_Pos);
+	ADC1->SQR1 = 0;
+	ADC1->SQR3 = 0;
+	ADC1->LTR = 0;
+	ADC1->HTR = current_ma_to_adc(current.trip_ma);
+	ADC1->CR1 = ADC_CR1_AWDEN | ADC_CR1_AWDSGL | ADC_CR1_AWDIE;
+	ADC1->CR2 = ADC_CR2_EXTEN_0 | (3U << ADC_CR2_EXTSEL_Pos) | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_ADON;
+
+	// the trip must be handled before anything else, it uses the FromISR API so it is not above syscall priority
+	HAL_NVIC_SetPriority(ADC_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(ADC_IRQn);
+
+	// CH2 has no output pin, it only keeps the counter running and generates the ADC trigger
+	oc.OCMode = TIM_OCMODE_PWM2;
+	oc.Pulse = 1;
+	oc.OCPolarity = TIM_OCPOLARITY_HIGH;
+	oc.OCFastMode = TIM_OCFAST_DISABLE;
+	if (HAL_TIM_PWM_ConfigChannel(pwm, &oc, TIM_CHANNEL_2) != HAL_OK) return -1;
+	if (HAL_TIM_PWM_Start(pwm, TIM_CHANNEL_2) != HAL_OK) return -1;
+
+	current.available = 1;
+	return 0;
+}
+
+static int currentConsoleFunction(int argc, char** argv, void* ctx) {
+	(void) ctx;
+
+	if (!current.available) {
+		printf("Current sensing not available\r\nFAIL\r\n");
+		return -1;
+	}
+
+	if (argc == 0) {
+		// in the other direction the samples are only the idle R half bridge, so the values are not printed as current
+		if (current_sensed()) {
+			printf("filtered %ld mA\r\npeak %ld mA\r\ntrip %ld mA\r\n",
+					(long)current.filtered_ma, (long)current.peak_ma, (long)current.trip_ma);
+		}
+		else {
+			printf("filtered not sensed\r\npeak %ld mA\r\ntrip %ld mA not armed in this direction\r\n",
+					(long)current.peak_ma, (long)current.trip_ma);
+		}
+		printf("tripped %d\r\ntrips %lu\r\nOK\r\n", current.tripped, (unsigned long)current.trips);
+		return 0;
+	}
+
+	if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+		// the controller has already been stopped by the trip, so the bridge can be released again
+		current.peak_ma = 0;
+		current.tripped = 0;
+		printf("OK\r\n");
+		return 0;
+	}
+
+	if (argc == 2 && strcmp(argv[0], "trip") == 0) {
+		int trip = atoi(argv[1]);
+		if (trip <= 0) {
+			printf("Invalid trip current\r\nFAIL\r\n");
+			return -1;
+		}
+		if (!current_sensed()) {
+			printf("Current not sensed in this direction\r\nFAIL\r\n");
+			return -1;
+		}
+		current.trip_ma = trip;
+		ADC1->HTR = current_ma_to_adc(trip);
+		printf("OK\r\n");
+		return 0;
+	}
+
+	printf("Invalid arguments\r\nFAIL\r\n");
+	return -1;
+}
+
+int SPINDLE_SaveCalibration(SpindleHandle_t h, void* context, const SpindleCalibration_t* c) {
+	(void) h;
+	(void) context;
+
+	FLASH_EraseInitTypeDef erase = {0};
+	uint32_t error = 0;
+	const uint32_t* words = (const uint32_t*)c;
+	int result = 0;
+	StepperSample_t sample;
+
+	// the code runs from the same flash bank, so the erase stalls every interrupt for a second or two. A move would
+	// lose its steps and the current trip would be blind, so the stepper has to stand still as well
+	stepper_sample(&sample, 0);
+	if (sample.is_running) return -1;
+
+	erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+	erase.Sector = CALIBRATION_SECTOR;
+	erase.NbSectors = 1;
+	erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+	// the CPU stalls while the sector is erased, this only happens on request by the console and at standstill
+	HAL_FLASH_Unlock();
+	if (HAL_FLASHEx_Erase(&erase, &error) != HAL_OK) {
+		result = -1;
+	}
+	for (uint32_t i = 0; result == 0 && i < (sizeof(*c) + 3) / 4; i++) {
+		if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, CALIBRATION_ADDRESS + 4 * i, words[i]) != HAL_OK) {
+			result = -1;
+		}
+	}
+	HAL_FLASH_Lock();
+
+#if (__DCACHE_PRESENT == 1U)
+	// the flash is read through the D-cache, which still holds the old calibration
+	SCB_InvalidateDCache_by_Addr((uint32_t*)CALIBRATION_ADDRESS, (int32_t)((sizeof(*c) + 31) & ~31U));
+#endif
+
+	return result;
+}
+
+int SPINDLE_LoadCalibration(SpindleHandle_t h, void* context, SpindleCalibration_t* c) {
+	(void) h;
+	(void) context;
+
+	// the library checks magic and checksum, an erased sector is simply rejected there
+	memcpy(c, (const void*)CALIBRATION_ADDRESS, sizeof(*c));
+	return 0;
+}
+
+SpindleHandle_t init_spindle(ConsoleHandle_t console_handle, TIM_HandleTypeDef tim_handle) {
 	ctx.direction = 0;
+	ctx.enabled = 0;
 	ctx.pwm = tim_handle;
 
-	// set up spindle
-	SpindlePhysicalParams_t spindle_params;
+	// set up spindle, the tachometer input makes the closed loop available. It stays open until spindle loop on,
+	// because the board runs without a tachometer by default and the loop would then drive the full duty cycle
+	SpindlePhysicalParams_t spindle_params = {0};
 	spindle_params.maxRPM             =  9000.0f;
 	spindle_params.minRPM             = -9000.0f;
 	spindle_params.absMinRPM          =  1600.0f;
@@ -72,6 +459,32 @@ void init_spindle(ConsoleHandle_t console_handle, TIM_HandleTypeDef tim_handle)
 	spindle_params.setDutyCycle       = SPINDLE_SetDutyCycle;
 	spindle_params.enaPWM             = SPINDLE_EnaPWM;
 	spindle_params.context            = &ctx;
+	spindle_params.accelRPMs          =  4000.0f;
+	spindle_params.decelRPMs          =  4000.0f;
+	spindle_params.saveCalibration    = SPINDLE_SaveCalibration;
+	spindle_params.loadCalibration    = SPINDLE_LoadCalibration;
+	spindle_params.getAxisPosition    = SPINDLE_GetAxisPosition;
+
+	if (init_tach() == 0) {
+		// initial gains, not tuned on the real spindle yet
+		spindle_params.getMeasuredRPM     = SPINDLE_GetMeasuredRPM;
+		spindle_params.kp                 = 0.0001f;
+		spindle_params.ki                 = 0.0005f;
+		spindle_params.kd                 = 0.0f;
+		spindle_params.controlPeriodMs    = 10;
+		spindle_params.settleBand         = 0.02f;
+	}
+
+	SpindleHandle_t spindle = SPINDLE_CreateInstance( 4*configMINIMAL_STACK_SIZE, configMAX_PRIORITIES - 3, console_handle, &spindle_params);
+
+	// the trip needs the spindle handle to stop the controller, so current sensing starts afterwards
+	current.spindle = spindle;
+	if (spindle != NULL && init_current(&ctx.pwm) == 0) {
+		CONSOLE_RegisterCommand(console_handle, "current", "<<current>> prints the filtered and peak spindle current and the overcurrent trip.\r\n"
+				"<<current trip mA>> sets the trip threshold, <<current reset>> releases the bridge after a trip.\r\n"
+				"Only the R half bridge is sensed (negative RPM), in the other direction the trip is not armed.",
+				currentConsoleFunction, NULL);
+	}
 
-	SPINDLE_CreateInstance( 4*configMINIMAL_STACK_SIZE, configMAX_PRIORITIES - 3, console_handle, &spindle_params);
+	return spindle;
 }
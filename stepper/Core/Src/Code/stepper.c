@@ -1,5 +1,8 @@
 #include "main.h"
 #include "init.h"
+#include "mempool.h"
+#include "trace.h"
+#include "tcm.h"
 #include "LibL6474.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -9,19 +12,52 @@
 #include "stm32f7xx_hal_tim.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 #define STEPS_PER_TURN 200
 #define RESOLUTION 16
 #define MM_PER_TURN 4
 
+// limits of the step rate while the feed follows the spindle
+#define GEAR_MIN_RATE 10
+#define GEAR_MAX_RATE 50000
+#define GEAR_DEFAULT_MAX_ERROR 200
+
+typedef enum {
+	GEAR_IDLE = 0,
+	GEAR_ARMED,
+	GEAR_ACTIVE,
+} GearState_t;
+
+typedef enum {
+	GEAR_OK = 0,
+	GEAR_ERROR_BOUND,
+	GEAR_SPINDLE_LOST,
+	GEAR_CANCELED,
+} GearFault_t;
+
 typedef struct {
 	L6474_Handle_t h;
+	SemaphoreHandle_t lock;
 	int is_powered;
 	int is_referenced;
 	int is_running;
 
 	void (*done_callback)(L6474_Handle_t);
 	int remaining_pulses;
+	int chunk_pulses;
+
+	// shadow of the position which is readable without SPI transfers, the pulses of
+	// a running move are added from the timer counter
+	volatile int shadow_position;
+	volatile int move_pulses;
+	volatile int move_dir;
+	volatile int steps_per_second;
+
+	// commanded rate of the running move, the step timer runs with it scaled by the feed override in percent.
+	// 0 for motion which is not scaled, like the reference run
+	volatile int move_steps_per_second;
+	volatile int feed_override;
 	TIM_HandleTypeDef* htim1_handle;
 	TIM_HandleTypeDef* htim4_handle;
 
@@ -32,19 +68,53 @@ typedef struct {
 	int position_min_steps;
 	int position_max_steps;
 	int position_ref_steps;
+
+	// electronic gearing, the feed follows the spindle index in the tachometer interrupt
+	struct {
+		volatile GearState_t state;
+		volatile GearFault_t fault;
+		int dir;
+		int steps;
+		uint32_t feed_q16;      // steps per spindle revolution, 16.16 fixed point
+		uint64_t target_q16;    // commanded steps since the first index, 16.16 fixed point
+		int max_error;
+		volatile int error;
+		volatile int peak_error;
+		volatile uint32_t indexes;
+	} gear;
 } StepperContext;
 
 static int StepTimerCancelAsync(void* pPWM);
+static int StepAsyncTimer(void* pPWM, int dir, unsigned int numPulses, void (*doneClb)(L6474_Handle_t), L6474_Handle_t h);
+static int pulses_done(void);
 void set_speed(StepperContext* stepper_ctx, int steps_per_second);
+static void set_move_speed(StepperContext* stepper_ctx, int steps_per_second, int with_override);
+
+// the state of the step interrupt chain, read and written on every chunk of a move
+DTCM_BSS StepperContext stepper_ctx;
+
+#if configSUPPORT_STATIC_ALLOCATION
+// the library handle and the lock are placed by the linker instead of the heap
+static L6474_StaticHandle_t stepper_handle_buffer;
+static StaticSemaphore_t stepper_lock_buffer;
+#endif
 
 static void* StepLibraryMalloc( unsigned int size )
 {
+#if MEMPOOL_FOR_L6474
+     return mempool_alloc(size);
+#else
      return malloc(size);
+#endif
 }
 
 static void StepLibraryFree( const void* const ptr )
 {
+#if MEMPOOL_FOR_L6474
+     mempool_free((void*)ptr);
+#else
      free((void*)ptr);
+#endif
 }
 
 static int StepDriverSpiTransfer( void* pIO, char* pRX, const char* pTX, unsigned int length )
@@ -53,6 +123,8 @@ static int StepDriverSpiTransfer( void* pIO, char* pRX, const char* pTX, unsigne
 
 	HAL_StatusTypeDef status = 0;
 
+	TRACE(TRACE_SPI_BEGIN, 0, length);
+
 	for ( unsigned int i = 0; i < length; i++ )
 	{
 		HAL_GPIO_WritePin(STEP_SPI_CS_GPIO_Port, STEP_SPI_CS_Pin, 0);
@@ -64,6 +136,8 @@ static int StepDriverSpiTransfer( void* pIO, char* pRX, const char* pTX, unsigne
 		HAL_Delay(1);
 	}
 
+	TRACE(TRACE_SPI_END, 0, status);
+
 	if (status != HAL_OK) {
 		return -1;
 	}
@@ -113,13 +187,14 @@ static int reset(StepperContext* stepper_ctx){
 	stepper_ctx->is_powered = 0;
 	stepper_ctx->is_referenced = 0;
 	stepper_ctx->is_running = 0;
+	stepper_ctx->shadow_position = 0;
 
 	return result;
 }
 
 static int powerena(StepperContext* stepper_ctx, int argc, char** argv) {
 	if (argc == 2) {
-		printf("Current Powerstate: %d\r\n", stepper_ctx->is_powered);
+		printf("%d\r\n", stepper_ctx->is_powered);
 		return 0;
 	}
 	else if (argc == 4 && strcmp(argv[2], "-v") == 0) {
@@ -182,7 +257,7 @@ static int reference(StepperContext* stepper_ctx, int argc, char** argv) {
 	if (!is_skip) {
 		const uint32_t start_time = HAL_GetTick();
 		result |= L6474_SetPowerOutputs(stepper_ctx->h, 1);
-		set_speed(stepper_ctx, 3000);
+		set_move_speed(stepper_ctx, 3000, 0);
 		if(HAL_GPIO_ReadPin(REFERENCE_MARK_GPIO_Port, REFERENCE_MARK_Pin) == GPIO_PIN_RESET) {
 			// already at reference
 			L6474_StepIncremental(stepper_ctx->h, 100000000);
@@ -209,6 +284,7 @@ static int reference(StepperContext* stepper_ctx, int argc, char** argv) {
 	if (result == 0) {
 		stepper_ctx->is_referenced = 1;
 		L6474_SetAbsolutePosition(stepper_ctx->h, stepper_ctx->position_ref_steps);
+		stepper_ctx->shadow_position = stepper_ctx->position_ref_steps;
 	}
 
 	result |= L6474_SetPowerOutputs(stepper_ctx->h, poweroutput);
@@ -217,6 +293,16 @@ static int reference(StepperContext* stepper_ctx, int argc, char** argv) {
 }
 
 
+// prints a value line, a value which can not be formatted fails the command instead of printing an empty line
+static int print_value(float value, int decimals) {
+	if (CONSOLE_PrintFloat(value, decimals) < 0) {
+		printf("Value out of range\r\n");
+		return -1;
+	}
+	printf("\r\n");
+	return 0;
+}
+
 static int config(StepperContext* stepper_ctx, int argc, char** argv) {
 	if (argc < 2) {
 		printf("Invalid number of arguments\r\n");
@@ -366,11 +452,10 @@ static int config(StepperContext* stepper_ctx, int argc, char** argv) {
 	}
 	else if(strcmp(argv[1], "mmperturn") == 0){
 		if (argc == 2) {
-			printf("%f\r\n", stepper_ctx->mm_per_turn);
-			return 0;
+			return print_value(stepper_ctx->mm_per_turn, 6);
 		}
 		else if (argc == 4 && strcmp(argv[2], "-v") == 0) {
-			stepper_ctx->mm_per_turn = atoff(argv[3]);
+			stepper_ctx->mm_per_turn = strtof(argv[3], NULL);
 			return 0;
 		}
 		else {
@@ -380,11 +465,10 @@ static int config(StepperContext* stepper_ctx, int argc, char** argv) {
 	}
 	else if(strcmp(argv[1], "posmin") == 0){
 		if (argc == 2) {
-			printf("%f\r\n", (float)(stepper_ctx->position_min_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution));
-			return 0;
+			return print_value((float)(stepper_ctx->position_min_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution), 6);
 		}
 		else if (argc == 4 && strcmp(argv[2], "-v") == 0) {
-			float value_float = atoff(argv[3]);
+			float value_float = strtof(argv[3], NULL);
 
 
 			stepper_ctx->position_min_steps = (value_float * stepper_ctx->steps_per_turn  * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;;
@@ -397,11 +481,10 @@ static int config(StepperContext* stepper_ctx, int argc, char** argv) {
 	}
 	else if(strcmp(argv[1], "posmax") == 0){
 		if (argc == 2) {
-			printf("%f\r\n", (float)(stepper_ctx->position_max_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution));
-			return 0;
+			return print_value((float)(stepper_ctx->position_max_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution), 6);
 		}
 		else if (argc == 4 && strcmp(argv[2], "-v") == 0) {
-			float value_float = atoff(argv[3]);
+			float value_float = strtof(argv[3], NULL);
 
 
 			stepper_ctx->position_max_steps = (value_float * stepper_ctx->steps_per_turn  * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;;
@@ -414,11 +497,10 @@ static int config(StepperContext* stepper_ctx, int argc, char** argv) {
 	}
 	else if(strcmp(argv[1], "posref") == 0){
 		if (argc == 2) {
-			printf("%f\r\n", (float)(stepper_ctx->position_ref_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution));
-			return 0;
+			return print_value((float)(stepper_ctx->position_ref_steps * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution), 6);
 		}
 		else if (argc == 4 && strcmp(argv[2], "-v") == 0) {
-			float value_float = atoff(argv[3]);
+			float value_float = strtof(argv[3], NULL);
 
 
 			stepper_ctx->position_ref_steps = (value_float * stepper_ctx->steps_per_turn  * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;;
@@ -439,15 +521,40 @@ void set_speed(StepperContext* stepper_ctx, int steps_per_second) {
 
 	int quotient = clk / (steps_per_second * 2); // magic 2
 
-	int i = 0;
-
-	while ((quotient / (i + 1)) > 65535) i++;
+	// smallest prescaler which keeps the reload in 16 bit, also called from the gearing interrupt
+	int i = quotient / 65536;
 
+	stepper_ctx->steps_per_second = steps_per_second;
 	__HAL_TIM_SET_PRESCALER(stepper_ctx->htim4_handle, i);
 	__HAL_TIM_SET_AUTORELOAD(stepper_ctx->htim4_handle, (quotient / (i + 1)) - 1);
 	stepper_ctx->htim4_handle->Instance->CCR4 = stepper_ctx->htim4_handle->Instance->ARR / 2;
 }
 
+static int scale_feed(int steps_per_second, int percent) {
+	int scaled = (int)(((int64_t)steps_per_second * percent) / 100);
+	return (scaled < 1) ? 1 : scaled;
+}
+
+static void set_move_speed(StepperContext* stepper_ctx, int steps_per_second, int with_override) {
+	// the rate and the timer are changed together, so the feed override task can not mix in an old rate
+	taskENTER_CRITICAL();
+	stepper_ctx->move_steps_per_second = with_override ? steps_per_second : 0;
+	set_speed(stepper_ctx, with_override ? scale_feed(steps_per_second, stepper_ctx->feed_override) : steps_per_second);
+	taskEXIT_CRITICAL();
+}
+
+void stepper_set_feed_override(int percent) {
+	taskENTER_CRITICAL();
+	stepper_ctx.feed_override = percent;
+
+	// TIM4 takes the new prescaler and reload with its next update, so the running TIM1 pulse count is not touched.
+	// Gearing sets its own rate in the tachometer interrupt and is never scaled
+	if (stepper_ctx.is_running && stepper_ctx.move_steps_per_second > 0 && stepper_ctx.gear.state == GEAR_IDLE) {
+		set_speed(&stepper_ctx, scale_feed(stepper_ctx.move_steps_per_second, percent));
+	}
+	taskEXIT_CRITICAL();
+}
+
 static int move(StepperContext* stepper_ctx, int argc, char** argv) {
 	if (stepper_ctx->is_powered != 1) {
 		printf("Stepper not powered\r\n");
@@ -505,7 +612,7 @@ static int move(StepperContext* stepper_ctx, int argc, char** argv) {
 		return -1;
 	}
 
-	set_speed(stepper_ctx, steps_per_second);
+	set_move_speed(stepper_ctx, steps_per_second, 1);
 
 	int steps = (position * stepper_ctx->steps_per_turn  * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;
 
@@ -523,6 +630,7 @@ static int move(StepperContext* stepper_ctx, int argc, char** argv) {
 
 	int resulting_steps;
 	L6474_GetAbsolutePosition(stepper_ctx->h, &resulting_steps);
+	stepper_ctx->shadow_position = resulting_steps;
 	resulting_steps += steps;
 
 	if (resulting_steps < stepper_ctx->position_min_steps || resulting_steps > stepper_ctx->position_max_steps) {
@@ -536,12 +644,144 @@ static int move(StepperContext* stepper_ctx, int argc, char** argv) {
 	else {
 		int result = L6474_StepIncremental(stepper_ctx->h, steps);
 
-		while (stepper_ctx->is_running);
+		// the console could execute commands in other tasks, so do not burn the cpu while waiting
+		while (stepper_ctx->is_running) vTaskDelay(1);
 
 		return result;
 	}
 }
 
+static void gear_done(L6474_Handle_t h) {
+	(void)h;
+
+	// called from the timer interrupt when the last pulse is out or the move was canceled
+	stepper_ctx.gear.state = GEAR_IDLE;
+}
+
+static void gear_abort(GearFault_t fault) {
+	stepper_ctx.gear.fault = fault;
+	if (stepper_ctx.gear.state == GEAR_ACTIVE) {
+		StepTimerCancelAsync(NULL);
+	}
+	stepper_ctx.gear.state = GEAR_IDLE;
+}
+
+void stepper_gear_index(uint32_t period_us, int pulses_per_rev) {
+	StepperContext* ctx = &stepper_ctx;
+
+	if (ctx->gear.state == GEAR_IDLE) return;
+
+	// the step timer interrupt has a higher priority, so the move state is only touched with interrupts off
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (period_us == 0) {
+		// no index within the timeout, the spindle stands still or the signal is gone
+		gear_abort(GEAR_SPINDLE_LOST);
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	ctx->gear.indexes += 1;
+	uint32_t feed_per_index = ctx->gear.feed_q16 / (uint32_t)pulses_per_rev;
+
+	int done = 0;
+	if (ctx->gear.state == GEAR_ARMED) {
+		// the feed starts on an index, so every pass of a thread starts at the same spindle angle
+		ctx->gear.target_q16 = 0;
+		ctx->gear.state = GEAR_ACTIVE;
+		StepAsyncTimer(NULL, ctx->gear.dir, ctx->gear.steps, gear_done, ctx->h);
+	}
+	else {
+		done = pulses_done();
+		int error = (int)(ctx->gear.target_q16 >> 16) - done;
+		ctx->gear.error = error;
+		if (abs(error) > ctx->gear.peak_error) ctx->gear.peak_error = abs(error);
+		if (abs(error) > ctx->gear.max_error) {
+			gear_abort(GEAR_ERROR_BOUND);
+			__set_PRIMASK(primask);
+			return;
+		}
+	}
+
+	// the steps up to the next target must be done until the next index, the spindle speed is assumed
+	// to be constant for one index period. This also corrects the error of the last period
+	ctx->gear.target_q16 += feed_per_index;
+	int64_t due_q16 = (int64_t)ctx->gear.target_q16 - ((int64_t)done << 16);
+	int64_t rate = (due_q16 > 0) ? ((due_q16 * 1000000) / period_us) >> 16 : 0;
+	if (rate < GEAR_MIN_RATE) rate = GEAR_MIN_RATE;
+	if (rate > GEAR_MAX_RATE) rate = GEAR_MAX_RATE;
+	if (ctx->gear.state == GEAR_ACTIVE) set_speed(ctx, (int)rate);
+
+	__set_PRIMASK(primask);
+}
+
+static int gear(StepperContext* stepper_ctx, int argc, char** argv) {
+	static const char* const states[] = { "idle", "armed", "active" };
+	static const char* const faults[] = { "none", "error bound", "spindle lost", "canceled" };
+
+	if (argc == 1) {
+		float steps_per_mm = (float)(stepper_ctx->steps_per_turn * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;
+		printf("%s\r\nfault %s\r\nindexes %lu\r\nerror %d\r\npeak %d\r\nfeed ", states[stepper_ctx->gear.state],
+				faults[stepper_ctx->gear.fault], (unsigned long)stepper_ctx->gear.indexes, stepper_ctx->gear.error, stepper_ctx->gear.peak_error);
+		return print_value((float)stepper_ctx->gear.feed_q16 / 65536.0f / steps_per_mm, 4);
+	}
+
+	if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if (stepper_ctx->gear.state != GEAR_IDLE) gear_abort(GEAR_CANCELED);
+		__set_PRIMASK(primask);
+		return 0;
+	}
+
+	if (stepper_ctx->is_powered != 1 || stepper_ctx->is_referenced != 1) {
+		printf("Stepper not powered or not referenced\r\n");
+		return -1;
+	}
+	if (stepper_ctx->is_running) {
+		printf("Stepper is running\r\n");
+		return -1;
+	}
+	if (argc != 3 && !(argc == 5 && strcmp(argv[3], "-e") == 0)) {
+		printf("Invalid number of arguments\r\n");
+		return -1;
+	}
+
+	// feed in mm per spindle revolution, the signed distance sets the direction
+	float feed = (float)atof(argv[1]);
+	float distance = (float)atof(argv[2]);
+	float steps_per_mm = (float)(stepper_ctx->steps_per_turn * stepper_ctx->resolution) / stepper_ctx->mm_per_turn;
+	int steps = (int)(distance * steps_per_mm);
+	int max_error = (argc == 5) ? atoi(argv[4]) : GEAR_DEFAULT_MAX_ERROR;
+
+	if (feed <= 0.0f || abs(steps) < 2 || max_error <= 0) {
+		printf("Invalid feed, distance or error bound\r\n");
+		return -1;
+	}
+
+	int position;
+	L6474_GetAbsolutePosition(stepper_ctx->h, &position);
+	stepper_ctx->shadow_position = position;
+	if (position + steps < stepper_ctx->position_min_steps || position + steps > stepper_ctx->position_max_steps) {
+		printf("Position out of bounds\r\n");
+		return -1;
+	}
+
+	stepper_ctx->gear.dir = (steps > 0);
+	stepper_ctx->gear.steps = abs(steps);
+	stepper_ctx->gear.feed_q16 = (uint32_t)(feed * steps_per_mm * 65536.0f);
+	stepper_ctx->gear.max_error = max_error;
+	stepper_ctx->gear.error = 0;
+	stepper_ctx->gear.peak_error = 0;
+	stepper_ctx->gear.indexes = 0;
+	stepper_ctx->gear.fault = GEAR_OK;
+
+	// from here on the tachometer interrupt owns the feed, the move starts with the next index
+	stepper_ctx->gear.state = GEAR_ARMED;
+	return 0;
+}
+
 static int initialize(StepperContext* stepper_ctx) {
 	reset(stepper_ctx);
 	stepper_ctx->is_powered = 1;
@@ -550,18 +790,45 @@ static int initialize(StepperContext* stepper_ctx) {
 	return L6474_SetPowerOutputs(stepper_ctx->h, 1);
 }
 
+static int stepperCommand(StepperContext* stepper_ctx, int argc, char** argv);
+
 static int stepperConsoleFunction(int argc, char** argv, void* ctx) {
 	StepperContext* stepper_ctx = (StepperContext*)ctx;
+
+	// cancel must always get through, even when a synchronous move holds the lock
+	if (argc > 0 && strcmp(argv[0], "cancel") == 0) {
+		int result = StepTimerCancelAsync(NULL);
+		printf("%s\r\n", (result == 0) ? "OK" : "FAIL");
+		return result;
+	}
+
+	// commands can be executed by several console tasks in pipelined mode
+	xSemaphoreTakeRecursive(stepper_ctx->lock, portMAX_DELAY);
+	int result = stepperCommand(stepper_ctx, argc, argv);
+	xSemaphoreGiveRecursive(stepper_ctx->lock);
+	return result;
+}
+
+static int stepperCommand(StepperContext* stepper_ctx, int argc, char** argv) {
 	int result = 0;
 
 	if (argc == 0) {
 		printf("Invalid number of arguments\r\n");
 		return -1;
 	}
-	if (strcmp(argv[0], "move") == 0 )
+	// while the feed follows the spindle, only the gearing itself and read only commands are accepted
+	if (stepper_ctx->gear.state != GEAR_IDLE && strcmp(argv[0], "gear") != 0 &&
+			strcmp(argv[0], "status") != 0 && strcmp(argv[0], "position") != 0) {
+		printf("Gearing active\r\n");
+		result = -1;
+	}
+	else if (strcmp(argv[0], "move") == 0 )
 	{
 		result = move(stepper_ctx, argc, argv);
 	}
+	else if (strcmp(argv[0], "gear") == 0) {
+		result = gear(stepper_ctx, argc, argv);
+	}
 	else if (strcmp(argv[0], "reset") == 0) {
 		result = reset(stepper_ctx);
 	}
@@ -571,16 +838,13 @@ static int stepperConsoleFunction(int argc, char** argv, void* ctx) {
 	else if (strcmp(argv[0], "reference") == 0) {
 		result = reference(stepper_ctx, argc, argv);
 	}
-	else if (strcmp(argv[0], "cancel") == 0) {
-		result = StepTimerCancelAsync(NULL);
-	}
 	else if (strcmp(argv[0], "init") == 0){
 		result = initialize(stepper_ctx);
 	}
 	else if (strcmp(argv[0], "position") == 0){
 		int position;
 		L6474_GetAbsolutePosition(stepper_ctx->h, &position);
-		printf("%.4f\r\n", (float)(position * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution));
+		result = print_value((float)(position * stepper_ctx->mm_per_turn) / (float)(stepper_ctx->steps_per_turn  * stepper_ctx->resolution), 4);
 	}
 	else if (strcmp(argv[0], "status") == 0){
 		int status;
@@ -628,11 +892,73 @@ static int stepperConsoleFunction(int argc, char** argv, void* ctx) {
 }
 
 L6474x_Platform_t p;
-StepperContext stepper_ctx;
 
-void start_tim1(int pulses) {
+static int pulses_done(void) {
+	// pulses of the finished chunks plus the counter of the running chunk
+	int done = stepper_ctx.move_pulses - stepper_ctx.remaining_pulses - stepper_ctx.chunk_pulses;
+	return done + (int)stepper_ctx.htim1_handle->Instance->CNT;
+}
+
+ITCM_FUNC static void finish_move(int completed) {
+	int done = completed ? stepper_ctx.move_pulses : pulses_done();
+	TRACE(TRACE_MOVE_DONE, completed, done);
+	stepper_ctx.shadow_position += stepper_ctx.move_dir ? done : -done;
+	stepper_ctx.move_pulses = 0;
+	stepper_ctx.chunk_pulses = 0;
+}
+
+int stepper_sample(StepperSample_t* sample, int with_status) {
+	if (sample == NULL) return -1;
+
+	// finish_move and start_tim1 change the counters of the move from the step interrupt, so they are read
+	// together with the timer counter while the interrupts are masked
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	int is_running = stepper_ctx.is_running;
+	int position = stepper_ctx.shadow_position;
+	if (is_running && stepper_ctx.move_pulses != 0) {
+		int done = pulses_done();
+		position += stepper_ctx.move_dir ? done : -done;
+	}
+	__set_PRIMASK(primask);
+
+	sample->position = position;
+	sample->steps_per_second = is_running ? stepper_ctx.steps_per_second : 0;
+	sample->is_running = is_running;
+
+	// the driver status needs SPI, so it is skipped while a command owns the stepper
+	if (with_status && xSemaphoreTakeRecursive(stepper_ctx.lock, 0) == pdTRUE) {
+		L6474_Status_t status_struct;
+		if (L6474_GetStatus(stepper_ctx.h, &status_struct) == 0) {
+			int out_status = 0;
+			out_status |= (status_struct.DIR << 0);
+			out_status |= (status_struct.HIGHZ << 1);
+			out_status |= (status_struct.NOTPERF_CMD << 2);
+			out_status |= (status_struct.OCD << 3);
+			out_status |= (status_struct.ONGOING << 4);
+			out_status |= (status_struct.TH_SD << 5);
+			out_status |= (status_struct.TH_WARN << 6);
+			out_status |= (status_struct.UVLO << 7);
+			out_status |= (status_struct.WRONG_CMD << 8);
+			sample->status = out_status;
+		}
+		xSemaphoreGiveRecursive(stepper_ctx.lock);
+		return 0;
+	}
+	return (with_status) ? 1 : 0;
+}
+
+float stepper_position_mm(void) {
+	StepperSample_t sample;
+	stepper_sample(&sample, 0);
+	return (float)sample.position * stepper_ctx.mm_per_turn / (float)(stepper_ctx.steps_per_turn * stepper_ctx.resolution);
+}
+
+ITCM_FUNC void start_tim1(int pulses) {
 	int current_pulses = (pulses >= 65535) ? 65535 : pulses;
 	stepper_ctx.remaining_pulses = pulses - current_pulses;
+	stepper_ctx.chunk_pulses = current_pulses;
+	TRACE(TRACE_MOVE_SEGMENT, 0, current_pulses);
 
 	if (current_pulses != 1) {
 		HAL_TIM_OnePulse_Stop_IT(stepper_ctx.htim1_handle, TIM_CHANNEL_1);
@@ -647,24 +973,56 @@ void start_tim1(int pulses) {
 }
 
 
-void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef* htim) {
+ITCM_FUNC void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef* htim) {
+	// the HAL reports compare events of the tachometer timer here as well
+	if (htim->Instance != stepper_ctx.htim1_handle->Instance) return;
+
 	if ((stepper_ctx.done_callback != 0) && ((htim->Instance->SR & (1 << 2)) == 0)) {
+		TRACE(TRACE_STEP_ISR, 0, stepper_ctx.remaining_pulses);
 		if (stepper_ctx.remaining_pulses > 0) {
 			start_tim1(stepper_ctx.remaining_pulses);
 		}
 		else {
+			finish_move(1);
 			stepper_ctx.done_callback(stepper_ctx.h);
 			stepper_ctx.is_running = 0;
 		}
 	}
 }
 
+// replaces HAL_TIM_IRQHandler for TIM1, which walks every flag of the timer. The step output only enables the compare
+// interrupts of CH1 and CH2 (HAL_TIM_OnePulse_Start_IT), both are output compares and HAL_TIM_OC_DelayElapsedCallback
+// only serves TIM5, so the pulse finished callback follows directly, in the order of the HAL
+ITCM_FUNC void stepper_tim1_irq(TIM_HandleTypeDef* htim) {
+	uint32_t pending = htim->Instance->SR & htim->Instance->DIER & 0xFFU;
+
+	if (pending & TIM_FLAG_CC1) {
+		__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_CC1);
+		htim->Channel = HAL_TIM_ACTIVE_CHANNEL_1;
+		HAL_TIM_PWM_PulseFinishedCallback(htim);
+		htim->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+	}
+	if (pending & TIM_FLAG_CC2) {
+		__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_CC2);
+		htim->Channel = HAL_TIM_ACTIVE_CHANNEL_2;
+		HAL_TIM_PWM_PulseFinishedCallback(htim);
+		htim->Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+	}
+
+	// no other source is enabled, an unexpected one must not retrigger the interrupt forever
+	pending &= ~(TIM_FLAG_CC1 | TIM_FLAG_CC2);
+	if (pending != 0) __HAL_TIM_CLEAR_FLAG(htim, pending);
+}
+
 static int StepAsyncTimer(void* pPWM, int dir, unsigned int numPulses, void (*doneClb)(L6474_Handle_t), L6474_Handle_t h) {
 	(void)pPWM;
 	(void)h;
 
 	stepper_ctx.is_running = 1;
 	stepper_ctx.done_callback = doneClb;
+	stepper_ctx.move_pulses = numPulses;
+	stepper_ctx.move_dir = !!dir;
+	TRACE(TRACE_MOVE_START, !!dir, numPulses);
 
 	HAL_GPIO_WritePin(STEP_DIR_GPIO_Port, STEP_DIR_Pin, !!dir);
 
@@ -683,6 +1041,7 @@ static int StepTimerCancelAsync(void* pPWM)
 
 	if (stepper_ctx.is_running) {
 		HAL_TIM_OnePulse_Stop_IT(stepper_ctx.htim1_handle, TIM_CHANNEL_1);
+		finish_move(0);
 		stepper_ctx.done_callback(stepper_ctx.h);
 		stepper_ctx.is_running = 0;
 	}
@@ -702,7 +1061,13 @@ void init_stepper(ConsoleHandle_t console_handle, SPI_HandleTypeDef* hspi1, TIM_
 	p.stepAsync  = StepAsyncTimer;
 	p.cancelStep = StepTimerCancelAsync;
 
+#if configSUPPORT_STATIC_ALLOCATION
+	stepper_ctx.h = L6474_CreateStaticInstance(&p, hspi1, NULL, tim1_handle, &stepper_handle_buffer);
+	stepper_ctx.lock = xSemaphoreCreateRecursiveMutexStatic(&stepper_lock_buffer);
+#else
 	stepper_ctx.h = L6474_CreateInstance(&p, hspi1, NULL, tim1_handle);
+	stepper_ctx.lock = xSemaphoreCreateRecursiveMutex();
+#endif
 	stepper_ctx.htim1_handle = tim1_handle;
 	stepper_ctx.htim4_handle = tim4_handle;
 
@@ -713,6 +1078,11 @@ void init_stepper(ConsoleHandle_t console_handle, SPI_HandleTypeDef* hspi1, TIM_
 	stepper_ctx.position_min_steps = 0;
 	stepper_ctx.position_max_steps = 100000;
 	stepper_ctx.position_ref_steps = 0;
+	stepper_ctx.feed_override = 100;
+
+	stepper_ctx.gear.state = GEAR_IDLE;
 
 	CONSOLE_RegisterCommand(console_handle, "stepper", "Stepper main Command", stepperConsoleFunction, &stepper_ctx);
+	// the lock serializes the stepper commands, so a move in a pipeline worker does not block the other commands
+	CONSOLE_SetCommandConcurrent(console_handle, "stepper");
 }
@@ -0,0 +1,269 @@
+/*
+ * telemetry.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stdio.h"
+#include "stdint.h"
+#include "string.h"
+#include "stdlib.h"
+#include "Console.h"
+#include "Spindle.h"
+#include "main.h"
+#include "init.h"
+
+#define TELEMETRY_STACK_SIZE (2 * configMINIMAL_STACK_SIZE)
+#define TELEMETRY_PRIORITY (tskIDLE_PRIORITY + 1)
+#define TELEMETRY_MAX_RATE ((int)configTICK_RATE_HZ)
+
+// sync bytes of a binary record, followed by length, channel mask, sequence, ticks, dropped and the values
+#define TELEMETRY_SYNC_0 0xA5
+#define TELEMETRY_SYNC_1 0x5A
+
+typedef enum {
+	tchPOSITION = 0x01,
+	tchRATE     = 0x02,
+	tchRUNNING  = 0x04,
+	tchSTATUS   = 0x08,
+	tchSPINDLE  = 0x10,
+	tchCURRENT  = 0x20,
+	tchALL      = 0x3F
+} TelemetryChannel_t;
+
+static const struct {
+	const char* name;
+	int channel;
+} channel_names[] = {
+	{ "pos",     tchPOSITION },
+	{ "rate",    tchRATE },
+	{ "run",     tchRUNNING },
+	{ "status",  tchSTATUS },
+	{ "spindle", tchSPINDLE },
+	{ "current", tchCURRENT },
+	{ "all",     tchALL },
+};
+
+typedef struct {
+	TaskHandle_t task;
+	SpindleHandle_t spindle;
+	volatile int active;
+	volatile int restart;
+	int channels;
+	int rate;
+	int binary;
+	TickType_t period;
+	uint32_t sequence;
+	volatile uint32_t dropped;
+	StepperSample_t sample;
+} TelemetryContext;
+
+static TelemetryContext telemetry_ctx;
+
+#if configSUPPORT_STATIC_ALLOCATION
+static StaticTask_t telemetry_tcb;
+static StackType_t telemetry_stack[TELEMETRY_STACK_SIZE];
+#endif
+
+static int put_int32(char* buffer, int32_t value) {
+	// binary records are always little endian, independent of the platform
+	buffer[0] = (char)(value & 0xFF);
+	buffer[1] = (char)((value >> 8) & 0xFF);
+	buffer[2] = (char)((value >> 16) & 0xFF);
+	buffer[3] = (char)((value >> 24) & 0xFF);
+	return 4;
+}
+
+static int put_csv(char* buffer, int size, long value) {
+	buffer[0] = ',';
+	int length = CONSOLE_FormatInt(&buffer[1], size - 1, value);
+	return (length < 0) ? 0 : length + 1;
+}
+
+static int sample_values(TelemetryContext* ctx, int channels, int32_t* values) {
+	int num = 0;
+
+	stepper_sample(&ctx->sample, channels & tchSTATUS);
+
+	if (channels & tchPOSITION) values[num++] = ctx->sample.position;
+	if (channels & tchRATE)     values[num++] = ctx->sample.steps_per_second;
+	if (channels & tchRUNNING)  values[num++] = ctx->sample.is_running;
+	if (channels & tchSTATUS)   values[num++] = ctx->sample.status;
+	if (channels & tchSPINDLE) {
+		float speed = 0.0f;
+		SPINDLE_GetStatus(ctx->spindle, NULL, &speed);
+		values[num++] = (int32_t)speed;
+	}
+	if (channels & tchCURRENT) values[num++] = spindle_current_ma();
+	return num;
+}
+
+static void emit_record(TelemetryContext* ctx, int channels, int binary) {
+	char record[96];
+	int32_t values[6];
+	int length = 0;
+
+	int num = sample_values(ctx, channels, values);
+	uint32_t ticks = xTaskGetTickCount();
+
+	if (binary) {
+		record[length++] = (char)TELEMETRY_SYNC_0;
+		record[length++] = (char)TELEMETRY_SYNC_1;
+		record[length++] = (char)(13 + 4 * num);
+		record[length++] = (char)channels;
+		length += put_int32(&record[length], (int32_t)ctx->sequence);
+		length += put_int32(&record[length], (int32_t)ticks);
+		length += put_int32(&record[length], (int32_t)ctx->dropped);
+		for (int i = 0; i < num; i++) length += put_int32(&record[length], values[i]);
+
+		// simple additive checksum over everything behind the sync bytes
+		uint8_t checksum = 0;
+		for (int i = 2; i < length; i++) checksum += (uint8_t)record[i];
+		record[length++] = (char)checksum;
+	}
+	else {
+		// CSV line: $T,sequence,ticks,dropped,values...
+		record[length++] = '$';
+		record[length++] = 'T';
+		length += put_csv(&record[length], sizeof(record) - length, (long)ctx->sequence);
+		length += put_csv(&record[length], sizeof(record) - length, (long)ticks);
+		length += put_csv(&record[length], sizeof(record) - length, (long)ctx->dropped);
+		for (int i = 0; i < num; i++) length += put_csv(&record[length], sizeof(record) - length, values[i]);
+		record[length++] = '\r';
+		record[length++] = '\n';
+	}
+
+	// one write per record, so the record is not torn by other outputs of the same stream
+	fwrite(record, 1, length, stdout);
+	fflush(stdout);
+	ctx->sequence += 1;
+}
+
+static void TelemetryFunction(void* arg) {
+	TelemetryContext* ctx = (TelemetryContext*)arg;
+	TickType_t last_wake = xTaskGetTickCount();
+
+	while (1) {
+		if (!ctx->active) {
+			// sleep until the stream command starts the next stream
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			last_wake = xTaskGetTickCount();
+			continue;
+		}
+
+		// the stream command runs with a higher priority, so the settings are copied once per record and the mask
+		// of a record always matches its values
+		taskENTER_CRITICAL();
+		int channels = ctx->channels;
+		int binary = ctx->binary;
+		TickType_t period = ctx->period;
+		if (ctx->restart) {
+			ctx->restart = 0;
+			ctx->sequence = 0;
+			ctx->dropped = 0;
+			ctx->sample.status = 0;
+		}
+		taskEXIT_CRITICAL();
+
+		emit_record(ctx, channels, binary);
+
+		if (xTaskDelayUntil(&last_wake, period) == pdFALSE) {
+			// the link is saturated or the task has been blocked, so all periods which
+			// have been missed completely are counted as dropped samples
+			TickType_t behind = xTaskGetTickCount() - last_wake;
+			uint32_t missed = behind / period;
+			ctx->dropped += missed;
+			last_wake += missed * period;
+		}
+	}
+}
+
+static int parse_channels(char* list) {
+	int channels = 0;
+	char* save = NULL;
+
+	for (char* name = strtok_r(list, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+		int found = 0;
+		for (unsigned int i = 0; i < sizeof(channel_names) / sizeof(*channel_names); i++) {
+			if (strcmp(name, channel_names[i].name) == 0) {
+				channels |= channel_names[i].channel;
+				found = 1;
+				break;
+			}
+		}
+		if (!found) return -1;
+	}
+	return channels;
+}
+
+static int streamConsoleFunction(int argc, char** argv, void* ctx) {
+	TelemetryContext* telemetry = (TelemetryContext*)ctx;
+
+	if (argc == 0) {
+		printf("%s, channels 0x%x, rate %d, sent %lu, dropped %lu\r\nOK\r\n", telemetry->active ? "on" : "off",
+				telemetry->channels, telemetry->rate, (unsigned long)telemetry->sequence, (unsigned long)telemetry->dropped);
+		return 0;
+	}
+
+	if (argc == 1 && strcmp(argv[0], "stop") == 0) {
+		telemetry->active = 0;
+		printf("OK\r\n");
+		return 0;
+	}
+
+	if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "-b") != 0)) {
+		printf("Invalid number of arguments\r\nFAIL\r\n");
+		return -1;
+	}
+
+	int channels = parse_channels(argv[0]);
+	int rate = atoi(argv[1]);
+	if (channels <= 0) {
+		printf("Invalid channel\r\nFAIL\r\n");
+		return -1;
+	}
+	if (rate < 1 || rate > TELEMETRY_MAX_RATE) {
+		printf("Invalid rate\r\nFAIL\r\n");
+		return -1;
+	}
+
+	if (telemetry->task == NULL) {
+#if configSUPPORT_STATIC_ALLOCATION
+		telemetry->task = xTaskCreateStatic(TelemetryFunction, "telemetry", TELEMETRY_STACK_SIZE, telemetry, TELEMETRY_PRIORITY, telemetry_stack, &telemetry_tcb);
+		if (telemetry->task == NULL) {
+#else
+		if (xTaskCreate(TelemetryFunction, "telemetry", TELEMETRY_STACK_SIZE, telemetry, TELEMETRY_PRIORITY, &telemetry->task) != pdPASS) {
+#endif
+			telemetry->task = NULL;
+			printf("Could not create telemetry task\r\nFAIL\r\n");
+			return -1;
+		}
+	}
+
+	// the task may be in the middle of a record, it takes the new settings with the next one and restarts the
+	// sequence itself
+	taskENTER_CRITICAL();
+	telemetry->channels = channels;
+	telemetry->rate = rate;
+	telemetry->binary = (argc == 3);
+	telemetry->period = (configTICK_RATE_HZ / rate > 0) ? (configTICK_RATE_HZ / rate) : 1;
+	telemetry->restart = 1;
+	telemetry->active = 1;
+	taskEXIT_CRITICAL();
+	xTaskNotifyGive(telemetry->task);
+
+	printf("OK\r\n");
+	return 0;
+}
+
+void init_telemetry(ConsoleHandle_t console_handle, SpindleHandle_t spindle_handle) {
+	memset(&telemetry_ctx, 0, sizeof(telemetry_ctx));
+	telemetry_ctx.spindle = spindle_handle;
+
+	CONSOLE_RegisterCommand(console_handle, "stream", "<<stream ch1,ch2 rate [-b]>> streams periodic samples until <<stream stop>>.\r\n"
+			"Channels are pos, rate, run, status, spindle, current (mA, -1 when not sensed) or all, the rate is in Hz.\r\n"
+			"Records are CSV lines $T,seq,ticks,dropped,values or binary with -b.",
+			streamConsoleFunction, &telemetry_ctx);
+}
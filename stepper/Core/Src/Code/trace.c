@@ -0,0 +1,207 @@
+/*
+ * trace.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: es23018
+ */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stdio.h"
+#include "stdint.h"
+#include "string.h"
+#include "Console.h"
+#include "main.h"
+#include "init.h"
+#include "perf.h"
+#include "trace.h"
+#include "tcm.h"
+
+// sync bytes of a binary record, followed by time, event, arg, value and the checksum
+#define TRACE_SYNC_0 0xA5
+#define TRACE_SYNC_1 0x7E
+
+#if (TRACE_EVENTS & (TRACE_EVENTS - 1)) != 0
+#error "TRACE_EVENTS must be a power of two"
+#endif
+
+#define EVENT_BIT(event) (1UL << (event))
+#define TRACE_ALL (EVENT_BIT(TRACE_EVENT_TYPES) - 2)   // the events start at 1
+
+// the groups of events which "trace on" takes, one bit per event
+static const struct {
+	const char* name;
+	uint32_t events;
+} group_names[] = {
+	{ "stepper", EVENT_BIT(TRACE_MOVE_START) | EVENT_BIT(TRACE_MOVE_SEGMENT) | EVENT_BIT(TRACE_MOVE_DONE) |
+		EVENT_BIT(TRACE_STEP_ISR) },
+	{ "spi",     EVENT_BIT(TRACE_SPI_BEGIN) | EVENT_BIT(TRACE_SPI_END) },
+	{ "queue",   EVENT_BIT(TRACE_QUEUE_SEND) | EVENT_BIT(TRACE_QUEUE_RECEIVE) },
+	{ "task",    EVENT_BIT(TRACE_TASK_SWITCH) },
+	{ "cmd",     EVENT_BIT(TRACE_CMD_BEGIN) | EVENT_BIT(TRACE_CMD_END) },
+	{ "all",     TRACE_ALL },
+};
+
+// The ring is a flight recorder: every event claims the next slot with an atomic increment, which is a LDREX/STREX
+// loop on the M7, and overwrites the oldest record. An interrupt between the claim and the write of a task leaves
+// two records whose times are not in the order of their slots, the timeline tool sorts them by time. The time is
+// the 64 bit run time counter, so sparse events of a group stay correct over any number of wraps of the cycle counter.
+static TraceRecord_t trace_ring[TRACE_EVENTS];
+static volatile uint32_t trace_head;        // number of events since the last clear
+static volatile uint32_t trace_recording;  // events which are recorded, nothing until "trace on"
+
+#if TRACE_ENABLE
+ITCM_FUNC void trace_event(TraceEvent_t event, uint16_t arg, uint32_t value) {
+	if ((trace_recording & EVENT_BIT(event)) == 0) return;
+
+	uint32_t index = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+	TraceRecord_t* record = &trace_ring[index & (TRACE_EVENTS - 1)];
+	record->time = PERF_RUN_TIME();
+	record->event = (uint16_t)event;
+	record->arg = arg;
+	record->value = value;
+}
+
+ITCM_FUNC uint32_t trace_pack(const char* text, int length) {
+	uint32_t value = 0;
+	for (int i = 0; i < length && i < 4 && text[i] != '\0'; i++) {
+		value |= (uint32_t)(uint8_t)text[i] << (8 * i);
+	}
+	return value;
+}
+#endif
+
+// called by the context switch, which runs from the ITCM as well
+ITCM_FUNC void trace_task_switched_in(uint32_t number, const char* name) {
+	(void)number;
+	(void)name;
+	TRACE(TRACE_TASK_SWITCH, number, trace_pack(name, configMAX_TASK_NAME_LEN));
+}
+
+void trace_queue(int receive, const void* queue, uint8_t type, int from_isr) {
+	(void)receive;
+	(void)queue;
+	(void)type;
+	(void)from_isr;
+	TRACE(receive ? TRACE_QUEUE_RECEIVE : TRACE_QUEUE_SEND, type | (from_isr ? 0x100 : 0), (uintptr_t)queue);
+}
+
+static int put_uint32(char* buffer, uint32_t value) {
+	// binary records are always little endian, independent of the platform
+	buffer[0] = (char)(value & 0xFF);
+	buffer[1] = (char)((value >> 8) & 0xFF);
+	buffer[2] = (char)((value >> 16) & 0xFF);
+	buffer[3] = (char)((value >> 24) & 0xFF);
+	return 4;
+}
+
+static int put_uint64(char* buffer, uint64_t value) {
+	put_uint32(buffer, (uint32_t)value);
+	return 4 + put_uint32(&buffer[4], (uint32_t)(value >> 32));
+}
+
+static void dump(int binary) {
+	// the dump itself must not be recorded, the records stay as they are until recording is switched on again
+	uint32_t recording = trace_recording;
+	trace_recording = 0;
+
+	uint32_t head = trace_head;
+	uint32_t count = (head > TRACE_EVENTS) ? TRACE_EVENTS : head;
+
+	// $H,clock,events,records: the oldest records are lost when there were more events than records
+	printf("$H,%lu,%lu,%lu\r\n", (unsigned long)SystemCoreClock, (unsigned long)head, (unsigned long)count);
+
+	for (uint32_t i = head - count; i != head; i++) {
+		const TraceRecord_t* record = &trace_ring[i & (TRACE_EVENTS - 1)];
+
+		if (binary) {
+			char buffer[19];
+			int length = 0;
+			buffer[length++] = (char)TRACE_SYNC_0;
+			buffer[length++] = (char)TRACE_SYNC_1;
+			length += put_uint64(&buffer[length], record->time);
+			buffer[length++] = (char)(record->event & 0xFF);
+			buffer[length++] = (char)(record->event >> 8);
+			buffer[length++] = (char)(record->arg & 0xFF);
+			buffer[length++] = (char)(record->arg >> 8);
+			length += put_uint32(&buffer[length], record->value);
+
+			// simple additive checksum over everything behind the sync bytes
+			uint8_t checksum = 0;
+			for (int j = 2; j < length; j++) checksum += (uint8_t)buffer[j];
+			buffer[length++] = (char)checksum;
+
+			fwrite(buffer, 1, length, stdout);
+		}
+		else {
+			// $E,time,event,arg,value, nano printf has no %llu
+			char time[24];
+			CONSOLE_FormatU64(time, sizeof(time), record->time);
+			printf("$E,%s,%u,%u,%lu\r\n", time, (unsigned)record->event, (unsigned)record->arg,
+				(unsigned long)record->value);
+		}
+	}
+	if (binary) printf("\r\n");
+
+	trace_recording = recording;
+}
+
+static int TraceFunc(int argc, char** argv, void* ctx) {
+	(void)ctx;
+
+	if (argc == 0) {
+		uint32_t head = trace_head;
+		printf("recording 0x%04lx\r\nevents %lu\r\nrecords %lu\r\nOK", (unsigned long)trace_recording,
+			(unsigned long)head, (unsigned long)((head > TRACE_EVENTS) ? TRACE_EVENTS : head));
+		return 0;
+	}
+
+	if (argc >= 1 && strcmp(argv[0], "on") == 0) {
+		// the ring fills up with context switches within a second, the groups keep the rest longer
+		uint32_t events = (argc == 1) ? TRACE_ALL : 0;
+		for (int i = 1; i < argc; i++) {
+			int found = 0;
+			for (size_t j = 0; j < sizeof(group_names) / sizeof(group_names[0]); j++) {
+				if (strcmp(argv[i], group_names[j].name) == 0) {
+					events |= group_names[j].events;
+					found = 1;
+				}
+			}
+			if (!found) {
+				printf("Invalid event group %s\r\nFAIL", argv[i]);
+				return -1;
+			}
+		}
+		trace_recording = TRACE_ENABLE ? events : 0;
+	}
+	else if (argc == 1 && strcmp(argv[0], "off") == 0) {
+		trace_recording = 0;
+	}
+	else if (argc == 1 && strcmp(argv[0], "clear") == 0) {
+		uint32_t recording = trace_recording;
+		trace_recording = 0;
+		trace_head = 0;
+		trace_recording = recording;
+	}
+	else if (argc == 1 && strcmp(argv[0], "dump") == 0) {
+		dump(0);
+	}
+	else if (argc == 2 && strcmp(argv[0], "dump") == 0 && strcmp(argv[1], "-b") == 0) {
+		dump(1);
+	}
+	else {
+		printf("Invalid arguments\r\nFAIL");
+		return -1;
+	}
+
+	printf("OK");
+	return 0;
+}
+
+void init_trace(ConsoleHandle_t console_handle) {
+	// every hook pays for the recorder while it records, so it stays off until it is asked for
+	trace_recording = 0;
+	CONSOLE_RegisterCommand(console_handle, "trace",
+		"<on [stepper|spi|queue|task|cmd|all ...]|off|clear|dump [-b]> records the events of the groups in a RAM ring. "
+		"The dump has a header $H,clock,events,records and CSV lines $E,time,event,arg,value or binary records with -b.",
+		TraceFunc, NULL);
+}
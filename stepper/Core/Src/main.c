@@ -24,6 +24,7 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "stdio.h"
+#include "perf.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -91,6 +92,36 @@ void vApplicationStackOverflowHook( TaskHandle_t pxTask, char *pcTaskName )
 /* USER CODE BEGIN 0 */
 // --------------------------------------------------------------------------------------------------------------------
 
+// start of the DMA_BUFFER block (tcm.h), see the linker scripts
+extern uint8_t _sdma_buffer[];
+
+static void MPU_ConfigDmaBuffer(void)
+{
+  // the flash build has the DMA buffers in the DTCM, which the D-cache does not cover. The RAM build runs its code
+  // from there, so its linker script aligns them to a 1K block in the SRAM and this block must not be cached
+  if ((uint32_t)_sdma_buffer < SRAM1_BASE) return;
+
+  MPU_Region_InitTypeDef MPU_InitStruct = {0};
+
+  HAL_MPU_Disable();
+
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER2;
+  MPU_InitStruct.BaseAddress = (uint32_t)_sdma_buffer;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_1KB;
+  MPU_InitStruct.SubRegionDisable = 0x0;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_SHAREABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+  HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+
 //static int ConsoleWriteStream_ToStdErr(void* pContext, const char* pBuffer, int num)
 //{
 //	(void)pContext;
@@ -119,6 +150,15 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  // the hot interrupt code runs from the ITCM and the DMA buffers are in the DTCM (see tcm.h), which are not
+  // cached, so the caches need no maintenance for them. Only the RAM build needs a non-cacheable region
+  MPU_ConfigDmaBuffer();
+#if (__ICACHE_PRESENT == 1U)
+  SCB_EnableICache();
+#endif
+#if (__DCACHE_PRESENT == 1U)
+  if ((SCB->CCR & SCB_CCR_DC_Msk) == 0) SCB_EnableDCache();
+#endif
 
   /* USER CODE END Init */
 
@@ -612,10 +652,12 @@ volatile uint32_t ulSetToNonZeroInDebuggerToContinue = 0;
 
 int __stdout_put_char(int ch)
 {
+	PERF_ENTER();
 	uint8_t val = ch;
 	while((huart3.Instance->ISR & UART_FLAG_TXE) == 0);
 	huart3.Instance->TDR = val;
 	while((huart3.Instance->ISR & UART_FLAG_TC) == 0);
+	PERF_EXIT_TASK(PERF_UART_TX);
 	return 0;
 }
 
@@ -11,6 +11,7 @@
  * \author Dave Nadler
  * \author Thorsten Kimmel
  * \date 20-August-2019
+ * \version 19-Oct-2026 pvPortMalloc/vPortFree take the fixed-block pools of mempool.c
  * \version 02-Dec-2021 implemented syscalls for stdlib
  * \version 27-Jun-2020 Correct "FreeRTOS.h" capitalization, commentary
  * \version 24-Jun-2020 commentary only
@@ -77,6 +78,7 @@
 #include <newlib.h>
 #include <malloc.h>
 #include <FreeRTOS.h>
+#include "mempool.h"
 
 /*!
  * In case there is a FreeRTOS used for this application, we have to include
@@ -824,7 +826,11 @@ __attribute__( ( weak ) ) void __env_unlock( void )
 void* pvPortMalloc( size_t xSize )
 // ----------------------------------------------------------------------------
 {
+#if MEMPOOL_FOR_KERNEL
+    void* p = mempool_alloc( xSize );
+#else
     void* p = malloc( xSize );
+#endif
     return p;
 }
 
@@ -832,7 +838,11 @@ void* pvPortMalloc( size_t xSize )
 void vPortFree( void* pv )
 // ----------------------------------------------------------------------------
 {
+#if MEMPOOL_FOR_KERNEL
+    mempool_free( pv );
+#else
     free( pv );
+#endif
 }
 
 // ----------------------------------------------------------------------------
@@ -22,6 +22,8 @@
 #include "stm32f7xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "perf.h"
+#include "tcm.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,6 +48,10 @@
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
+/* the step interrupt chain and the tick run from the ITCM */
+void SysTick_Handler(void) ITCM_FUNC;
+void TIM1_UP_TIM10_IRQHandler(void) ITCM_FUNC;
+void TIM1_CC_IRQHandler(void) ITCM_FUNC;
 
 /* USER CODE END PFP */
 
@@ -58,6 +64,10 @@
 extern SPI_HandleTypeDef hspi1;
 extern TIM_HandleTypeDef htim1;
 /* USER CODE BEGIN EV */
+extern TIM_HandleTypeDef htim5;
+extern DMA_HandleTypeDef hdma_adc1;
+void SPINDLE_OvercurrentIRQHandler(void);
+void stepper_tim1_irq(TIM_HandleTypeDef* htim);
 
 /* USER CODE END EV */
 
@@ -194,10 +204,15 @@ void SysTick_Handler(void)
 void SysTick_Handler(void)
 {
   extern void xPortSysTickHandler( void );
+  PERF_SYSTICK_LATENCY();
+  PERF_ENTER();
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
   xPortSysTickHandler();
+  /* the wraps of the cycle counter are only seen when it is read at least once per wrap */
+  (void)getRunTimeCounterValue();
+  PERF_EXIT(PERF_SYSTICK);
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -209,47 +224,65 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /**
-  * @brief This function handles TIM1 update interrupt and TIM10 global interrupt.
+  * @brief This function handles SPI1 global interrupt.
   */
-void TIM1_UP_TIM10_IRQHandler(void)
+void SPI1_IRQHandler(void)
 {
-  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 0 */
+  /* USER CODE BEGIN SPI1_IRQn 0 */
+  PERF_ENTER();
+  /* USER CODE END SPI1_IRQn 0 */
+  HAL_SPI_IRQHandler(&hspi1);
+  /* USER CODE BEGIN SPI1_IRQn 1 */
+  PERF_EXIT(PERF_SPI1);
+  /* USER CODE END SPI1_IRQn 1 */
+}
 
-  /* USER CODE END TIM1_UP_TIM10_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim1);
-  /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 1 */
+/* USER CODE BEGIN 1 */
 
-  /* USER CODE END TIM1_UP_TIM10_IRQn 1 */
+/**
+  * @brief This function handles TIM1 update interrupt and TIM10 global interrupt.
+  * The handler is not generated (see stepper.ioc), the one of the step timer replaces the generic one of the HAL.
+  */
+void TIM1_UP_TIM10_IRQHandler(void)
+{
+  PERF_ENTER();
+  /* TIM10 is not used */
+  stepper_tim1_irq(&htim1);
+  PERF_EXIT(PERF_TIM1_UP);
 }
 
 /**
-  * @brief This function handles TIM1 capture compare interrupt.
+  * @brief This function handles TIM1 capture compare interrupt, not generated as well.
   */
 void TIM1_CC_IRQHandler(void)
 {
-  /* USER CODE BEGIN TIM1_CC_IRQn 0 */
-
-  /* USER CODE END TIM1_CC_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim1);
-  /* USER CODE BEGIN TIM1_CC_IRQn 1 */
-
-  /* USER CODE END TIM1_CC_IRQn 1 */
+  PERF_ENTER();
+  stepper_tim1_irq(&htim1);
+  PERF_EXIT(PERF_TIM1_CC);
 }
 
 /**
-  * @brief This function handles SPI1 global interrupt.
+  * @brief This function handles TIM5 global interrupt (spindle tachometer).
   */
-void SPI1_IRQHandler(void)
+void TIM5_IRQHandler(void)
 {
-  /* USER CODE BEGIN SPI1_IRQn 0 */
-
-  /* USER CODE END SPI1_IRQn 0 */
-  HAL_SPI_IRQHandler(&hspi1);
-  /* USER CODE BEGIN SPI1_IRQn 1 */
+  HAL_TIM_IRQHandler(&htim5);
+}
 
-  /* USER CODE END SPI1_IRQn 1 */
+/**
+  * @brief This function handles ADC1 global interrupt (spindle overcurrent watchdog).
+  */
+void ADC_IRQHandler(void)
+{
+  SPINDLE_OvercurrentIRQHandler();
 }
 
-/* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (spindle current samples).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_adc1);
+}
 
 /* USER CODE END 1 */
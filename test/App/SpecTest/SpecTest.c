@@ -0,0 +1,805 @@
+
+// --------------------------------------------------------------------------------------------------------------------
+// Conformance and latency test of the console interface against spec/Interfacespezifikation.pdf
+//
+// The runner talks to the console over a pseudo terminal of the simulator or over the serial port of a board and
+// runs every command of the spec for which the capability bitfield reports an implementation. It checks the output
+// format of the spec, the values on separate lines closed by OK or FAIL, the types of the values and the result of
+// the command. Deviations from the state machine and from the values which the spec describes are reported as
+// warnings, with -S they fail the run as well.
+//
+// The time from the end of the command line to the OK or FAIL line is the latency of a command. After the
+// conformance run the queries are repeated to get the p50 and p99 of every command, which can be written to a csv
+// file and compared to a baseline.
+// --------------------------------------------------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+#define MAX_LINES        16
+#define MAX_LINE         256
+#define MAX_COMMANDS     64
+#define MAX_SAMPLES      1024
+#define PROMPT           "$>"
+#define SLACK_MS         1.0
+
+// bits of the capability command, counted from the left of its output
+enum
+{
+    CAP_HAS_SPINDLE, CAP_HAS_SPINDLE_STATUS, CAP_HAS_STEPPER, CAP_HAS_STEPPER_MOVE_RELA, CAP_HAS_STEPPER_MOVE_SPEED,
+    CAP_HAS_STEPPER_MOVE_ASYNC, CAP_HAS_STEPPER_STATUS, CAP_HAS_STEPPER_REFRUN, CAP_HAS_STEPPER_REFRUN_TMOUT,
+    CAP_HAS_STEPPER_REFRUN_SKIP, CAP_HAS_STEPPER_REFRUN_ENABLED, CAP_HAS_STEPPER_RESET, CAP_HAS_STEPPER_POSITION,
+    CAP_HAS_STEPPER_CONFIG, CAP_HAS_STEPPER_CONFIG_TORQUE, CAP_HAS_STEPPER_CONFIG_THROVERCURR,
+    CAP_HAS_STEPPER_CONFIG_POWERENA, CAP_HAS_STEPPER_CONFIG_STEPMODE, CAP_HAS_STEPPER_CONFIG_TIMEOFF,
+    CAP_HAS_STEPPER_CONFIG_TIMEON, CAP_HAS_STEPPER_CONFIG_TIMEFAST, CAP_HAS_STEPPER_CONFIG_MMPERTURN,
+    CAP_HAS_STEPPER_CONFIG_POSMAX, CAP_HAS_STEPPER_CONFIG_POSMIN, CAP_HAS_STEPPER_CONFIG_POSREF,
+    CAP_HAS_STEPPER_CONFIG_STEPSPERTURN, CAP_HAS_STEPPER_CANCEL, CAP_COUNT
+};
+
+// states of the stepper state machine
+enum { scsINIT = 0x0, scsREF = 0x1, scsDIS = 0x2, scsENA = 0x4, scsFLT = 0x8 };
+
+// --------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+    int ok;                         // the last line was OK
+    int count;
+    char lines[MAX_LINES][MAX_LINE];
+} Response_t;
+
+typedef struct
+{
+    char command[MAX_LINE];
+    int count;
+    double ms[MAX_SAMPLES];
+} Latency_t;
+
+// --------------------------------------------------------------------------------------------------------------------
+static int fd = -1;
+static pid_t simulator = 0;
+static int caps[CAP_COUNT];
+static int strict = 0;
+static int verbose = 0;
+static double timeoutMs = 10000.0;
+static int passed, failed, warned, skipped;
+static Latency_t latencies[MAX_COMMANDS];
+static int latencyCount;
+
+// --------------------------------------------------------------------------------------------------------------------
+static double NowMs(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Report(const char* verdict, const char* command, const char* fmt, ...)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    printf("%-5s %-32s ", verdict, command);
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Deviation(const char* command, const char* fmt, ...)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char text[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    if (strict) failed++;
+    else warned++;
+    Report(strict ? "FAIL" : "WARN", command, "%s", text);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void AddLatency(const char* command, double ms)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    int i;
+    for (i = 0; i < latencyCount; i++)
+    {
+        if (strcmp(latencies[i].command, command) == 0) break;
+    }
+    if (i == latencyCount)
+    {
+        if (latencyCount == MAX_COMMANDS) return;
+        snprintf(latencies[latencyCount++].command, MAX_LINE, "%s", command);
+    }
+    if (latencies[i].count < MAX_SAMPLES) latencies[i].ms[latencies[i].count++] = ms;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ReadUntil(char* buf, size_t size, size_t* len, const char* pattern, double deadline)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // the colors of the prompt and of the errors are removed, so the lines can be compared as they are
+    while (1)
+    {
+        buf[*len] = '\0';
+        if (strstr(buf, pattern) != NULL) return 0;
+
+        double left = deadline - NowMs();
+        if (left <= 0.0) return -1;
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, (int)left + 1);
+        if (ready < 0 && errno != EINTR) return -1;
+        if (ready <= 0) continue;
+
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (n <= 0) return -1;
+
+        if (c == 0x1B)
+        {
+            // CSI sequence, the final byte is a letter
+            do
+            {
+                if (poll(&pfd, 1, 100) <= 0 || read(fd, &c, 1) != 1) break;
+            } while (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')));
+            continue;
+        }
+        if (c == '\r') continue;
+        if (*len + 1 < size) buf[(*len)++] = c;
+        else if (c == '\n') buf[*len - 1] = c;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int ReadLine(char* line, size_t size, double deadline)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    size_t len = 0;
+    if (ReadUntil(line, size, &len, "\n", deadline) != 0) return -1;
+    line[len - 1] = '\0';
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Drain(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char c;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    while (poll(&pfd, 1, 200) > 0 && read(fd, &c, 1) == 1) { ; }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Execute(const char* command, Response_t* r, double* ms)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char line[MAX_LINE + 1];
+    int len = snprintf(line, sizeof(line), "%s\r", command);
+    double start = NowMs();
+    if (write(fd, line, (size_t)len) != len) return -1;
+
+    // the echo of the command comes first, the values follow on their own lines until OK or FAIL
+    char text[MAX_LINE];
+    double deadline = start + timeoutMs;
+    memset(r, 0, sizeof(*r));
+    if (ReadLine(text, sizeof(text), deadline) != 0) return -1;
+
+    while (1)
+    {
+        if (ReadLine(text, sizeof(text), deadline) != 0) return -1;
+        *ms = NowMs() - start;
+
+        if (strcmp(text, "OK") == 0 || strcmp(text, "FAIL") == 0)
+        {
+            r->ok = (text[0] == 'O');
+            break;
+        }
+        if (text[0] != '\0' && r->count < MAX_LINES) snprintf(r->lines[r->count++], MAX_LINE, "%s", text);
+    }
+
+    // the prompt closes the output, the next command must not be typed into the output of this one
+    static char buf[8192];
+    size_t used = 0;
+    if (ReadUntil(buf, sizeof(buf), &used, PROMPT, deadline) != 0) return -1;
+
+    if (verbose)
+    {
+        printf("      > %s (%.2f ms) %s", command, *ms, r->ok ? "OK" : "FAIL");
+        for (int i = 0; i < r->count; i++) printf(" | %s", r->lines[i]);
+        printf("\n");
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int CheckValue(char format, const char* text)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char* end;
+    switch (format)
+    {
+    case 'i':
+        strtol(text, &end, 10);
+        return end != text && *end == '\0' && strchr(text, '.') == NULL;
+    case 'b':
+        return strcmp(text, "0") == 0 || strcmp(text, "1") == 0;
+    case 'x':
+        if (strncmp(text, "0x", 2) != 0 && strncmp(text, "0X", 2) != 0) return 0;
+        strtoul(text + 2, &end, 16);
+        return end != text + 2 && *end == '\0';
+    case 'f':
+        strtod(text, &end);
+        return end != text && *end == '\0' && strchr(text, '.') != NULL;
+    case 'c':
+    {
+        // a comma separated list of 0 and 1, one for every capability of the spec
+        int n = 0;
+        for (const char* p = text; *p != '\0'; p++)
+        {
+            if ((*p == '0' || *p == '1') && (p[1] == ',' || p[1] == '\0')) n++;
+            else if (*p != ',') return 0;
+        }
+        return n >= CAP_COUNT;
+    }
+    default:
+        return 0;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int Check(const char* command, int cap, int expectOk, const char* formats, Response_t* r)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // a command without its capability bit must not be tested, it is not implemented
+    if (cap >= 0 && !caps[cap])
+    {
+        skipped++;
+        if (verbose) Report("SKIP", command, "capability bit %d is not set", cap);
+        return -1;
+    }
+
+    double ms;
+    Response_t local;
+    if (r == NULL) r = &local;
+    if (Execute(command, r, &ms) != 0)
+    {
+        failed++;
+        Report("FAIL", command, "no OK or FAIL line within %.0f ms", timeoutMs);
+        return -2;
+    }
+    AddLatency(command, ms);
+
+    if (r->ok != expectOk)
+    {
+        failed++;
+        Report("FAIL", command, "%s instead of %s%s%s", r->ok ? "OK" : "FAIL", expectOk ? "OK" : "FAIL",
+            r->count ? ": " : "", r->count ? r->lines[0] : "");
+        return -1;
+    }
+
+    // the values are only defined for a successful command, a failing one may print a message
+    if (expectOk && formats != NULL)
+    {
+        if ((size_t)r->count != strlen(formats))
+        {
+            failed++;
+            Report("FAIL", command, "%d value lines instead of %zu", r->count, strlen(formats));
+            return -1;
+        }
+        for (int i = 0; i < r->count; i++)
+        {
+            if (!CheckValue(formats[i], r->lines[i]))
+            {
+                failed++;
+                Report("FAIL", command, "value %d \"%s\" is not of type %c", i + 1, r->lines[i], formats[i]);
+                return -1;
+            }
+        }
+    }
+
+    passed++;
+    Report("PASS", command, "%.2f ms", ms);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void CheckState(const char* after, int expected)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    Response_t r;
+    if (Check("stepper status", CAP_HAS_STEPPER_STATUS, 1, "xxb", &r) != 0) return;
+
+    int state = (int)strtol(r.lines[0], NULL, 16);
+    if (state != expected) Deviation("stepper status", "state 0x%x after %s, the spec requires 0x%x", state, after,
+        expected);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void CheckPosition(const char* after, double expected, double resolution)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    Response_t r;
+    if (Check("stepper position", CAP_HAS_STEPPER_POSITION, 1, "f", &r) != 0) return;
+
+    double position = strtod(r.lines[0], NULL);
+    if (fabs(position - expected) > resolution) Deviation("stepper position", "%s gives %.4f mm instead of %.4f mm",
+        after, position, expected);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static double ReadConfig(const char* name, int cap, char format)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    char command[MAX_LINE];
+    char formats[2] = { format, '\0' };
+    Response_t r;
+    snprintf(command, sizeof(command), "stepper config %s", name);
+    if (Check(command, cap, 1, formats, &r) != 0) return NAN;
+    return strtod(r.lines[0], NULL);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void RunConformance(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    Response_t r;
+    char command[MAX_LINE];
+
+    // every further command depends on the capability bits
+    if (Check("capability", -1, 1, "c", &r) != 0)
+    {
+        printf("the capability bits are unknown, no further command is tested\n");
+        return;
+    }
+    for (int i = 0; i < CAP_COUNT; i++) caps[i] = (r.lines[0][2 * i] == '1');
+
+    // spindle
+    Check("spindle start 1800", CAP_HAS_SPINDLE, 1, "", NULL);
+    if (Check("spindle status", CAP_HAS_SPINDLE_STATUS, 1, "bi", &r) == 0)
+    {
+        if (strcmp(r.lines[0], "1") != 0) Deviation("spindle status", "not turning after spindle start");
+        if (strcmp(r.lines[1], "1800") != 0) Deviation("spindle status", "%s rpm instead of the requested 1800",
+            r.lines[1]);
+    }
+    Check("spindle start -1200", CAP_HAS_SPINDLE, 1, "", NULL);
+    Check("spindle stop", CAP_HAS_SPINDLE, 1, "", NULL);
+    Check("spindle stop", CAP_HAS_SPINDLE, 1, "", NULL);
+    if (Check("spindle status", CAP_HAS_SPINDLE_STATUS, 1, "bi", &r) == 0 && strcmp(r.lines[0], "0") != 0)
+    {
+        Deviation("spindle status", "still turning after spindle stop");
+    }
+
+    // bring up of the stepper along the state machine
+    if (!caps[CAP_HAS_STEPPER])
+    {
+        skipped++;
+        return;
+    }
+    Check("stepper reset", CAP_HAS_STEPPER_RESET, 1, "", NULL);
+    CheckState("stepper reset", scsREF);
+
+    double posmin = ReadConfig("posmin", CAP_HAS_STEPPER_CONFIG_POSMIN, 'f');
+    double posmax = ReadConfig("posmax", CAP_HAS_STEPPER_CONFIG_POSMAX, 'f');
+    double mmPerTurn = ReadConfig("mmperturn", CAP_HAS_STEPPER_CONFIG_MMPERTURN, 'f');
+    double stepsPerTurn = ReadConfig("stepsperturn", CAP_HAS_STEPPER_CONFIG_STEPSPERTURN, 'i');
+    ReadConfig("posref", CAP_HAS_STEPPER_CONFIG_POSREF, 'f');
+
+    // one full step is the resolution of a position
+    double resolution = (isnan(mmPerTurn) || isnan(stepsPerTurn) || stepsPerTurn <= 0.0) ? 0.05 :
+        mmPerTurn / stepsPerTurn;
+
+    Check("stepper reference -s", CAP_HAS_STEPPER_REFRUN_SKIP, 1, "", NULL);
+    CheckState("stepper reference -s", caps[CAP_HAS_STEPPER_CONFIG_POWERENA] ? scsDIS : scsENA);
+
+    // the parameters which can not be changed while the outputs are enabled are written back with their own value
+    static const struct { const char* name; int cap; char format; int whileActive; } params[] =
+    {
+        { "torque",       CAP_HAS_STEPPER_CONFIG_TORQUE,       'i', 1 },
+        { "throvercurr",  CAP_HAS_STEPPER_CONFIG_THROVERCURR,  'i', 1 },
+        { "stepmode",     CAP_HAS_STEPPER_CONFIG_STEPMODE,     'i', 1 },
+        { "timeoff",      CAP_HAS_STEPPER_CONFIG_TIMEOFF,      'i', 0 },
+        { "timeon",       CAP_HAS_STEPPER_CONFIG_TIMEON,       'i', 0 },
+        { "timefast",     CAP_HAS_STEPPER_CONFIG_TIMEFAST,     'i', 0 },
+        { "mmperturn",    CAP_HAS_STEPPER_CONFIG_MMPERTURN,    'f', 1 },
+        { "posmax",       CAP_HAS_STEPPER_CONFIG_POSMAX,       'f', 1 },
+        { "posmin",       CAP_HAS_STEPPER_CONFIG_POSMIN,       'f', 1 },
+        { "posref",       CAP_HAS_STEPPER_CONFIG_POSREF,       'f', 1 },
+        { "stepsperturn", CAP_HAS_STEPPER_CONFIG_STEPSPERTURN, 'i', 1 },
+    };
+    double values[sizeof(params) / sizeof(params[0])];
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++)
+    {
+        values[i] = ReadConfig(params[i].name, params[i].cap, params[i].format);
+        if (isnan(values[i])) continue;
+
+        snprintf(command, sizeof(command), params[i].format == 'f' ? "stepper config %s -v %.4f" :
+            "stepper config %s -v %.0f", params[i].name, values[i]);
+        Check(command, params[i].cap, 1, "", NULL);
+    }
+
+    Check("stepper config powerena -v 1", CAP_HAS_STEPPER_CONFIG_POWERENA, 1, "", NULL);
+    CheckState("stepper config powerena -v 1", scsENA);
+    if (Check("stepper config powerena", CAP_HAS_STEPPER_CONFIG_POWERENA, 1, "i", &r) == 0 &&
+        strcmp(r.lines[0], "1") != 0)
+    {
+        Deviation("stepper config powerena", "reads %s while the outputs are enabled", r.lines[0]);
+    }
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++)
+    {
+        if (params[i].whileActive || isnan(values[i])) continue;
+        snprintf(command, sizeof(command), "stepper config %s -v %.0f", params[i].name, values[i]);
+        Check(command, params[i].cap, 0, "", NULL);
+    }
+
+    // moves within the range, the positions are relative to posmin so they stay valid for every range
+    double base = isnan(posmin) ? 0.0 : posmin;
+    snprintf(command, sizeof(command), "stepper move %.4f", base + 2.0);
+    if (Check(command, CAP_HAS_STEPPER, 1, "", NULL) == 0) CheckPosition(command, base + 2.0, resolution);
+    if (Check("stepper move 1 -r", CAP_HAS_STEPPER_MOVE_RELA, 1, "", NULL) == 0)
+    {
+        CheckPosition("stepper move 1 -r", base + 3.0, resolution);
+    }
+    if (Check("stepper move -1.5 -r", CAP_HAS_STEPPER_MOVE_RELA, 1, "", NULL) == 0)
+    {
+        CheckPosition("stepper move -1.5 -r", base + 1.5, resolution);
+    }
+    snprintf(command, sizeof(command), "stepper move %.4f -s 2000", base + 5.0);
+    if (Check(command, CAP_HAS_STEPPER_MOVE_SPEED, 1, "", NULL) == 0) CheckPosition(command, base + 5.0, resolution);
+
+    if (!isnan(posmax))
+    {
+        snprintf(command, sizeof(command), "stepper move %.4f", posmax + 1.0);
+        Check(command, CAP_HAS_STEPPER, 0, NULL, NULL);
+    }
+
+    // an asynchronous move rejects a second move until it is done or cancelled
+    snprintf(command, sizeof(command), "stepper move %.4f -a -s 100", base + 10.0);
+    if (Check(command, CAP_HAS_STEPPER_MOVE_ASYNC, 1, "", NULL) == 0)
+    {
+        if (Check("stepper status", CAP_HAS_STEPPER_STATUS, 1, "xxb", &r) == 0 && strcmp(r.lines[2], "1") != 0)
+        {
+            Deviation("stepper status", "no pending operation while the asynchronous move runs");
+        }
+        snprintf(command, sizeof(command), "stepper move %.4f", base + 2.0);
+        Check(command, CAP_HAS_STEPPER, 0, NULL, NULL);
+        Check("stepper cancel", CAP_HAS_STEPPER_CANCEL, 1, "", NULL);
+        if (Check("stepper status", CAP_HAS_STEPPER_STATUS, 1, "xxb", &r) == 0 && strcmp(r.lines[2], "0") != 0)
+        {
+            Deviation("stepper status", "the operation is still pending after stepper cancel");
+        }
+    }
+    Check("stepper cancel", CAP_HAS_STEPPER_CANCEL, 1, "", NULL);
+
+    Check("stepper config powerena -v 0", CAP_HAS_STEPPER_CONFIG_POWERENA, 1, "", NULL);
+    CheckState("stepper config powerena -v 0", scsDIS);
+    Check("stepper reference -s -e", CAP_HAS_STEPPER_REFRUN_ENABLED, 1, "", NULL);
+    CheckState("stepper reference -s -e", scsENA);
+    Check("stepper reference -t 5 -s", CAP_HAS_STEPPER_REFRUN_TMOUT, 1, "", NULL);
+    CheckPosition("stepper reference -t 5 -s", 0.0, resolution);
+
+    // reset is accepted in every state
+    Check("stepper reset", CAP_HAS_STEPPER_RESET, 1, "", NULL);
+    Check("stepper reset", CAP_HAS_STEPPER_RESET, 1, "", NULL);
+    CheckState("stepper reset", scsREF);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void RunLatency(int repeats)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // queries only, so the repeats do not change the state
+    static const struct { const char* command; int cap; } queries[] =
+    {
+        { "capability",                -1                                  },
+        { "spindle status",            CAP_HAS_SPINDLE_STATUS              },
+        { "stepper status",            CAP_HAS_STEPPER_STATUS              },
+        { "stepper position",          CAP_HAS_STEPPER_POSITION            },
+        { "stepper config torque",     CAP_HAS_STEPPER_CONFIG_TORQUE       },
+        { "stepper config powerena",   CAP_HAS_STEPPER_CONFIG_POWERENA     },
+        { "stepper config posmax",     CAP_HAS_STEPPER_CONFIG_POSMAX       },
+        { "stepper cancel",            CAP_HAS_STEPPER_CANCEL              },
+    };
+
+    for (int n = 0; n < repeats; n++)
+    {
+        for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        {
+            if (queries[i].cap >= 0 && !caps[queries[i].cap]) continue;
+
+            Response_t r;
+            double ms;
+            if (Execute(queries[i].command, &r, &ms) != 0 || !r.ok)
+            {
+                failed++;
+                Report("FAIL", queries[i].command, "failed while measuring the latency");
+                return;
+            }
+            AddLatency(queries[i].command, ms);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int CompareDouble(const void* a, const void* b)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    double d = *(const double*)a - *(const double*)b;
+    return (d > 0.0) - (d < 0.0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static double Percentile(Latency_t* l, double p)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // nearest rank
+    int rank = (int)ceil(p / 100.0 * l->count);
+    if (rank < 1) rank = 1;
+    return l->ms[rank - 1];
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int WriteLatency(FILE* f)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // the command is the last column, it contains no commas but spaces
+    fprintf(f, "samples,p50_ms,p99_ms,max_ms,command\n");
+    for (int i = 0; i < latencyCount; i++)
+    {
+        Latency_t* l = &latencies[i];
+        fprintf(f, "%d,%.3f,%.3f,%.3f,%s\n", l->count, Percentile(l, 50.0), Percentile(l, 99.0), l->ms[l->count - 1],
+            l->command);
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int CompareBaseline(const char* path, double tolerance)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    int slower = 0;
+    char line[MAX_LINE * 2];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        int samples, used = 0;
+        double p50, p99, max;
+        if (sscanf(line, "%d,%lf,%lf,%lf,%n", &samples, &p50, &p99, &max, &used) != 4 || used == 0) continue;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        for (int i = 0; i < latencyCount; i++)
+        {
+            Latency_t* l = &latencies[i];
+            if (strcmp(l->command, line + used) != 0) continue;
+
+            double now50 = Percentile(l, 50.0);
+            double now99 = Percentile(l, 99.0);
+            if (now50 > p50 * (1.0 + tolerance / 100.0) + SLACK_MS || now99 > p99 * (1.0 + tolerance / 100.0) + SLACK_MS)
+            {
+                slower++;
+                Report("SLOW", l->command, "p50 %.3f ms (%.3f), p99 %.3f ms (%.3f)", now50, p50, now99, p99);
+            }
+        }
+    }
+    fclose(f);
+    return slower;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int OpenSerial(const char* port, speed_t baud)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fd = open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(port);
+        return -1;
+    }
+
+    // 115200 8N1 without flow control, see chapter 1.1 of the spec
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, baud);
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    tcflush(fd, TCIOFLUSH);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static int StartSimulator(const char* path, char** args, int argCount)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    // the simulator tells the name of its pseudo terminal on stderr
+    char log[] = "/tmp/spectest-XXXXXX";
+    int logFd = mkstemp(log);
+    if (logFd < 0)
+    {
+        perror("mkstemp");
+        return -1;
+    }
+
+    simulator = fork();
+    if (simulator < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (simulator == 0)
+    {
+        char* argv[argCount + 2];
+        argv[0] = (char*)path;
+        for (int i = 0; i < argCount; i++) argv[i + 1] = args[i];
+        argv[argCount + 1] = NULL;
+
+        dup2(logFd, STDERR_FILENO);
+        int nullFd = open("/dev/null", O_RDWR);
+        if (nullFd >= 0) dup2(nullFd, STDIN_FILENO);
+        execv(path, argv);
+        perror(path);
+        _exit(127);
+    }
+
+    char text[512];
+    double deadline = NowMs() + 5000.0;
+    while (NowMs() < deadline)
+    {
+        ssize_t n = pread(logFd, text, sizeof(text) - 1, 0);
+        if (n > 0)
+        {
+            text[n] = '\0';
+            char* name = strstr(text, "console on ");
+            if (name != NULL && strchr(name, '\n') != NULL)
+            {
+                name += strlen("console on ");
+                name[strcspn(name, "\n")] = '\0';
+                close(logFd);
+                unlink(log);
+                return OpenSerial(name, B115200);
+            }
+        }
+        if (waitpid(simulator, NULL, WNOHANG) == simulator)
+        {
+            simulator = 0;
+            break;
+        }
+        usleep(10000);
+    }
+
+    fprintf(stderr, "the simulator did not open its console, see %s\n", log);
+    close(logFd);
+    return -1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void StopSimulator(void)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    if (simulator <= 0) return;
+    kill(simulator, SIGTERM);
+    waitpid(simulator, NULL, 0);
+    simulator = 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+static void Usage(const char* self)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    fprintf(stderr,
+        "usage: %s (-p port [-B baud] | -s simulator [-- simulator options]) [-n repeats] [-o latency.csv]\n"
+        "       [-b baseline.csv] [-T tolerance %%] [-w timeout s] [-S] [-v]\n", self);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+// --------------------------------------------------------------------------------------------------------------------
+{
+    const char* port = NULL;
+    const char* sim = NULL;
+    const char* output = NULL;
+    const char* baseline = NULL;
+    speed_t baud = B115200;
+    int repeats = 20;
+    double tolerance = 20.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:B:s:n:o:b:T:w:Sv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = optarg; break;
+        case 'B': baud = (strcmp(optarg, "9600") == 0) ? B9600 : (strcmp(optarg, "921600") == 0) ? B921600 : B115200; break;
+        case 's': sim = optarg; break;
+        case 'n': repeats = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        case 'b': baseline = optarg; break;
+        case 'T': tolerance = strtod(optarg, NULL); break;
+        case 'w': timeoutMs = strtod(optarg, NULL) * 1000.0; break;
+        case 'S': strict = 1; break;
+        case 'v': verbose = 1; break;
+        default: Usage(argv[0]); return 2;
+        }
+    }
+    if ((port == NULL) == (sim == NULL) || repeats < 0)
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if ((sim != NULL) ? StartSimulator(sim, argv + optind, argc - optind) != 0 : OpenSerial(port, baud) != 0)
+    {
+        StopSimulator();
+        return 2;
+    }
+
+    // an empty line gives a fresh prompt, whatever has been typed before
+    char buf[8192];
+    size_t used = 0;
+    if (write(fd, "\r", 1) != 1 || ReadUntil(buf, sizeof(buf), &used, PROMPT, NowMs() + timeoutMs) != 0)
+    {
+        fprintf(stderr, "no prompt from the console\n");
+        StopSimulator();
+        return 2;
+    }
+    Drain();
+
+    RunConformance();
+    RunLatency(repeats);
+
+    printf("\n%d passed, %d failed, %d warnings, %d skipped\n\n", passed, failed, warned, skipped);
+    for (int i = 0; i < latencyCount; i++)
+    {
+        qsort(latencies[i].ms, (size_t)latencies[i].count, sizeof(double), CompareDouble);
+    }
+    printf("%8s %10s %10s  %s\n", "samples", "p50 ms", "p99 ms", "command");
+    for (int i = 0; i < latencyCount; i++)
+    {
+        Latency_t* l = &latencies[i];
+        printf("%8d %10.3f %10.3f  %s\n", l->count, Percentile(l, 50.0), Percentile(l, 99.0), l->command);
+    }
+
+    if (output != NULL)
+    {
+        FILE* f = fopen(output, "w");
+        if (f == NULL) perror(output);
+        else
+        {
+            WriteLatency(f);
+            fclose(f);
+        }
+    }
+    int slower = (baseline != NULL) ? CompareBaseline(baseline, tolerance) : 0;
+
+    StopSimulator();
+    close(fd);
+    if (slower < 0) return 2;
+    return (failed != 0 || slower != 0) ? 1 : 0;
+}